@@ -1,4 +1,6 @@
 #include "hermes2d.h"
+#include "integration_kernels.h"
+#include "instrumentation.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -39,14 +41,14 @@ public:
   {
   public:
     BilinearFormSymVel(int i, int j, bool Stokes, double Reynolds, double time_step) : MatrixFormVol<double>(i, j), Stokes(Stokes), 
-      Reynolds(Reynolds), time_step(time_step) {
+      Reynolds(Reynolds), time_step(time_step), kernels(IntegrationKernels::get_kernels()) {
         sym = HERMES_SYM;
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
-      double result = int_grad_u_grad_v<double, double>(n, wt, u, v) / Reynolds;
+      double result = kernels.grad_u_grad_v(n, wt, u->dx, u->dy, v->dx, v->dy) / Reynolds;
       if(!Stokes)
-        result += int_u_v<double, double>(n, wt, u, v) / time_step;
+        result += kernels.u_v(n, wt, u->val, v->val) / time_step;
       return result;
     }
 
@@ -67,13 +69,14 @@ public:
     bool Stokes;
     double Reynolds;
     double time_step;
+    IntegrationKernels::Kernels kernels;
   };
 
 
   class BilinearFormUnSymVel : public MatrixFormVol<double>
   {
   public:
-    BilinearFormUnSymVel(int i, int j, bool Stokes) : MatrixFormVol<double>(i, j), Stokes(Stokes) {
+    BilinearFormUnSymVel(int i, int j, bool Stokes) : MatrixFormVol<double>(i, j), Stokes(Stokes), kernels(IntegrationKernels::get_kernels()) {
       sym = HERMES_NONSYM;
     }
 
@@ -82,7 +85,7 @@ public:
       if(!Stokes) {
         Func<double>* xvel_prev_time = ext[0];
         Func<double>* yvel_prev_time = ext[1];
-        result = int_w_nabla_u_v<double, double>(n, wt, xvel_prev_time, yvel_prev_time, u, v);
+        result = kernels.w_nabla_u_v(n, wt, xvel_prev_time->val, yvel_prev_time->val, u->dx, u->dy, v->val);
       }
       return result;
     }
@@ -104,18 +107,19 @@ public:
   protected:
     // Members.
     bool Stokes;
+    IntegrationKernels::Kernels kernels;
   };
 
 
   class BilinearFormUnSymXVelPressure : public MatrixFormVol<double>
   {
   public:
-    BilinearFormUnSymXVelPressure(int i, int j) : MatrixFormVol<double>(i, j) {
+    BilinearFormUnSymXVelPressure(int i, int j) : MatrixFormVol<double>(i, j), kernels(IntegrationKernels::get_kernels()) {
       sym = HERMES_ANTISYM;
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
-      return - int_u_dvdx<double, double>(n, wt, u, v);
+      return - kernels.u_v(n, wt, u->val, v->dx);
     }
 
     Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const {
@@ -126,18 +130,21 @@ public:
     {
       return new BilinearFormUnSymXVelPressure(this->i, this->j);
     }
+  protected:
+    // Members.
+    IntegrationKernels::Kernels kernels;
   };
 
 
   class BilinearFormUnSymYVelPressure : public MatrixFormVol<double>
   {
   public:
-    BilinearFormUnSymYVelPressure(int i, int j) : MatrixFormVol<double>(i, j) {
+    BilinearFormUnSymYVelPressure(int i, int j) : MatrixFormVol<double>(i, j), kernels(IntegrationKernels::get_kernels()) {
       sym = HERMES_ANTISYM;
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
-      return - int_u_dvdy<double, double>(n, wt, u, v);
+      return - kernels.u_v(n, wt, u->val, v->dy);
     }
 
     Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const{
@@ -148,20 +155,23 @@ public:
     {
       return new BilinearFormUnSymYVelPressure(this->i, this->j);
     }
+  protected:
+    // Members.
+    IntegrationKernels::Kernels kernels;
   };
 
 
   class VectorFormVolVel : public VectorFormVol<double>
   {
   public:
-    VectorFormVolVel(int i, bool Stokes, double time_step) : VectorFormVol<double>(i), Stokes(Stokes), time_step(time_step) {
+    VectorFormVolVel(int i, bool Stokes, double time_step) : VectorFormVol<double>(i), Stokes(Stokes), time_step(time_step), kernels(IntegrationKernels::get_kernels()) {
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v, Geom<double> *e, Func<double> **ext) const{
       double result = 0;
       if(!Stokes) {
         Func<double>* vel_prev_time = ext[0]; // this form is used with both velocity components
-        result = int_u_v<double, double>(n, wt, vel_prev_time, v) / time_step;
+        result = kernels.u_v(n, wt, vel_prev_time->val, v->val) / time_step;
       }
       return result;
     }
@@ -183,6 +193,7 @@ public:
     // Members.
     bool Stokes;
     double time_step;
+    IntegrationKernels::Kernels kernels;
   };
 
 protected:
@@ -192,18 +203,25 @@ protected:
   double time_step;
 };
 
+// With cache_constant_jacobian, the state-independent matrix forms (the viscous, mass / tau and pressure
+// coupling terms) are not part of the weak form, but of get_constant_jacobian_form(). Its matrix is the same
+// at every Newton iteration and time step, so it is assembled once and added to the matrix of the convective
+// terms assembled from this weak form (see DiscreteProblemNSNewton). The vector forms are the complete residual
+// in both cases.
 class WeakFormNSNewton : public WeakForm<double>
 {
 public:
-  WeakFormNSNewton(bool Stokes, double Reynolds, double time_step, MeshFunction<double>* xvel_prev_time, MeshFunction<double>* yvel_prev_time) : WeakForm<double>(3), Stokes(Stokes), 
-    Reynolds(Reynolds)
+  WeakFormNSNewton(bool Stokes, double Reynolds, double time_step, MeshFunction<double>* xvel_prev_time, MeshFunction<double>* yvel_prev_time,
+    bool cache_constant_jacobian = false) : WeakForm<double>(3), Stokes(Stokes), Reynolds(Reynolds), constant_jacobian_form(NULL)
   {
     this->current_time_step = time_step;
+    if(cache_constant_jacobian)
+      constant_jacobian_form = new WeakForm<double>(3);
 
     BilinearFormSymVel* sym_form_0 = new BilinearFormSymVel(0, 0, Stokes, Reynolds, time_step);
-    add_matrix_form(sym_form_0);
+    add_constant_matrix_form(sym_form_0);
     BilinearFormSymVel* sym_form_1 = new BilinearFormSymVel(1, 1, Stokes, Reynolds, time_step);
-    add_matrix_form(sym_form_1);
+    add_constant_matrix_form(sym_form_1);
 
     BilinearFormUnSymVel_0_0* unsym_vel_form_0_0 = new BilinearFormUnSymVel_0_0(0, 0, Stokes);
     add_matrix_form(unsym_vel_form_0_0);
@@ -215,10 +233,20 @@ public:
     add_matrix_form(unsym_vel_form_1_1);
 
     BilinearFormUnSymXVelPressure* unsym_velx_pressure_form = new BilinearFormUnSymXVelPressure(0, 2);
-    add_matrix_form(unsym_velx_pressure_form);
+    add_constant_matrix_form(unsym_velx_pressure_form);
 
     BilinearFormUnSymYVelPressure* unsym_vely_pressure_form = new BilinearFormUnSymYVelPressure(1, 2);
-    add_matrix_form(unsym_vely_pressure_form);
+    add_constant_matrix_form(unsym_vely_pressure_form);
+
+    // The constant matrix is added to the matrix of this weak form entry by entry, so both have to
+    // have the same sparsity pattern: the pressure coupling blocks stay in this weak form and the
+    // convective blocks (0, 1), (1, 0) are added to the constant one.
+    if(cache_constant_jacobian)
+    {
+      add_matrix_form(new BilinearFormZero(0, 2));
+      add_matrix_form(new BilinearFormZero(1, 2));
+      constant_jacobian_form->add_matrix_form(new BilinearFormZero(0, 1));
+    }
 
     VectorFormNS_0* F_0 = new VectorFormNS_0(0, Stokes, Reynolds, time_step);
     
@@ -232,18 +260,38 @@ public:
     add_vector_form(F_2);
   };
 
+  ~WeakFormNSNewton()
+  {
+    delete constant_jacobian_form;
+  }
+
+  // The state-independent part of the Jacobian, NULL without cache_constant_jacobian.
+  WeakForm<double>* get_constant_jacobian_form() const
+  {
+    return constant_jacobian_form;
+  }
+
+  // Adds a matrix form independent of the state (u_ext and ext).
+  void add_constant_matrix_form(MatrixFormVol<double>* form)
+  {
+    if(constant_jacobian_form != NULL)
+      constant_jacobian_form->add_matrix_form(form);
+    else
+      add_matrix_form(form);
+  }
+
   class BilinearFormSymVel : public MatrixFormVol<double>
   {
   public:
     BilinearFormSymVel(int i, int j, bool Stokes, double Reynolds, double time_step) : MatrixFormVol<double>(i, j), Stokes(Stokes), 
-      Reynolds(Reynolds), time_step(time_step) {
+      Reynolds(Reynolds), time_step(time_step), kernels(IntegrationKernels::get_kernels()) {
         sym = HERMES_SYM;
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
-      double result = int_grad_u_grad_v<double, double>(n, wt, u, v) / Reynolds;
+      double result = kernels.grad_u_grad_v(n, wt, u->dx, u->dy, v->dx, v->dy) / Reynolds;
       if(!Stokes)
-        result += int_u_v<double, double>(n, wt, u, v) / time_step;
+        result += kernels.u_v(n, wt, u->val, v->val) / time_step;
       return result;
     }
 
@@ -264,6 +312,7 @@ public:
     bool Stokes;
     double Reynolds;
     double time_step;
+    IntegrationKernels::Kernels kernels;
   };
 
 
@@ -426,12 +475,12 @@ public:
   class BilinearFormUnSymXVelPressure : public MatrixFormVol<double>
   {
   public:
-    BilinearFormUnSymXVelPressure(int i, int j) : MatrixFormVol<double>(i, j) {
+    BilinearFormUnSymXVelPressure(int i, int j) : MatrixFormVol<double>(i, j), kernels(IntegrationKernels::get_kernels()) {
       sym = HERMES_ANTISYM;
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
-      return - int_u_dvdx<double, double>(n, wt, u, v);
+      return - kernels.u_v(n, wt, u->val, v->dx);
     }
 
     Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const {
@@ -442,18 +491,21 @@ public:
     {
       return new BilinearFormUnSymXVelPressure(this->i, this->j);
     }
+  protected:
+    // Members.
+    IntegrationKernels::Kernels kernels;
   };
 
 
   class BilinearFormUnSymYVelPressure : public MatrixFormVol<double>
   {
   public:
-    BilinearFormUnSymYVelPressure(int i, int j) : MatrixFormVol<double>(i, j) {
+    BilinearFormUnSymYVelPressure(int i, int j) : MatrixFormVol<double>(i, j), kernels(IntegrationKernels::get_kernels()) {
       sym = HERMES_ANTISYM;
     }
 
     double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
-      return - int_u_dvdy<double, double>(n, wt, u, v);
+      return - kernels.u_v(n, wt, u->val, v->dy);
     }
 
     Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const {
@@ -464,6 +516,32 @@ public:
     {
       return new BilinearFormUnSymYVelPressure(this->i, this->j);
     }
+  protected:
+    // Members.
+    IntegrationKernels::Kernels kernels;
+  };
+
+
+  // Zero form, only puts the block into the sparsity pattern.
+  class BilinearFormZero : public MatrixFormVol<double>
+  {
+  public:
+    BilinearFormZero(int i, int j) : MatrixFormVol<double>(i, j) {
+      sym = HERMES_ANTISYM;
+    }
+
+    double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, Geom<double> *e, Func<double> **ext) const{
+      return 0.0;
+    }
+
+    Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const {
+      return Ord(0);
+    }
+
+    MatrixFormVol<double>* clone() const
+    {
+      return new BilinearFormZero(this->i, this->j);
+    }
   };
 
 
@@ -603,6 +681,68 @@ protected:
   double Reynolds;
   Solution<double>* x_vel_previous_time;
   Solution<double>* y_vel_previous_time;
+  WeakForm<double>* constant_jacobian_form;
+};
+
+// Discrete problem of WeakFormNSNewton with cache_constant_jacobian, for NewtonSolver: the matrix of the constant
+// weak form is assembled when the spaces change (their sequence numbers) and added to every Jacobian assembled
+// from the weak form, so NewtonSolver sees the complete Jacobian.
+class DiscreteProblemNSNewton : public DiscreteProblem<double>
+{
+public:
+  DiscreteProblemNSNewton(WeakFormNSNewton* wf, Hermes::vector<const Space<double> *> spaces) : DiscreteProblem<double>(wf, spaces),
+    dp_constant(wf->get_constant_jacobian_form(), spaces), constant_jacobian(create_matrix<double>())
+  {
+  }
+
+  ~DiscreteProblemNSNewton()
+  {
+    delete constant_jacobian;
+  }
+
+  using DiscreteProblem<double>::assemble;
+
+  virtual void assemble(double* coeff_vec, SparseMatrix<double>* mat, Vector<double>* rhs = NULL,
+    bool force_diagonal_blocks = false, Table* block_weights = NULL)
+  {
+    if(mat == NULL)
+    {
+      Instrumentation::ScopedTimer timer("residual assembly");
+      DiscreteProblem<double>::assemble(coeff_vec, mat, rhs, force_diagonal_blocks, block_weights);
+      return;
+    }
+
+    Hermes::vector<const Space<double> *> spaces = this->get_spaces();
+    bool spaces_changed = space_seqs.size() != spaces.size();
+    for (unsigned int i = 0; i < space_seqs.size() && !spaces_changed; i++)
+      if(spaces[i]->get_seq() != space_seqs[i])
+        spaces_changed = true;
+    if(spaces_changed)
+    {
+      Instrumentation::ScopedTimer timer("constant jacobian assembly");
+      dp_constant.set_spaces(spaces);
+      dp_constant.assemble(coeff_vec, constant_jacobian);
+      space_seqs.clear();
+      for (unsigned int i = 0; i < spaces.size(); i++)
+        space_seqs.push_back(spaces[i]->get_seq());
+    }
+
+    Instrumentation::ScopedTimer timer("jacobian assembly");
+    Instrumentation::count("jacobian assemblies");
+    DiscreteProblem<double>::assemble(coeff_vec, mat, rhs, force_diagonal_blocks, block_weights);
+
+    // add_sparse_matrix() adds the arrays of values, so the weak forms have to give the same sparsity pattern
+    // (see the zero forms in WeakFormNSNewton).
+    if(mat->get_size() != constant_jacobian->get_size() || mat->get_nnz() != constant_jacobian->get_nnz())
+      throw Hermes::Exceptions::Exception("DiscreteProblemNSNewton: the sparsity patterns of the Jacobian (size %d, %d nonzeros) "
+        "and of its constant part (size %d, %d nonzeros) differ.", mat->get_size(), mat->get_nnz(), constant_jacobian->get_size(), constant_jacobian->get_nnz());
+    mat->add_sparse_matrix(constant_jacobian);
+  }
+
+protected:
+  DiscreteProblem<double> dp_constant;
+  SparseMatrix<double>* constant_jacobian;
+  std::vector<int> space_seqs;
 };
 
 class EssentialBCNonConst : public EssentialBoundaryCondition<double>
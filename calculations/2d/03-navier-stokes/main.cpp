@@ -2,6 +2,9 @@
 #define HERMES_REPORT_INFO
 #define HERMES_REPORT_FILE "application.log"
 #include "hermes2d.h"
+#include "instrumentation.h"
+#include "point_locator.h"
+#include "functional_evaluator.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -34,6 +37,7 @@ const double TAU = 0.1;                           // Time step.
 const double T_FINAL = 0.21;                      // Time interval length.
 const double NEWTON_TOL = 1e-3;                   // Stopping criterion for the Newton's method.
 const int NEWTON_MAX_ITER = 10;                   // Maximum allowed number of Newton iterations.
+const int NUM_THREADS = 4;                        // Number of threads of the evaluation of the lift and drag.
 
 // Domain height (necessary to define the parabolic
 // velocity profile at inlet).
@@ -52,8 +56,50 @@ double current_time = 0;
 // Weak forms.
 #include "definitions.cpp"
 
+// Force of the fluid on the obstacle, -int sigma n with the stress sigma = -p I + (grad u + grad u^T) / Re
+// and the outer normal n of the domain: component 0 is the drag, 1 the lift.
+class ObstacleForce : public Functional
+{
+public:
+  ObstacleForce(int component) : Functional(Hermes::vector<std::string>(), Hermes::vector<std::string>(BDY_OBSTACLE)),
+    component(component) {}
+
+  double surface(const FunctionalValues& values) const
+  {
+    const double* p = values.val[2];
+    const double* u_dx = values.dx[0];
+    const double* u_dy = values.dy[0];
+    const double* v_dx = values.dx[1];
+    const double* v_dy = values.dy[1];
+    double result = 0.0;
+    for (int i = 0; i < values.n; i++)
+    {
+      double n = component == 0 ? values.nx[i] : values.ny[i];
+      double shear = (u_dy[i] + v_dx[i]) / RE;
+      double viscous = component == 0 ? 2 * u_dx[i] / RE * values.nx[i] + shear * values.ny[i]
+        : shear * values.nx[i] + 2 * v_dy[i] / RE * values.ny[i];
+      result += values.wt[i] * (p[i] * n - viscous);
+    }
+    return result;
+  }
+
+protected:
+  int component;
+};
+
 int main(int argc, char* argv[])
 {
+  // Timers and counters, output selected by HERMES_INSTRUMENTATION (json / trace).
+  Instrumentation::init("03-navier-stokes");
+  // The names used in the time loop, so that it does not allocate for them.
+  const char* timers[] = { "time step", "constant jacobian assembly", "newton", "residual assembly", "jacobian assembly",
+    "solution" };
+  for (int i = 0; i < 6; i++)
+    Instrumentation::declare_timer(timers[i]);
+  Instrumentation::declare_counter("time steps");
+  Instrumentation::declare_counter("matrix structure setups");
+  Instrumentation::declare_counter("jacobian assemblies");
+
   // Load the mesh.
   Mesh mesh;
   MeshReaderH2D mloader;
@@ -96,34 +142,57 @@ int main(int argc, char* argv[])
   // Solutions for the Newton's iteration and time stepping.
   ZeroSolution<double> xvel_prev_time(&mesh), yvel_prev_time(&mesh), p_prev_time(&mesh);
 
-  // Initialize weak formulation.
-  WeakForm<double>* wf = new WeakFormNSNewton(STOKES, RE, TAU, &xvel_prev_time, &yvel_prev_time);
+  // Initialize weak formulation, the state-independent part of the Jacobian separately.
+  WeakFormNSNewton* wf = new WeakFormNSNewton(STOKES, RE, TAU, &xvel_prev_time, &yvel_prev_time, true);
 
   wf->set_ext(Hermes::vector<MeshFunction<double> *>(&xvel_prev_time, &yvel_prev_time));
 
-	// Initialize the Newton solver.
-	Hermes::Hermes2D::NewtonSolver<double> newton;
-	newton.set_weak_formulation(wf);
-	newton.set_spaces(Hermes::vector<const Space<double> *>(&xvel_space, &yvel_space, &p_space));
+  Hermes::vector<const Space<double> *> spaces(&xvel_space, &yvel_space, &p_space);
 
   // Project the initial condition on the FE space to obtain initial
   // coefficient vector for the Newton's method.
-  double* coeff_vec = new double[Space<double>::get_num_dofs(Hermes::vector<const Space<double> *>(&xvel_space, &yvel_space, &p_space))];
+  double* coeff_vec = new double[ndof];
   OGProjection<double> ogProjection;
 
-  ogProjection.project_global(Hermes::vector<const Space<double> *>(&xvel_space, &yvel_space, &p_space),
-    Hermes::vector<MeshFunction<double> *>(&xvel_prev_time, &yvel_prev_time, &p_prev_time),
-    coeff_vec, Hermes::vector<ProjNormType>(vel_proj_norm, vel_proj_norm, p_proj_norm));
+  {
+    Instrumentation::ScopedTimer timer("initial projection");
+    ogProjection.project_global(spaces,
+      Hermes::vector<MeshFunction<double> *>(&xvel_prev_time, &yvel_prev_time, &p_prev_time),
+      coeff_vec, Hermes::vector<ProjNormType>(vel_proj_norm, vel_proj_norm, p_proj_norm));
+  }
 
+  // Initialize the Newton solver. The discrete problem adds the constant part of the Jacobian,
+  // assembled once, to the matrix of the convective terms assembled at every iteration.
+  DiscreteProblemNSNewton dp(wf, spaces);
+  Hermes::Hermes2D::NewtonSolver<double> newton(&dp);
   newton.set_newton_max_iter(NEWTON_MAX_ITER);
   newton.set_newton_tol(NEWTON_TOL);
 
+  // The spaces do not change in the time loop, so the Newton solver keeps the sparsity pattern
+  // of the matrix, and after the first solve, the linear solver keeps the matrix reordering
+  // (the symbolic factorization of UMFPACK) and redoes only the numeric factorization.
+  // Should the spaces change (their sequence numbers), everything is set up from scratch.
+  std::vector<int> space_seqs;
+
   // Time-stepping loop:
   int num_time_steps = T_FINAL / TAU;
   for (int ts = 1; ts <= num_time_steps; ts++)
   {
+    Instrumentation::ScopedTimer time_step_timer("time step");
+    Instrumentation::count("time steps");
     current_time += TAU;
 
+    bool spaces_changed = false;
+    for (unsigned int i = 0; i < space_seqs.size(); i++)
+      if(spaces[i]->get_seq() != space_seqs[i])
+        spaces_changed = true;
+    if(spaces_changed)
+    {
+      newton.set_spaces(spaces);
+      newton.get_linear_solver()->set_factorization_scheme(HERMES_FACTORIZE_FROM_SCRATCH);
+      space_seqs.clear();
+    }
+
     // Update time-dependent essential BCs.
     if(current_time <= STARTUP_TIME)
       newton.set_time(current_time);
@@ -131,69 +200,75 @@ int main(int argc, char* argv[])
     // Perform Newton's iteration and translate the resulting coefficient vector into previous time level solutions.
     try
     {
+      Instrumentation::ScopedTimer timer("newton");
       newton.solve(coeff_vec);
-			newton.set_weak_formulation(wf);
-			newton.set_spaces(Hermes::vector<const Space<double> *>(&xvel_space, &yvel_space, &p_space));
     }
     catch(Hermes::Exceptions::Exception& e)
     {
       e.print_msg();
     }
+    if(space_seqs.empty())
+    {
+      Instrumentation::count("matrix structure setups");
+      for (unsigned int i = 0; i < spaces.size(); i++)
+        space_seqs.push_back(spaces[i]->get_seq());
+      newton.get_linear_solver()->set_factorization_scheme(HERMES_REUSE_MATRIX_REORDERING);
+    }
+
+    Instrumentation::ScopedTimer timer("solution");
     Hermes::vector<Solution<double> *> tmp(&xvel_prev_time, &yvel_prev_time, &p_prev_time);
-    Hermes::Hermes2D::Solution<double>::vector_to_solutions(newton.get_sln_vector(), Hermes::vector<const Space<double> *>(&xvel_space, &yvel_space, &p_space), tmp);
+    Hermes::Hermes2D::Solution<double>::vector_to_solutions(newton.get_sln_vector(), spaces, tmp);
   }
 
   delete [] coeff_vec;
 
+  // Drag and lift on the obstacle. The evaluator clones the solutions, so the results are copied
+  // to plain Solutions (a clone of ZeroSolution would be zero again).
+  Solution<double> xvel, yvel, p;
+  xvel.copy(&xvel_prev_time);
+  yvel.copy(&yvel_prev_time);
+  p.copy(&p_prev_time);
+  ObstacleForce drag(0), lift(1);
+  FunctionalEvaluator evaluator(&mesh, Hermes::vector<MeshFunction<double> *>(&xvel, &yvel, &p));
+  evaluator.add(&drag);
+  evaluator.add(&lift);
+  std::vector<double> forces;
+  {
+    Instrumentation::ScopedTimer timer("obstacle forces");
+    forces = evaluator.evaluate(NUM_THREADS);
+  }
+  printf("Drag %g, lift %g.\n", forces[0], forces[1]);
+
+  // The probes on the line y = 2.5, located once in the quadtree of PointLocator.
+  PointLocator locator(&mesh);
+  const double probe_x[6] = { 0.0, 5.0, 7.5, 10.0, 12.5, 15.0 };
+  const double xvel_expected[6] = { 0.200000, 0.134291, 0.135088, 0.134944, 0.134888, 0.134864 };
+  const double yvel_expected[6] = { 0.000000, 0.000493, 0.000070, 0.000008, -0.000003, -0.000006 };
+
   int success = 1;
   double eps = 1e-5;
-  if(fabs(xvel_prev_time.get_pt_value(0.0, 2.5)->val[0] - 0.200000) > eps) {
-    printf("Coordinate (   0, 2.5)->val[0] xvel value is %g\n", xvel_prev_time.get_pt_value(0.0, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(xvel_prev_time.get_pt_value(5, 2.5)->val[0] - 0.134291) > eps) {
-    printf("Coordinate (   5, 2.5)->val[0] xvel value is %g\n", xvel_prev_time.get_pt_value(5, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(xvel_prev_time.get_pt_value(7.5, 2.5)->val[0] - 0.135088) > eps) {
-    printf("Coordinate ( 7.5, 2.5)->val[0] xvel value is %g\n", xvel_prev_time.get_pt_value(7.5, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(xvel_prev_time.get_pt_value(10, 2.5)->val[0] - 0.134944) > eps) {
-    printf("Coordinate (  10, 2.5)->val[0] xvel value is %g\n", xvel_prev_time.get_pt_value(10, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(xvel_prev_time.get_pt_value(12.5, 2.5)->val[0] - 0.134888) > eps) {
-    printf("Coordinate (12.5, 2.5)->val[0] xvel value is %g\n", xvel_prev_time.get_pt_value(12.5, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(xvel_prev_time.get_pt_value(15, 2.5)->val[0] - 0.134864) > eps) {
-    printf("Coordinate (  15, 2.5)->val[0] xvel value is %g\n", xvel_prev_time.get_pt_value(15, 2.5)->val[0]);
-    success = 0;
+  for (int i = 0; i < 6; i++)
+  {
+    double xvel, yvel;
+    if(!locator.get_value(&xvel_prev_time, probe_x[i], 2.5, xvel) || !locator.get_value(&yvel_prev_time, probe_x[i], 2.5, yvel))
+    {
+      printf("Coordinate (%4g, 2.5) not found in the mesh\n", probe_x[i]);
+      success = 0;
+      continue;
+    }
+    if(fabs(xvel - xvel_expected[i]) > eps) {
+      printf("Coordinate (%4g, 2.5)->val[0] xvel value is %g\n", probe_x[i], xvel);
+      success = 0;
+    }
+    if(fabs(yvel - yvel_expected[i]) > eps) {
+      printf("Coordinate (%4g, 2.5)->val[0] yvel value is %g\n", probe_x[i], yvel);
+      success = 0;
+    }
   }
 
-  if(fabs(yvel_prev_time.get_pt_value(0.0, 2.5)->val[0] - 0.000000) > eps) {
-    printf("Coordinate (   0, 2.5)->val[0] yvel value is %g\n", yvel_prev_time.get_pt_value(0.0, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(yvel_prev_time.get_pt_value(5, 2.5)->val[0] - 0.000493) > eps) {
-    printf("Coordinate (   5, 2.5)->val[0] yvel value is %g\n", yvel_prev_time.get_pt_value(5, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(yvel_prev_time.get_pt_value(7.5, 2.5)->val[0] - 0.000070) > eps) {
-    printf("Coordinate ( 7.5, 2.5)->val[0] yvel value is %g\n", yvel_prev_time.get_pt_value(7.5, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(yvel_prev_time.get_pt_value(10, 2.5)->val[0] - 0.000008) > eps) {
-    printf("Coordinate (  10, 2.5)->val[0] yvel value is %g\n", yvel_prev_time.get_pt_value(10, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(yvel_prev_time.get_pt_value(12.5, 2.5)->val[0] + 0.000003) > eps) {
-    printf("Coordinate (12.5, 2.5)->val[0] yvel value is %g\n", yvel_prev_time.get_pt_value(12.5, 2.5)->val[0]);
-    success = 0;
-  }
-  if(fabs(yvel_prev_time.get_pt_value(15, 2.5)->val[0] + 0.000006) > eps) {
-    printf("Coordinate (  15, 2.5)->val[0] yvel value is %g\n", yvel_prev_time.get_pt_value(15, 2.5)->val[0]);
+  // The flow from the left pushes the obstacle downstream.
+  if(!(forces[0] > 0.0)) {
+    printf("Drag %g is not positive\n", forces[0]);
     success = 0;
   }
 
@@ -1,21 +1,71 @@
 #include "definitions.h"
 
-CustomWeakForm::CustomWeakForm(std::string mat_air,  double mu_air,
+CustomWeakForm::CustomWeakForm(const MarkerIndex& index, std::string mat_air,  double mu_air,
                                std::string mat_iron, double mu_iron, double gamma_iron,
                                std::string mat_wire, double mu_wire, std::complex<double> j_ext, double omega) : Hermes::Hermes2D::WeakForm<std::complex<double> >(1)
 {
   std::complex<double> ii =  std::complex<double>(0.0, 1.0);
 
+  std::map<std::string, std::complex<double> > reluctivities;
+  reluctivities[mat_air] = 1.0/mu_air;
+  reluctivities[mat_iron] = 1.0/mu_iron;
+  reluctivities[mat_wire] = 1.0/mu_wire;
+  std::vector<std::complex<double> > reluctivity = index.get_area_values(reluctivities, std::complex<double>(0.0, 0.0));
+
   // Jacobian.
-  add_matrix_form(new WeakFormsH1::DefaultJacobianDiffusion<std::complex<double> >(0, 0, mat_air,  new Hermes1DFunction<std::complex<double> >(1.0/mu_air)));
-  add_matrix_form(new WeakFormsH1::DefaultJacobianDiffusion<std::complex<double> >(0, 0, mat_iron, new Hermes1DFunction<std::complex<double> >(1.0/mu_iron)));
-  add_matrix_form(new WeakFormsH1::DefaultJacobianDiffusion<std::complex<double> >(0, 0, mat_wire, new Hermes1DFunction<std::complex<double> >(1.0/mu_wire)));
-  add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<std::complex<double> >(0, 0, mat_iron, new Hermes2DFunction<std::complex<double> >(ii * omega * gamma_iron)));
+  add_matrix_form(new CustomJacobianDiffusion(reluctivity));
+  add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<std::complex<double> >(0, 0, mat_iron, new Hermes2DFunction<std::complex<double> >(ii * omega * gamma_iron), HERMES_SYM));
 
   // Residual.
-  add_vector_form(new WeakFormsH1::DefaultResidualDiffusion<std::complex<double> >(0, mat_air, new Hermes1DFunction<std::complex<double> >(1.0/mu_air)));
-  add_vector_form(new WeakFormsH1::DefaultResidualDiffusion<std::complex<double> >(0, mat_iron, new Hermes1DFunction<std::complex<double> >(1.0/mu_iron)));
-  add_vector_form(new WeakFormsH1::DefaultResidualDiffusion<std::complex<double> >(0, mat_wire, new Hermes1DFunction<std::complex<double> >(1.0/mu_wire)));
+  add_vector_form(new CustomResidualDiffusion(reluctivity));
   add_vector_form(new WeakFormsH1::DefaultVectorFormVol<std::complex<double> >(0, mat_wire, new Hermes2DFunction<std::complex<double> >(-j_ext)));
   add_vector_form(new WeakFormsH1::DefaultResidualVol<std::complex<double> >(0, mat_iron, new Hermes2DFunction<std::complex<double> >(ii * omega * gamma_iron)));
-}
\ No newline at end of file
+}
+
+CustomWeakForm::CustomJacobianDiffusion::CustomJacobianDiffusion(const std::vector<std::complex<double> >& reluctivity)
+  : MatrixFormVol<std::complex<double> >(0, 0), reluctivity(reluctivity)
+{
+  this->sym = HERMES_SYM;
+}
+
+std::complex<double> CustomWeakForm::CustomJacobianDiffusion::value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *u,
+                                                                    Func<double> *v, Geom<double> *e, Func<std::complex<double> > **ext) const
+{
+  return reluctivity[e->elem_marker] * int_grad_u_grad_v<double, double>(n, wt, u, v);
+}
+
+Ord CustomWeakForm::CustomJacobianDiffusion::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                                                 Geom<Ord> *e, Func<Ord> **ext) const
+{
+  return int_grad_u_grad_v<Ord, Ord>(n, wt, u, v);
+}
+
+MatrixFormVol<std::complex<double> >* CustomWeakForm::CustomJacobianDiffusion::clone() const
+{
+  return new CustomJacobianDiffusion(this->reluctivity);
+}
+
+CustomWeakForm::CustomResidualDiffusion::CustomResidualDiffusion(const std::vector<std::complex<double> >& reluctivity)
+  : VectorFormVol<std::complex<double> >(0), reluctivity(reluctivity)
+{
+}
+
+std::complex<double> CustomWeakForm::CustomResidualDiffusion::value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *v,
+                                                                    Geom<double> *e, Func<std::complex<double> > **ext) const
+{
+  std::complex<double> result = 0.0;
+  for (int i = 0; i < n; i++)
+    result += wt[i] * (u_ext[0]->dx[i] * v->dx[i] + u_ext[0]->dy[i] * v->dy[i]);
+  return reluctivity[e->elem_marker] * result;
+}
+
+Ord CustomWeakForm::CustomResidualDiffusion::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                                                 Geom<Ord> *e, Func<Ord> **ext) const
+{
+  return int_grad_u_grad_v<Ord, Ord>(n, wt, u_ext[0], v);
+}
+
+VectorFormVol<std::complex<double> >* CustomWeakForm::CustomResidualDiffusion::clone() const
+{
+  return new CustomResidualDiffusion(this->reluctivity);
+}
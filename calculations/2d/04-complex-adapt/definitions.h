@@ -1,14 +1,51 @@
 #include "hermes2d.h"
+#include "marker_index.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
 
 /* Weak forms */
 
+// The diffusion terms of the three materials are one Jacobian and one residual form over HERMES_ANY
+// with 1 / mu looked up by the area marker of the element (see MarkerIndex::get_area_values()),
+// the eddy current terms stay restricted to the iron and the source to the wire.
 class CustomWeakForm : public WeakForm<std::complex<double> >
 { 
 public:
-  CustomWeakForm(std::string mat_air,  double mu_air,
+  CustomWeakForm(const MarkerIndex& index, std::string mat_air,  double mu_air,
                  std::string mat_iron, double mu_iron, double gamma_iron,
                  std::string mat_wire, double mu_wire, std::complex<double> j_ext, double omega);
+
+private:
+  class CustomJacobianDiffusion : public MatrixFormVol<std::complex<double> >
+  {
+  public:
+    CustomJacobianDiffusion(const std::vector<std::complex<double> >& reluctivity);
+
+    virtual std::complex<double> value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *u, Func<double> *v,
+                                       Geom<double> *e, Func<std::complex<double> > **ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const;
+
+    virtual MatrixFormVol<std::complex<double> >* clone() const;
+
+    // 1 / mu per internal area marker.
+    std::vector<std::complex<double> > reluctivity;
+  };
+
+  class CustomResidualDiffusion : public VectorFormVol<std::complex<double> >
+  {
+  public:
+    CustomResidualDiffusion(const std::vector<std::complex<double> >& reluctivity);
+
+    virtual std::complex<double> value(int n, double *wt, Func<std::complex<double> > *u_ext[], Func<double> *v,
+                                       Geom<double> *e, Func<std::complex<double> > **ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const;
+
+    virtual VectorFormVol<std::complex<double> >* clone() const;
+
+    // 1 / mu per internal area marker.
+    std::vector<std::complex<double> > reluctivity;
+  };
 };
@@ -1,6 +1,7 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "instrumentation.h"
 
 using namespace Hermes::Hermes2D::RefinementSelectors;
 
@@ -67,6 +68,9 @@ const double OMEGA = 2 * M_PI * FREQ;
 
 int main(int argc, char* argv[])
 {
+  // Timers and counters, output selected by HERMES_INSTRUMENTATION (json / trace).
+  Instrumentation::init("04-complex-adapt");
+
   // Load the mesh.
   Mesh mesh;
   MeshReaderH2D mloader;
@@ -83,8 +87,11 @@ int main(int argc, char* argv[])
   H1Space<std::complex<double> > space(&mesh, &bcs, P_INIT);
   int ndof = space.get_num_dofs();
 
-  // Initialize the weak formulation.
-  CustomWeakForm wf("Air", MU_0, "Iron", MU_IRON, GAMMA_IRON,
+  // Initialize the weak formulation, with 1 / mu per area marker of the mesh
+  // (the reference meshes are copies of it, with the same markers).
+  MarkerIndex index;
+  index.update(&mesh);
+  CustomWeakForm wf(index, "Air", MU_0, "Iron", MU_IRON, GAMMA_IRON,
     "Wire", MU_0, std::complex<double>(J_EXT, 0.0), OMEGA);
 
   // Initialize coarse and reference mesh solution.
@@ -103,11 +110,16 @@ int main(int argc, char* argv[])
   int as = 1; bool done = false;
   do
   {
+    Instrumentation::ScopedTimer adaptivity_step_timer("adaptivity step");
+    Instrumentation::count("adaptivity steps");
+
     // Construct globally refined reference mesh and setup reference space.
+    Instrumentation::ScopedTimer reference_space_timer("reference space");
     Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
     Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
     Space<std::complex<double> >::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
     Space<std::complex<double> >* ref_space = ref_space_creator.create_ref_space();
+    reference_space_timer.stop();
 
     newton.set_space(ref_space);
 
@@ -128,6 +140,7 @@ int main(int argc, char* argv[])
     }
     try
     {
+      Instrumentation::ScopedTimer timer("newton");
       newton.solve(coeff_vec);
     }
     catch(Hermes::Exceptions::Exception& e)
@@ -137,17 +150,22 @@ int main(int argc, char* argv[])
     Hermes::Hermes2D::Solution<std::complex<double> >::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
 
     // Project the fine mesh solution onto the coarse mesh.
+    Instrumentation::ScopedTimer projection_timer("projection");
     OGProjection<std::complex<double> > ogProjection;
     ogProjection.project_global(&space, &ref_sln, &sln);
+    projection_timer.stop();
 
     // Calculate element errors and total error estimate.
+    Instrumentation::ScopedTimer error_estimation_timer("error estimation");
     Adapt<std::complex<double> >* adaptivity = new Adapt<std::complex<double> >(&space);
     double err_est_rel = adaptivity->calc_err_est(&sln, &ref_sln) * 100;
+    error_estimation_timer.stop();
 
     // If err_est too large, adapt the mesh.
     if(err_est_rel < ERR_STOP) done = true;
     else
     {
+      Instrumentation::ScopedTimer timer("adapt");
       done = adaptivity->adapt(&selector, THRESHOLD, STRATEGY, MESH_REGULARITY);
     }
     if(space.get_num_dofs() >= NDOF_STOP) done = true;
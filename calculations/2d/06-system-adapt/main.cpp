@@ -1,6 +1,8 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "instrumentation.h"
+#include "point_locator.h"
 
 // This example explains how to use the multimesh adaptive hp-FEM,
 // where different physical fields (or solution components) can be
@@ -94,6 +96,9 @@ const double K = 100.;
 
 int main(int argc, char* argv[])
 {
+  // Timers and counters, output selected by HERMES_INSTRUMENTATION (json / trace).
+  Instrumentation::init("06-system-adapt");
+
   // Time measurement.
   Hermes::Mixins::TimeMeasurable cpu_time;
   cpu_time.tick();
@@ -145,7 +150,11 @@ int main(int argc, char* argv[])
   bool done = false;
   do
   {
+    Instrumentation::ScopedTimer adaptivity_step_timer("adaptivity step");
+    Instrumentation::count("adaptivity steps");
+
     // Construct globally refined reference mesh and setup reference space.
+    Instrumentation::ScopedTimer reference_space_timer("reference space");
     Mesh::ReferenceMeshCreator u_ref_mesh_creator(&u_mesh);
     Mesh* u_ref_mesh = u_ref_mesh_creator.create_ref_mesh();
     Mesh::ReferenceMeshCreator v_ref_mesh_creator(&v_mesh);
@@ -154,6 +163,7 @@ int main(int argc, char* argv[])
     Space<double>* u_ref_space = u_ref_space_creator.create_ref_space();
     Space<double>::ReferenceSpaceCreator v_ref_space_creator(&v_space, v_ref_mesh);
     Space<double>* v_ref_space = v_ref_space_creator.create_ref_space();
+    reference_space_timer.stop();
 
     Hermes::vector<const Space<double> *> ref_spaces_const(u_ref_space, v_ref_space);
 
@@ -168,6 +178,7 @@ int main(int argc, char* argv[])
 
       newton.set_newton_tol(1e-1);
 
+      Instrumentation::ScopedTimer timer("newton");
       newton.solve();
     }
     catch(Hermes::Exceptions::Exception& e)
@@ -184,11 +195,14 @@ int main(int argc, char* argv[])
                                           Hermes::vector<Solution<double> *>(&u_ref_sln, &v_ref_sln));
 
     // Project the fine mesh solution onto the coarse mesh.
+    Instrumentation::ScopedTimer projection_timer("projection");
     OGProjection<double> ogProjection; ogProjection.project_global(Hermes::vector<const Space<double> *>(&u_space, &v_space),
                                                                    Hermes::vector<Solution<double> *>(&u_ref_sln, &v_ref_sln),
                                                                    Hermes::vector<Solution<double> *>(&u_sln, &v_sln));
+    projection_timer.stop();
 
     // Calculate element errors.
+    Instrumentation::ScopedTimer error_estimation_timer("error estimation");
     Adapt<double>* adaptivity = new Adapt<double>(Hermes::vector<Space<double> *>(&u_space, &v_space));
 
     // Calculate error estimate for each solution component and the total error estimate.
@@ -196,12 +210,14 @@ int main(int argc, char* argv[])
     double err_est_rel_total = adaptivity->calc_err_est(Hermes::vector<Solution<double> *>(&u_sln, &v_sln),
                                                         Hermes::vector<Solution<double> *>(&u_ref_sln, &v_ref_sln),
                                                         &err_est_rel) * 100;
+    error_estimation_timer.stop();
 
     // If err_est too large, adapt the mesh.
     if (err_est_rel_total < ERR_STOP)
       done = true;
     else
     {
+      Instrumentation::ScopedTimer timer("adapt");
       done = adaptivity->adapt(Hermes::vector<RefinementSelectors::Selector<double> *>(&selector, &selector),
                                THRESHOLD, STRATEGY, MESH_REGULARITY);
     }
@@ -215,68 +231,23 @@ int main(int argc, char* argv[])
   }
   while (done == false);
 
-	if(std::abs(u_ref_sln.get_pt_value(-0.98, -0.98)->val[0]- 0.000986633) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(v_ref_sln.get_pt_value(-0.98, -0.98)->val[0]- 0.747675) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(u_ref_sln.get_pt_value(-0.98, 0.98)->val[0]- 0.000986633) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(v_ref_sln.get_pt_value(-0.98, 0.98)->val[0]- 0.747675) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-
-	if(std::abs(u_ref_sln.get_pt_value(-0.98, -0.98)->dx[0]- 0.0493155) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(v_ref_sln.get_pt_value(-0.98, -0.98)->dx[0]- 11.7667) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(u_ref_sln.get_pt_value(-0.98, 0.98)->dx[0]- 0.0493155) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(v_ref_sln.get_pt_value(-0.98, 0.98)->dx[0]- 11.7667) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-
-	if(std::abs(u_ref_sln.get_pt_value(-0.98, -0.98)->dy[0]- 0.0493155) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(v_ref_sln.get_pt_value(-0.98, -0.98)->dy[0]- 11.7667) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(u_ref_sln.get_pt_value(-0.98, 0.98)->dy[0] + 0.0493155) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
-	if(std::abs(v_ref_sln.get_pt_value(-0.98, 0.98)->dy[0] + 11.7667) > 1e-4) 
-	{
-		printf("Failure!\n");
-		return -1;
-	}
+  // The probes, value (item 0) and derivatives (1 = dx, 2 = dy) at two points of both components,
+  // each component located on its own reference mesh.
+  PointLocator u_locator(u_ref_sln.get_mesh()), v_locator(v_ref_sln.get_mesh());
+  const double probe_y[2] = { -0.98, 0.98 };
+  const double u_expected[2][3] = { { 0.000986633, 0.0493155, 0.0493155 }, { 0.000986633, 0.0493155, -0.0493155 } };
+  const double v_expected[2][3] = { { 0.747675, 11.7667, 11.7667 }, { 0.747675, 11.7667, -11.7667 } };
+  for (int i = 0; i < 2; i++)
+    for (int item = 0; item < 3; item++)
+    {
+      double u_value, v_value;
+      if(!u_locator.get_value(&u_ref_sln, -0.98, probe_y[i], u_value, item) || std::abs(u_value - u_expected[i][item]) > 1e-4
+        || !v_locator.get_value(&v_ref_sln, -0.98, probe_y[i], v_value, item) || std::abs(v_value - v_expected[i][item]) > 1e-4)
+      {
+        printf("Failure!\n");
+        return -1;
+      }
+    }
 
 	printf("Success!\n");
 	return 0;
@@ -1,6 +1,8 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "point_locator.h"
+#include "functional_evaluator.h"
 
 using namespace RefinementSelectors;
 
@@ -12,6 +14,7 @@ const int INIT_REF_NUM_BDY = 3;                   // Number of initial uniform m
 const double time_step = 1;                       // Time step in seconds.
 const double NEWTON_TOL = 1e-5;                   // Stopping criterion for the Newton's method.
 const int NEWTON_MAX_ITER = 100;                  // Maximum allowed number of Newton iterations.
+const int NUM_THREADS = 4;                        // Number of threads of the evaluation of the heat flux.
 
 // Choose one of the following time-integration methods, or define your own Butcher's table. The last number
 // in the name of each method is its order. The one before last, if present, is the number of stages.
@@ -39,6 +42,21 @@ const double HEATCAP = 1e2;        // Heat capacity.
 const double RHO = 3000;           // Material density.
 const double T_FINAL = 5*time_step;
 
+// Heat flux out of the domain through the boundary, -LAMBDA int grad T . n.
+class HeatFlux : public Functional
+{
+public:
+  HeatFlux(std::string boundary) : Functional(Hermes::vector<std::string>(), Hermes::vector<std::string>(boundary)) {}
+
+  double surface(const FunctionalValues& values) const
+  {
+    double result = 0.0;
+    for(int i = 0; i < values.n; i++)
+      result -= values.wt[i] * LAMBDA * (values.dx[0][i] * values.nx[i] + values.dy[0][i] * values.ny[i]);
+    return result;
+  }
+};
+
 int main(int argc, char* argv[])
 {
   // Choose a Butcher's table or define your own.
@@ -110,11 +128,26 @@ int main(int argc, char* argv[])
 
   bool success = true;
 
-  if(fabs(sln_time_new->get_pt_value(-3.5, 17.0)->val[0] - 10.00271206) > 1E-6) success = false;
-  if(fabs(sln_time_new->get_pt_value(-1.0, 2.0)->val[0] - 10.0) > 1E-6) success = false;
-  if(fabs(sln_time_new->get_pt_value(0.0, 9.5)->val[0] - 10.00005812) > 1E-6) success = false;
-  if(fabs(sln_time_new->get_pt_value( 1.0, 2.0)->val[0] - 10.0) > 1E-6) success = false;
-  if(fabs(sln_time_new->get_pt_value(3.5, 17.0)->val[0] - 10.00271206) > 1E-6) success = false;
+  PointLocator locator(&mesh);
+  const double probe_x[5] = { -3.5, -1.0, 0.0, 1.0, 3.5 };
+  const double probe_y[5] = { 17.0, 2.0, 9.5, 2.0, 17.0 };
+  const double expected[5] = { 10.00271206, 10.0, 10.00005812, 10.0, 10.00271206 };
+  for(int i = 0; i < 5; i++)
+  {
+    double value;
+    if(!locator.get_value(sln_time_new, probe_x[i], probe_y[i], value) || fabs(value - expected[i]) > 1E-6)
+      success = false;
+  }
+
+  // The heat flux through the boundary with the air, by one thread and by several, which have to agree.
+  HeatFlux heat_flux("Boundary_air");
+  FunctionalEvaluator evaluator(&mesh, Hermes::vector<MeshFunction<double>*>(sln_time_new));
+  evaluator.add(&heat_flux);
+  double flux = evaluator.evaluate(1)[0];
+  double flux_threads = evaluator.evaluate(NUM_THREADS)[0];
+  printf("Heat flux through Boundary_air: %g.\n", flux);
+  if(fabs(flux - flux_threads) > 1e-10 * (1.0 + fabs(flux)))
+    success = false;
 
   if(success)
   {
@@ -0,0 +1,235 @@
+#include "allocation_counter.h"
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// The counters are plain integers, so that they are usable from the very first allocation
+// (before any static constructor has run).
+static bool allocation_counter_enabled = false;
+static unsigned long allocation_count = 0;
+static unsigned long allocated_bytes = 0;
+static long heap_in_use = 0;
+static long heap_peak = 0;
+
+void AllocationCounter::register_allocation(size_t size)
+{
+  allocation_counter_enabled = true;
+#ifdef __GNUC__
+  __sync_add_and_fetch(&allocation_count, 1);
+  __sync_add_and_fetch(&allocated_bytes, size);
+  long in_use = __sync_add_and_fetch(&heap_in_use, (long)size);
+  long peak = heap_peak;
+  while(in_use > peak && !__sync_bool_compare_and_swap(&heap_peak, peak, in_use))
+    peak = heap_peak;
+#else
+  allocation_count++;
+  allocated_bytes += size;
+  heap_in_use += size;
+  if(heap_in_use > heap_peak)
+    heap_peak = heap_in_use;
+#endif
+}
+
+void AllocationCounter::register_free(size_t size)
+{
+#ifdef __GNUC__
+  __sync_sub_and_fetch(&heap_in_use, (long)size);
+#else
+  heap_in_use -= size;
+#endif
+}
+
+bool AllocationCounter::is_enabled()
+{
+  return allocation_counter_enabled;
+}
+
+// Peak resident set size of the process in kB (the high-water mark, it never decreases).
+static double get_peak_rss()
+{
+#ifdef _WIN32
+  return 0.0;
+#else
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024.0;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Phase names are saved with underscores instead of spaces, so that the columns stay separated.
+static std::string to_column(std::string phase)
+{
+  std::replace(phase.begin(), phase.end(), ' ', '_');
+  return phase;
+}
+
+const double AllocationCounter::RSS_SLACK = 1024.0;
+
+AllocationCounter::AllocationCounter(const std::string& name) : name(name), start_allocations(0.0), start_bytes(0.0), start_rss(0.0)
+{
+}
+
+void AllocationCounter::begin()
+{
+  this->skip();
+}
+
+void AllocationCounter::tick(const std::string& phase)
+{
+  this->record(phase);
+  // The bookkeeping in record() is not attributed to the next phase.
+  this->skip();
+}
+
+void AllocationCounter::skip()
+{
+  this->start_allocations = allocation_count;
+  this->start_bytes = allocated_bytes;
+  this->start_rss = get_peak_rss();
+  heap_peak = heap_in_use;
+}
+
+void AllocationCounter::record(const std::string& phase)
+{
+  Phase current;
+  current.allocations = allocation_count - this->start_allocations;
+  current.bytes = allocated_bytes - this->start_bytes;
+  current.peak_heap = heap_peak;
+  current.rss_growth = get_peak_rss() - this->start_rss;
+  current.tolerance = 0.0;
+
+  std::map<std::string, Phase>::iterator it = this->values.find(phase);
+  if(it == this->values.end())
+  {
+    this->phases.push_back(phase);
+    this->values.insert(std::pair<std::string, Phase>(phase, current));
+  }
+  else
+  {
+    it->second.allocations += current.allocations;
+    it->second.bytes += current.bytes;
+    it->second.peak_heap = std::max(it->second.peak_heap, current.peak_heap);
+    it->second.rss_growth += current.rss_growth;
+  }
+}
+
+const std::vector<std::string>& AllocationCounter::get_phases() const
+{
+  return this->phases;
+}
+
+AllocationCounter::Phase AllocationCounter::get_phase(const std::string& phase) const
+{
+  std::map<std::string, Phase>::const_iterator it = this->values.find(phase);
+  if(it == this->values.end())
+    throw Hermes::Exceptions::Exception("Phase %s was not recorded.", phase.c_str());
+  return it->second;
+}
+
+void AllocationCounter::print_summary() const
+{
+  if(!is_enabled())
+  {
+    printf("Allocation counter %s: the allocations are not counted (WITH_ALLOCATION_COUNTER not set).\n", this->name.c_str());
+    return;
+  }
+
+  printf("Allocation counter %s:\n", this->name.c_str());
+  printf("  %-24s %14s %16s %16s %14s\n", "phase", "allocations", "bytes", "peak heap [B]", "RSS growth [kB]");
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    Phase p = this->get_phase(this->phases[i]);
+    printf("  %-24s %14.0f %16.0f %16.0f %14.0f\n", this->phases[i].c_str(), p.allocations, p.bytes, p.peak_heap, p.rss_growth);
+  }
+}
+
+void AllocationCounter::save(const char* filename, double tolerance) const
+{
+  std::map<std::string, Phase> previous = load(filename, tolerance);
+
+  FILE* file = fopen(filename, "w");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
+
+  fprintf(file, "# Allocation baseline of %s, checked when built with WITH_ALLOCATION_COUNTER.\n", this->name.c_str());
+  fprintf(file, "# phase allocations bytes peak_heap rss_growth_kB tolerance\n");
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    Phase p = this->get_phase(this->phases[i]);
+    std::map<std::string, Phase>::iterator it = previous.find(to_column(this->phases[i]));
+    fprintf(file, "%s %.0f %.0f %.0f %.0f %g\n", to_column(this->phases[i]).c_str(), p.allocations, p.bytes, p.peak_heap,
+      p.rss_growth, it == previous.end() ? tolerance : it->second.tolerance);
+  }
+
+  fclose(file);
+}
+
+std::map<std::string, AllocationCounter::Phase> AllocationCounter::load(const char* filename, double tolerance)
+{
+  std::map<std::string, Phase> baseline;
+  FILE* file = fopen(filename, "r");
+  if(file == NULL)
+    return baseline;
+
+  char line[1024];
+  while(fgets(line, 1024, file) != NULL)
+  {
+    if(line[0] == '#')
+      continue;
+    char phase[256];
+    Phase p;
+    int read = sscanf(line, "%255s %lf %lf %lf %lf %lf", phase, &p.allocations, &p.bytes, &p.peak_heap, &p.rss_growth, &p.tolerance);
+    if(read == 5)
+      p.tolerance = tolerance;
+    if(read >= 5)
+      baseline[phase] = p;
+  }
+  fclose(file);
+  return baseline;
+}
+
+bool AllocationCounter::check(const char* baseline_filename, double tolerance) const
+{
+  if(!is_enabled())
+    return true;
+
+  FILE* file = fopen(baseline_filename, "r");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open the allocation baseline %s.", baseline_filename);
+  fclose(file);
+  std::map<std::string, Phase> baseline = load(baseline_filename, tolerance);
+
+  const char* quantities[4] = { "allocations", "bytes", "peak heap", "RSS growth" };
+  bool passed = true;
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    std::map<std::string, Phase>::iterator it = baseline.find(to_column(this->phases[i]));
+    if(it == baseline.end())
+    {
+      printf("Allocation counter %s: phase '%s' has no baseline (record it by the 'record' argument).\n",
+        this->name.c_str(), this->phases[i].c_str());
+      passed = false;
+      continue;
+    }
+
+    Phase p = this->get_phase(this->phases[i]);
+    double measured[4] = { p.allocations, p.bytes, p.peak_heap, p.rss_growth };
+    double allowed[4] = { it->second.allocations, it->second.bytes, it->second.peak_heap, it->second.rss_growth };
+    for(int j = 0; j < 4; j++)
+    {
+      if(measured[j] > allowed[j] * (1.0 + it->second.tolerance) + (j == 3 ? RSS_SLACK : 0.0))
+      {
+        printf("Allocation counter %s: phase '%s', %s %.0f over the baseline %.0f (tolerance %g).\n", this->name.c_str(),
+          this->phases[i].c_str(), quantities[j], measured[j], allowed[j], it->second.tolerance);
+        passed = false;
+      }
+    }
+  }
+
+  return passed;
+}
@@ -0,0 +1,97 @@
+#ifndef __HERMES_TESTING_ALLOCATION_COUNTER_H
+#define __HERMES_TESTING_ALLOCATION_COUNTER_H
+
+#include "hermes_common.h"
+
+/// Number of heap allocations, allocated bytes, peak heap and growth of the resident memory of the
+/// individual phases of a computation, checked against a baseline file.
+///
+/// The allocations are counted by the interposing allocator in the library hermes-testing-allocation-counter,
+/// which is linked into the memory-leaks targets when WITH_ALLOCATION_COUNTER is set (see CMake.vars).
+/// Without it, nothing is counted and check() always passes.
+///
+/// Typical usage in a test main:
+///   AllocationCounter counter("02-memory-adapt");
+///   counter.begin();
+///   mloader.load("domain.mesh", &mesh);
+///   counter.tick("mesh load");
+///   ...
+///   return counter.check(baseline_filename) ? 0 : -1;
+///
+/// Like in Benchmark, the allocations between two calls of tick() are attributed to the phase named
+/// in the latter one and a phase ticked several times (e.g. in an adaptivity loop) accumulates.
+class AllocationCounter
+{
+public:
+  AllocationCounter(const std::string& name);
+
+  /// Values of one phase.
+  struct Phase
+  {
+    /// Number of allocations (malloc, calloc, realloc, new, ...).
+    double allocations;
+    /// Sum of the sizes of the allocated blocks.
+    double bytes;
+    /// Maximum of the heap in use during the phase (in bytes).
+    double peak_heap;
+    /// Growth of the peak resident set size of the process during the phase (in kB). The peak of
+    /// the process never decreases, so this is how much the phase raised it, 0 if it stayed below.
+    double rss_growth;
+    /// Relative tolerance of the values (only used in baselines).
+    double tolerance;
+  };
+
+  /// Starts the counting.
+  void begin();
+
+  /// Attributes the allocations since the last tick() (or begin()) to the phase.
+  void tick(const std::string& phase);
+
+  /// Discards the allocations since the last tick().
+  void skip();
+
+  const std::vector<std::string>& get_phases() const;
+  Phase get_phase(const std::string& phase) const;
+
+  /// Prints the table of phases.
+  void print_summary() const;
+
+  /// Saves the phases in the baseline format, i.e. whitespace-separated columns
+  /// phase, allocations, bytes, peak heap, RSS growth, relative tolerance with a commented header.
+  /// A recorded baseline keeps the tolerances of the phases already present in the file.
+  void save(const char* filename, double tolerance = 0.1) const;
+
+  /// Compares the phases with the baseline, returns false (and reports the phase and the quantity)
+  /// if any value exceeds the baseline value by more than the relative tolerance of the phase (the
+  /// last column of the baseline, the argument for lines without it; the RSS growth also by more
+  /// than RSS_SLACK, the resident memory grows by whole pages and allocator chunks), or if a phase
+  /// is missing in the baseline, so that an empty baseline is not a passed check.
+  /// Without the interposing allocator nothing is compared and the check passes.
+  bool check(const char* baseline_filename, double tolerance = 0.1) const;
+
+  /// Absolute tolerance of the RSS growth (in kB).
+  static const double RSS_SLACK;
+
+  /// True if the interposing allocator is linked in.
+  static bool is_enabled();
+
+  /// Called by the interposing allocator.
+  static void register_allocation(size_t size);
+  static void register_free(size_t size);
+
+private:
+  void record(const std::string& phase);
+
+  /// Reads a baseline, lines without the tolerance get the given one. A missing file gives no phases.
+  static std::map<std::string, Phase> load(const char* filename, double tolerance);
+
+  std::string name;
+  std::vector<std::string> phases;
+  std::map<std::string, Phase> values;
+
+  double start_allocations;
+  double start_bytes;
+  double start_rss;
+};
+
+#endif
@@ -0,0 +1,162 @@
+// Interposing allocator counting all heap allocations of the process into AllocationCounter.
+// Linked (as the library hermes-testing-allocation-counter) only into the targets built
+// with WITH_ALLOCATION_COUNTER.
+#include "allocation_counter.h"
+#include <new>
+
+#ifdef __GLIBC__
+// With glibc, malloc & co. (and with them operator new of libstdc++) are replaced by wrappers
+// of the internal __libc_* functions. The sizes are the usable sizes of the blocks, so that
+// a block is counted with the same size when allocated and freed.
+#include <malloc.h>
+#include <errno.h>
+
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void* ptr, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void __libc_free(void* ptr);
+
+  void* malloc(size_t size)
+  {
+    void* ptr = __libc_malloc(size);
+    if(ptr != NULL)
+      AllocationCounter::register_allocation(malloc_usable_size(ptr));
+    return ptr;
+  }
+
+  void* calloc(size_t n, size_t size)
+  {
+    void* ptr = __libc_calloc(n, size);
+    if(ptr != NULL)
+      AllocationCounter::register_allocation(malloc_usable_size(ptr));
+    return ptr;
+  }
+
+  void* realloc(void* ptr, size_t size)
+  {
+    size_t old_size = ptr == NULL ? 0 : malloc_usable_size(ptr);
+    void* new_ptr = __libc_realloc(ptr, size);
+    if(new_ptr != NULL)
+    {
+      if(ptr != NULL)
+        AllocationCounter::register_free(old_size);
+      AllocationCounter::register_allocation(malloc_usable_size(new_ptr));
+    }
+    // realloc(ptr, 0) frees the block.
+    else if(size == 0 && ptr != NULL)
+      AllocationCounter::register_free(old_size);
+    return new_ptr;
+  }
+
+  void* memalign(size_t alignment, size_t size)
+  {
+    void* ptr = __libc_memalign(alignment, size);
+    if(ptr != NULL)
+      AllocationCounter::register_allocation(malloc_usable_size(ptr));
+    return ptr;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size)
+  {
+    return memalign(alignment, size);
+  }
+
+  int posix_memalign(void** ptr, size_t alignment, size_t size)
+  {
+    if(alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+      return EINVAL;
+    *ptr = memalign(alignment, size);
+    return (*ptr == NULL && size != 0) ? ENOMEM : 0;
+  }
+
+  void free(void* ptr)
+  {
+    if(ptr == NULL)
+      return;
+    AllocationCounter::register_free(malloc_usable_size(ptr));
+    __libc_free(ptr);
+  }
+}
+
+#else
+// Elsewhere only operator new / delete are replaced, the size is kept in a header
+// in front of the block (aligned to 16 bytes).
+#include <cstdlib>
+
+static const size_t header_size = 16;
+
+// Dynamic exception specifications are ill-formed since C++17: operator new is declared without one
+// and the others noexcept (as in <new>), C++98 compilers get the old ones.
+#if __cplusplus >= 201103L
+#define COUNTED_NEW_THROW
+#define COUNTED_NOTHROW noexcept
+#else
+#define COUNTED_NEW_THROW throw(std::bad_alloc)
+#define COUNTED_NOTHROW throw()
+#endif
+
+static void* counted_allocation(size_t size)
+{
+  char* block = (char*)std::malloc(size + header_size);
+  if(block == NULL)
+    return NULL;
+  *(size_t*)block = size;
+  AllocationCounter::register_allocation(size);
+  return block + header_size;
+}
+
+static void counted_free(void* ptr)
+{
+  if(ptr == NULL)
+    return;
+  char* block = (char*)ptr - header_size;
+  AllocationCounter::register_free(*(size_t*)block);
+  std::free(block);
+}
+
+void* operator new(size_t size) COUNTED_NEW_THROW
+{
+  void* ptr = counted_allocation(size ? size : 1);
+  if(ptr == NULL)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size) COUNTED_NEW_THROW
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) COUNTED_NOTHROW
+{
+  return counted_allocation(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) COUNTED_NOTHROW
+{
+  return counted_allocation(size ? size : 1);
+}
+
+void operator delete(void* ptr) COUNTED_NOTHROW
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void* ptr) COUNTED_NOTHROW
+{
+  counted_free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) COUNTED_NOTHROW
+{
+  counted_free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) COUNTED_NOTHROW
+{
+  counted_free(ptr);
+}
+#endif
@@ -0,0 +1,293 @@
+#include "benchmark.h"
+#include "json_escape.h"
+#include <algorithm>
+
+Benchmark::Benchmark(const std::string& name) : name(name), runs(0)
+{
+}
+
+void Benchmark::begin_run()
+{
+  this->runs++;
+  this->timer.tick();
+}
+
+double Benchmark::tick(const std::string& phase)
+{
+  this->timer.tick();
+  this->add(phase, this->timer.last());
+  return this->timer.last();
+}
+
+void Benchmark::skip()
+{
+  this->timer.tick(Hermes::Mixins::HERMES_SKIP);
+}
+
+void Benchmark::add(const std::string& phase, double seconds)
+{
+  this->record(this->phases, this->times, phase, seconds, true);
+}
+
+void Benchmark::set_metric(const std::string& name, double value)
+{
+  this->record(this->metrics, this->metric_values, name, value, false);
+}
+
+void Benchmark::record(std::vector<std::string>& names, std::map<std::string, std::vector<double> >& values,
+  const std::string& name, double value, bool accumulate)
+{
+  if(this->runs == 0)
+    throw Hermes::Exceptions::Exception("Benchmark::begin_run() has to be called before recording any values.");
+
+  std::map<std::string, std::vector<double> >::iterator it = values.find(name);
+  if(it == values.end())
+  {
+    names.push_back(name);
+    it = values.insert(std::pair<std::string, std::vector<double> >(name, std::vector<double>())).first;
+  }
+
+  // A phase that did not occur in some of the previous runs took no time there.
+  it->second.resize(this->runs, 0.0);
+  if(accumulate)
+    it->second[this->runs - 1] += value;
+  else
+    it->second[this->runs - 1] = value;
+}
+
+double Benchmark::get_current(const std::string& phase) const
+{
+  std::map<std::string, std::vector<double> >::const_iterator it = this->times.find(phase);
+  if(it == this->times.end() || (int)it->second.size() < this->runs)
+    return 0.0;
+  return it->second[this->runs - 1];
+}
+
+double Benchmark::get_current_metric(const std::string& name) const
+{
+  std::map<std::string, std::vector<double> >::const_iterator it = this->metric_values.find(name);
+  if(it == this->metric_values.end() || (int)it->second.size() < this->runs)
+    return 0.0;
+  return it->second[this->runs - 1];
+}
+
+const std::vector<std::string>& Benchmark::get_phases() const
+{
+  return this->phases;
+}
+
+const std::vector<std::string>& Benchmark::get_metrics() const
+{
+  return this->metrics;
+}
+
+const std::string& Benchmark::get_name() const
+{
+  return this->name;
+}
+
+int Benchmark::get_runs() const
+{
+  return this->runs;
+}
+
+Benchmark::Statistics Benchmark::calculate_statistics(std::vector<double> values)
+{
+  Statistics statistics;
+  statistics.samples = values.size();
+  statistics.median = statistics.min = statistics.max = statistics.mean = statistics.stddev = 0.0;
+  if(values.empty())
+    return statistics;
+
+  std::sort(values.begin(), values.end());
+  int n = values.size();
+  statistics.min = values[0];
+  statistics.max = values[n - 1];
+  statistics.median = (n % 2) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+
+  for(int i = 0; i < n; i++)
+    statistics.mean += values[i];
+  statistics.mean /= n;
+
+  if(n > 1)
+  {
+    for(int i = 0; i < n; i++)
+      statistics.stddev += (values[i] - statistics.mean) * (values[i] - statistics.mean);
+    statistics.stddev = std::sqrt(statistics.stddev / (n - 1));
+  }
+
+  return statistics;
+}
+
+Benchmark::Statistics Benchmark::get_statistics(const std::string& phase) const
+{
+  std::map<std::string, std::vector<double> >::const_iterator it = this->times.find(phase);
+  std::vector<double> values;
+  if(it != this->times.end())
+    values = it->second;
+  values.resize(this->runs, 0.0);
+  return calculate_statistics(values);
+}
+
+Benchmark::Statistics Benchmark::get_metric_statistics(const std::string& name) const
+{
+  std::map<std::string, std::vector<double> >::const_iterator it = this->metric_values.find(name);
+  if(it == this->metric_values.end())
+    return calculate_statistics(std::vector<double>());
+  return calculate_statistics(it->second);
+}
+
+void Benchmark::print_summary() const
+{
+  printf("Benchmark %s, %d run(s), times in seconds:\n", this->name.c_str(), this->runs);
+  printf("  %-24s %12s %12s %12s %12s\n", "phase", "median", "min", "max", "stddev");
+  double total = 0.0;
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    Statistics s = this->get_statistics(this->phases[i]);
+    printf("  %-24s %12.6f %12.6f %12.6f %12.6f\n", this->phases[i].c_str(), s.median, s.min, s.max, s.stddev);
+    total += s.median;
+  }
+  printf("  %-24s %12.6f\n", "sum of medians", total);
+
+  for(unsigned int i = 0; i < this->metrics.size(); i++)
+  {
+    Statistics s = this->get_metric_statistics(this->metrics[i]);
+    printf("  %-24s %12g\n", this->metrics[i].c_str(), s.median);
+  }
+}
+
+void Benchmark::save_json(const char* filename) const
+{
+  FILE* file = fopen(filename, "w");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
+
+  fprintf(file, "{\n  \"benchmark\": \"%s\",\n  \"runs\": %d,\n  \"unit\": \"s\",\n  \"phases\": [", json_escape(this->name.c_str()).c_str(), this->runs);
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    Statistics s = this->get_statistics(this->phases[i]);
+    fprintf(file, "%s\n    {\"name\": \"%s\", \"median\": %.9g, \"min\": %.9g, \"max\": %.9g, \"mean\": %.9g, \"stddev\": %.9g, \"samples\": [",
+      i ? "," : "", json_escape(this->phases[i].c_str()).c_str(), s.median, s.min, s.max, s.mean, s.stddev);
+    std::vector<double> values = this->times.find(this->phases[i])->second;
+    values.resize(this->runs, 0.0);
+    for(unsigned int j = 0; j < values.size(); j++)
+      fprintf(file, "%s%.9g", j ? ", " : "", values[j]);
+    fprintf(file, "]}");
+  }
+  fprintf(file, "\n  ],\n  \"metrics\": [");
+  for(unsigned int i = 0; i < this->metrics.size(); i++)
+  {
+    Statistics s = this->get_metric_statistics(this->metrics[i]);
+    fprintf(file, "%s\n    {\"name\": \"%s\", \"median\": %.9g, \"min\": %.9g, \"max\": %.9g}",
+      i ? "," : "", json_escape(this->metrics[i].c_str()).c_str(), s.median, s.min, s.max);
+  }
+  fprintf(file, "\n  ]\n}\n");
+
+  fclose(file);
+}
+
+void Benchmark::save_csv(const char* filename, bool append) const
+{
+  FILE* file = fopen(filename, append ? "a" : "w");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
+
+  if(!append)
+    fprintf(file, "benchmark,kind,name,runs,median,min,max,mean,stddev\n");
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    Statistics s = this->get_statistics(this->phases[i]);
+    fprintf(file, "%s,phase,%s,%d,%.9g,%.9g,%.9g,%.9g,%.9g\n", this->name.c_str(), this->phases[i].c_str(),
+      s.samples, s.median, s.min, s.max, s.mean, s.stddev);
+  }
+  for(unsigned int i = 0; i < this->metrics.size(); i++)
+  {
+    Statistics s = this->get_metric_statistics(this->metrics[i]);
+    fprintf(file, "%s,metric,%s,%d,%.9g,%.9g,%.9g,%.9g,%.9g\n", this->name.c_str(), this->metrics[i].c_str(),
+      s.samples, s.median, s.min, s.max, s.mean, s.stddev);
+  }
+
+  fclose(file);
+}
+
+BenchmarkTable::BenchmarkTable()
+{
+}
+
+void BenchmarkTable::begin_row()
+{
+  this->rows.push_back(std::map<std::string, double>());
+}
+
+void BenchmarkTable::set(const std::string& column, double value)
+{
+  if(this->rows.empty())
+    throw Hermes::Exceptions::Exception("BenchmarkTable::begin_row() has to be called before setting any values.");
+
+  if(std::find(this->columns.begin(), this->columns.end(), column) == this->columns.end())
+    this->columns.push_back(column);
+  this->rows.back()[column] = value;
+}
+
+double BenchmarkTable::get(int row, const std::string& column) const
+{
+  std::map<std::string, double>::const_iterator it = this->rows[row].find(column);
+  return it == this->rows[row].end() ? 0.0 : it->second;
+}
+
+int BenchmarkTable::get_num_rows() const
+{
+  return this->rows.size();
+}
+
+const std::vector<std::string>& BenchmarkTable::get_columns() const
+{
+  return this->columns;
+}
+
+void BenchmarkTable::save(const char* filename) const
+{
+  FILE* file = fopen(filename, "w");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
+
+  // Spaces in the column names would break the columns, they are replaced by underscores.
+  fprintf(file, "#");
+  for(unsigned int i = 0; i < this->columns.size(); i++)
+  {
+    std::string column = this->columns[i];
+    std::replace(column.begin(), column.end(), ' ', '_');
+    fprintf(file, " %s", column.c_str());
+  }
+  fprintf(file, "\n");
+
+  for(unsigned int row = 0; row < this->rows.size(); row++)
+  {
+    for(unsigned int i = 0; i < this->columns.size(); i++)
+      fprintf(file, "%s%.9g", i ? " " : "", this->get(row, this->columns[i]));
+    fprintf(file, "\n");
+  }
+
+  fclose(file);
+}
+
+void BenchmarkTable::save_csv(const char* filename) const
+{
+  FILE* file = fopen(filename, "w");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
+
+  for(unsigned int i = 0; i < this->columns.size(); i++)
+    fprintf(file, "%s%s", i ? "," : "", this->columns[i].c_str());
+  fprintf(file, "\n");
+
+  for(unsigned int row = 0; row < this->rows.size(); row++)
+  {
+    for(unsigned int i = 0; i < this->columns.size(); i++)
+      fprintf(file, "%s%.9g", i ? "," : "", this->get(row, this->columns[i]));
+    fprintf(file, "\n");
+  }
+
+  fclose(file);
+}
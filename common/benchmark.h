@@ -0,0 +1,122 @@
+#ifndef __HERMES_TESTING_BENCHMARK_H
+#define __HERMES_TESTING_BENCHMARK_H
+
+#include "hermes_common.h"
+
+/// Wall-clock measurement of the individual phases of a computation over repeated runs.
+///
+/// Typical usage in a test main:
+///   Benchmark benchmark("01-performance-simple");
+///   for(int run = 0; run < runs; run++)
+///   {
+///     benchmark.begin_run();
+///     mloader.load("domain.xml", &mesh);
+///     benchmark.tick("mesh load");
+///     ...
+///   }
+///   benchmark.save_json("01-performance-simple-benchmark.json");
+///
+/// The time between two calls of tick() is attributed to the phase named in the latter one,
+/// a phase ticked several times within one run (e.g. in an adaptivity loop) accumulates.
+class Benchmark
+{
+public:
+  Benchmark(const std::string& name);
+
+  /// Statistics of one phase (or metric) over all runs.
+  struct Statistics
+  {
+    int samples;
+    double median;
+    double min;
+    double max;
+    double mean;
+    double stddev;
+  };
+
+  /// Starts a new run, resets the timer.
+  void begin_run();
+
+  /// Attributes the time elapsed since the last tick() (or begin_run()) to the phase.
+  /// Returns the elapsed time.
+  double tick(const std::string& phase);
+
+  /// Discards the time elapsed since the last tick() (visualization, output, ...).
+  void skip();
+
+  /// Adds an already measured time to the phase in the current run.
+  void add(const std::string& phase, double seconds);
+
+  /// Records a non-time quantity (number of DOFs, nonzeros, ...) of the current run.
+  void set_metric(const std::string& name, double value);
+
+  /// Value of the phase (metric) in the current run.
+  double get_current(const std::string& phase) const;
+  double get_current_metric(const std::string& name) const;
+
+  /// Phases (metrics) in the order of their first appearance.
+  const std::vector<std::string>& get_phases() const;
+  const std::vector<std::string>& get_metrics() const;
+
+  Statistics get_statistics(const std::string& phase) const;
+  Statistics get_metric_statistics(const std::string& name) const;
+
+  const std::string& get_name() const;
+  int get_runs() const;
+
+  /// Prints the table of phases with medians and spread.
+  void print_summary() const;
+
+  /// Machine-readable output (statistics together with all samples).
+  /// With append, the CSV rows are added to an existing file (e.g. of another benchmark) without the header.
+  void save_json(const char* filename) const;
+  void save_csv(const char* filename, bool append = false) const;
+
+  /// Computes the statistics of a set of samples.
+  static Statistics calculate_statistics(std::vector<double> values);
+
+private:
+  void record(std::vector<std::string>& names, std::map<std::string, std::vector<double> >& values,
+    const std::string& name, double value, bool accumulate);
+
+  std::string name;
+  int runs;
+  Hermes::Mixins::TimeMeasurable timer;
+
+  std::vector<std::string> phases;
+  std::map<std::string, std::vector<double> > times;
+
+  std::vector<std::string> metrics;
+  std::map<std::string, std::vector<double> > metric_values;
+};
+
+/// Table of values with one row per step of a computation (adaptivity step, time step, ...),
+/// e.g. the times of the phases of every step. Columns are created in the order of their first use.
+class BenchmarkTable
+{
+public:
+  BenchmarkTable();
+
+  /// Starts a new row, values not set in a row are saved as zeros.
+  void begin_row();
+
+  /// Sets the value in the current row.
+  void set(const std::string& column, double value);
+
+  double get(int row, const std::string& column) const;
+  int get_num_rows() const;
+  const std::vector<std::string>& get_columns() const;
+
+  /// Saves the table as whitespace-separated columns with a commented header
+  /// (the format of SimpleGraph output, readable by gnuplot).
+  void save(const char* filename) const;
+
+  /// Saves the table as CSV.
+  void save_csv(const char* filename) const;
+
+private:
+  std::vector<std::string> columns;
+  std::vector<std::map<std::string, double> > rows;
+};
+
+#endif
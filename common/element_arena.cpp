@@ -0,0 +1,115 @@
+#include "element_arena.h"
+#include <pthread.h>
+
+ElementArena::ElementArena(size_t block_size) : block_size(block_size), current(0), offset(0), used_before(0), num_heap_allocations(0)
+{
+  if(block_size == 0)
+    throw Hermes::Exceptions::Exception("ElementArena: the block size has to be positive.");
+}
+
+ElementArena::~ElementArena()
+{
+  for(unsigned int i = 0; i < this->blocks.size(); i++)
+    free(this->blocks[i]);
+}
+
+void ElementArena::add_block(size_t size)
+{
+  // ALIGNMENT bytes more, the start of the block is aligned in allocate().
+  char* block = (char*)malloc(size + ALIGNMENT);
+  if(block == NULL)
+    throw Hermes::Exceptions::Exception("ElementArena: out of memory.");
+  this->blocks.push_back(block);
+  this->block_sizes.push_back(size);
+  this->num_heap_allocations++;
+}
+
+void* ElementArena::allocate(size_t size)
+{
+  size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  while(true)
+  {
+    if(this->current < (int)this->blocks.size())
+    {
+      if(this->offset + size <= this->block_sizes[this->current])
+      {
+        char* start = this->blocks[this->current];
+        start += (ALIGNMENT - (size_t)start % ALIGNMENT) % ALIGNMENT;
+        void* ptr = start + this->offset;
+        this->offset += size;
+        return ptr;
+      }
+      // The rest of the block is wasted until reset().
+      this->used_before += this->offset;
+      this->current++;
+      this->offset = 0;
+    }
+    else
+      this->add_block(std::max(this->block_size, size));
+  }
+}
+
+void ElementArena::reset()
+{
+  if(this->current > 0)
+  {
+    // The element did not fit in one block, from now on it will.
+    size_t capacity = this->get_capacity();
+    for(unsigned int i = 0; i < this->blocks.size(); i++)
+      free(this->blocks[i]);
+    this->blocks.clear();
+    this->block_sizes.clear();
+    this->add_block(capacity);
+  }
+  this->current = 0;
+  this->offset = 0;
+  this->used_before = 0;
+}
+
+size_t ElementArena::get_used() const
+{
+  return this->used_before + this->offset;
+}
+
+size_t ElementArena::get_capacity() const
+{
+  size_t capacity = 0;
+  for(unsigned int i = 0; i < this->block_sizes.size(); i++)
+    capacity += this->block_sizes[i];
+  return capacity;
+}
+
+int ElementArena::get_num_blocks() const
+{
+  return this->blocks.size();
+}
+
+int ElementArena::get_num_heap_allocations() const
+{
+  return this->num_heap_allocations;
+}
+
+static pthread_key_t thread_arena_key;
+static pthread_once_t thread_arena_once = PTHREAD_ONCE_INIT;
+
+static void delete_thread_arena(void* arena)
+{
+  delete (ElementArena*)arena;
+}
+
+static void create_thread_arena_key()
+{
+  pthread_key_create(&thread_arena_key, delete_thread_arena);
+}
+
+ElementArena& ElementArena::get_thread_arena()
+{
+  pthread_once(&thread_arena_once, create_thread_arena_key);
+  ElementArena* arena = (ElementArena*)pthread_getspecific(thread_arena_key);
+  if(arena == NULL)
+  {
+    arena = new ElementArena();
+    pthread_setspecific(thread_arena_key, arena);
+  }
+  return *arena;
+}
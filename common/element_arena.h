@@ -0,0 +1,76 @@
+#ifndef __HERMES_TESTING_ELEMENT_ARENA_H
+#define __HERMES_TESTING_ELEMENT_ARENA_H
+
+#include "hermes_common.h"
+
+/// Arena for the short-lived buffers of one element (the values of the shape functions and of the
+/// previous solutions at the quadrature points, the geometry, the u_ext / ext arrays of the forms).
+///
+/// allocate() only moves a pointer within a block, reset() releases everything allocated since the
+/// last reset at once. The blocks are kept between the elements: if the buffers of an element did not
+/// fit in one block, reset() replaces the blocks by one block of their total size, so after the first
+/// few elements an element takes no heap allocation at all. The buffers are aligned for SIMD loads
+/// (ALIGNMENT bytes). No destructors are called, so only arrays of plain types belong here.
+///
+/// Every thread has its own arena (get_thread_arena()), so there is no locking and no contention
+/// of the threads in the allocator. The arena lives as long as its thread, so it stays warm across the
+/// runs of a WorkStealingScheduler, whose threads persist until the scheduler is deleted.
+///
+/// Typical usage:
+///   ElementArena& arena = ElementArena::get_thread_arena();
+///   for(each element)
+///   {
+///     arena.reset();
+///     double* values = arena.allocate<double>(num_points);
+///     ...
+///   }
+class ElementArena
+{
+public:
+  ElementArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+  ~ElementArena();
+
+  /// Uninitialized memory of size bytes, valid until the next reset().
+  void* allocate(size_t size);
+
+  template<typename T>
+  T* allocate(int count)
+  {
+    return (T*)this->allocate(count * sizeof(T));
+  }
+
+  /// Releases all buffers.
+  void reset();
+
+  /// Bytes allocated since the last reset().
+  size_t get_used() const;
+  /// Bytes of all blocks.
+  size_t get_capacity() const;
+  int get_num_blocks() const;
+  /// Number of blocks allocated on the heap since the construction.
+  int get_num_heap_allocations() const;
+
+  /// The arena of the calling thread, deleted when the thread exits.
+  static ElementArena& get_thread_arena();
+
+  static const size_t ALIGNMENT = 32;
+  static const size_t DEFAULT_BLOCK_SIZE = 65536;
+
+private:
+  ElementArena(const ElementArena&);
+  ElementArena& operator=(const ElementArena&);
+
+  void add_block(size_t size);
+
+  size_t block_size;
+  std::vector<char*> blocks;
+  std::vector<size_t> block_sizes;
+  /// The block being filled and the first free byte in it.
+  int current;
+  size_t offset;
+  /// Bytes in the blocks before the current one.
+  size_t used_before;
+  int num_heap_allocations;
+};
+
+#endif
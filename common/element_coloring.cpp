@@ -0,0 +1,144 @@
+#include "element_coloring.h"
+#include "hermes2d.h"
+
+using namespace Hermes::Hermes2D;
+
+ElementColoring::ElementColoring()
+{
+}
+
+void ElementColoring::compute(const std::vector<std::vector<int> >& element_dofs)
+{
+  this->colors.clear();
+  this->element_colors.assign(element_dofs.size(), -1);
+
+  // Colors of the elements already colored, per DOF.
+  int max_dof = -1;
+  for(unsigned int e = 0; e < element_dofs.size(); e++)
+    for(unsigned int k = 0; k < element_dofs[e].size(); k++)
+      max_dof = std::max(max_dof, element_dofs[e][k]);
+  std::vector<std::vector<int> > dof_colors(max_dof + 1);
+
+  // forbidden[color] == e if the color is used by a neighbor of the element e.
+  std::vector<int> forbidden;
+  for(unsigned int e = 0; e < element_dofs.size(); e++)
+  {
+    const std::vector<int>& dofs = element_dofs[e];
+    for(unsigned int k = 0; k < dofs.size(); k++)
+      if(dofs[k] >= 0)
+        for(unsigned int c = 0; c < dof_colors[dofs[k]].size(); c++)
+          forbidden[dof_colors[dofs[k]][c]] = e;
+
+    int color = 0;
+    while(color < (int)forbidden.size() && forbidden[color] == (int)e)
+      color++;
+    if(color == (int)forbidden.size())
+    {
+      forbidden.push_back(-1);
+      this->colors.push_back(std::vector<int>());
+    }
+
+    this->colors[color].push_back(e);
+    this->element_colors[e] = color;
+    for(unsigned int k = 0; k < dofs.size(); k++)
+      if(dofs[k] >= 0)
+        dof_colors[dofs[k]].push_back(color);
+  }
+}
+
+template<typename Scalar>
+bool ElementColoring::update(const Hermes::vector<const Space<Scalar>*>& spaces)
+{
+  bool changed = spaces.size() != this->space_seqs.size();
+  for(unsigned int i = 0; i < spaces.size() && !changed; i++)
+    if(spaces[i]->get_seq() != this->space_seqs[i] || spaces[i]->get_num_dofs() != this->space_ndofs[i])
+      changed = true;
+  if(!changed)
+    return false;
+
+  Mesh* mesh = spaces[0]->get_mesh();
+  for(unsigned int i = 1; i < spaces.size(); i++)
+    if(spaces[i]->get_mesh() != mesh)
+      throw Hermes::Exceptions::Exception("ElementColoring: the spaces have to share the mesh.");
+
+  // DOFs of all components of the active elements. Every space numbers its DOFs from zero, so they are
+  // shifted by the numbers of DOFs of the preceding spaces (as in the global system).
+  std::vector<int> offsets(spaces.size(), 0);
+  for(unsigned int i = 1; i < spaces.size(); i++)
+    offsets[i] = offsets[i - 1] + spaces[i - 1]->get_num_dofs();
+  std::vector<std::vector<int> > element_dofs;
+  std::vector<int> ids;
+  AsmList<Scalar> al;
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    element_dofs.push_back(std::vector<int>());
+    for(unsigned int i = 0; i < spaces.size(); i++)
+    {
+      spaces[i]->get_element_assembly_list(e, &al);
+      for(int k = 0; k < al.cnt; k++)
+        element_dofs.back().push_back(al.dof[k] < 0 ? -1 : al.dof[k] + offsets[i]);
+    }
+    ids.push_back(e->id);
+  }
+  this->compute(element_dofs);
+
+  // From the positions in the list to the ids.
+  for(unsigned int color = 0; color < this->colors.size(); color++)
+    for(unsigned int i = 0; i < this->colors[color].size(); i++)
+      this->colors[color][i] = ids[this->colors[color][i]];
+  this->element_colors.assign(mesh->get_max_element_id() + 1, -1);
+  for(unsigned int color = 0; color < this->colors.size(); color++)
+    for(unsigned int i = 0; i < this->colors[color].size(); i++)
+      this->element_colors[this->colors[color][i]] = color;
+
+  this->space_seqs.resize(spaces.size());
+  this->space_ndofs.resize(spaces.size());
+  for(unsigned int i = 0; i < spaces.size(); i++)
+  {
+    this->space_seqs[i] = spaces[i]->get_seq();
+    this->space_ndofs[i] = spaces[i]->get_num_dofs();
+  }
+  return true;
+}
+
+int ElementColoring::get_num_colors() const
+{
+  return this->colors.size();
+}
+
+const std::vector<int>& ElementColoring::get_elements(int color) const
+{
+  return this->colors[color];
+}
+
+int ElementColoring::get_color(int element) const
+{
+  return element >= 0 && element < (int)this->element_colors.size() ? this->element_colors[element] : -1;
+}
+
+bool ElementColoring::is_valid(const std::vector<std::vector<int> >& element_dofs, const ElementColoring& coloring)
+{
+  // The last element of each color seen at each DOF.
+  std::map<std::pair<int, int>, int> owners;
+  for(unsigned int e = 0; e < element_dofs.size(); e++)
+  {
+    int color = coloring.get_color(e);
+    if(color < 0)
+      return false;
+    for(unsigned int k = 0; k < element_dofs[e].size(); k++)
+    {
+      if(element_dofs[e][k] < 0)
+        continue;
+      std::pair<int, int> key(element_dofs[e][k], color);
+      std::map<std::pair<int, int>, int>::iterator it = owners.find(key);
+      if(it != owners.end() && it->second != (int)e)
+        return false;
+      owners[key] = e;
+    }
+  }
+  return true;
+}
+
+template bool ElementColoring::update<double>(const Hermes::vector<const Space<double>*>& spaces);
+template bool ElementColoring::update<std::complex<double> >(const Hermes::vector<const Space<std::complex<double> >*>& spaces);
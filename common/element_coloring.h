@@ -0,0 +1,64 @@
+#ifndef __HERMES_TESTING_ELEMENT_COLORING_H
+#define __HERMES_TESTING_ELEMENT_COLORING_H
+
+#include "hermes_common.h"
+
+namespace Hermes
+{
+  namespace Hermes2D
+  {
+    template<typename Scalar> class Space;
+  }
+}
+
+/// Coloring of the elements such that no two elements of the same color share a DOF.
+///
+/// The contributions of the elements of one color go to disjoint entries of the matrix and of
+/// the right-hand side, so the threads can insert them without locks or atomics; the colors are
+/// processed one after another. The coloring is greedy (in the order of the elements), which gives
+/// a few colors more than the maximum number of elements sharing a DOF.
+///
+/// Typical usage:
+///   ElementColoring coloring;
+///   coloring.update(spaces);          // Recomputed only after assign_dofs().
+///   for(int color = 0; color < coloring.get_num_colors(); color++)
+///   {
+///     const std::vector<int>& elements = coloring.get_elements(color);
+///     #pragma omp parallel for
+///     for(int i = 0; i < elements.size(); i++)
+///       ... assemble and insert the element elements[i] ...
+///   }
+class ElementColoring
+{
+public:
+  ElementColoring();
+
+  /// Colors the elements 0, ..., element_dofs.size() - 1 given by their DOFs (negative ones are ignored).
+  void compute(const std::vector<std::vector<int> >& element_dofs);
+
+  /// Colors the active elements of the spaces (on one mesh) by the DOFs of their assembly lists,
+  /// the DOFs of every space shifted by the numbers of DOFs of the preceding ones, the elements
+  /// are identified by their ids. The coloring is cached: it is recomputed only if
+  /// the DOFs of any of the spaces were assigned again since the last call, which is returned.
+  template<typename Scalar>
+  bool update(const Hermes::vector<const Hermes::Hermes2D::Space<Scalar>*>& spaces);
+
+  int get_num_colors() const;
+  /// Elements of one color.
+  const std::vector<int>& get_elements(int color) const;
+  /// Color of an element, -1 if it was not colored.
+  int get_color(int element) const;
+
+  /// True if no two elements of the same color share a DOF.
+  static bool is_valid(const std::vector<std::vector<int> >& element_dofs, const ElementColoring& coloring);
+
+private:
+  std::vector<std::vector<int> > colors;
+  std::vector<int> element_colors;
+
+  /// The state of the spaces the coloring was computed for.
+  std::vector<int> space_seqs;
+  std::vector<int> space_ndofs;
+};
+
+#endif
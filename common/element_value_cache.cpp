@@ -0,0 +1,230 @@
+#include "element_value_cache.h"
+#include "gauss_legendre.h"
+
+using namespace Hermes::Hermes2D;
+
+ElementValueCache::ElementValueCache(Shapeset* shapeset, size_t memory_cap) : shapeset(shapeset), memory_cap(memory_cap), memory(0),
+  hits(0), misses(0), evictions(0), space_seq(-1), space_ndofs(-1)
+{
+}
+
+size_t ElementValueCache::Values::get_size() const
+{
+  return sizeof(Values) + (x.size() + y.size() + wt.size() + inv_jac.size() + nx.size() + ny.size()
+    + fn.size() + dx.size() + dy.size()) * sizeof(double) + idx.size() * sizeof(int);
+}
+
+void ElementValueCache::Values::swap(Values& values)
+{
+  std::swap(this->num_points, values.num_points);
+  this->x.swap(values.x);
+  this->y.swap(values.y);
+  this->wt.swap(values.wt);
+  this->inv_jac.swap(values.inv_jac);
+  this->nx.swap(values.nx);
+  this->ny.swap(values.ny);
+  this->idx.swap(values.idx);
+  this->fn.swap(values.fn);
+  this->dx.swap(values.dx);
+  this->dy.swap(values.dy);
+}
+
+const ElementValueCache::Values* ElementValueCache::get(Element* e, AsmList<double>* al)
+{
+  if(e->is_curved())
+    return NULL;
+
+  std::map<int, Entry>::iterator it = this->entries.find(e->id);
+  if(it != this->entries.end())
+  {
+    // The same shape functions (the assembly lists of an element only change with the space).
+    bool same = (int)it->second.values.idx.size() == al->cnt;
+    for(int i = 0; i < al->cnt && same; i++)
+      same = it->second.values.idx[i] == al->idx[i];
+    if(same)
+    {
+      this->hits++;
+      this->usage.splice(this->usage.begin(), this->usage, it->second.position);
+      return &it->second.values;
+    }
+    this->memory -= it->second.values.get_size();
+    this->usage.erase(it->second.position);
+    this->entries.erase(it);
+  }
+
+  this->misses++;
+  this->calculate(e, al, this->uncached);
+
+  // An element which alone exceeds the cap is not cached (it would only evict all the others),
+  // it is computed again next time.
+  if(this->uncached.get_size() > this->memory_cap)
+    return &this->uncached;
+
+  Entry& entry = this->entries[e->id];
+  entry.values.swap(this->uncached);
+  this->usage.push_front(e->id);
+  entry.position = this->usage.begin();
+  this->memory += entry.values.get_size();
+  // The new element is the most recently used one, so it fits and is not evicted.
+  this->evict();
+  return &entry.values;
+}
+
+void ElementValueCache::calculate(Element* e, AsmList<double>* al, Values& values) const
+{
+  ElementMode2D mode = e->get_mode();
+  int degree = 0;
+  for(int i = 0; i < al->cnt; i++)
+  {
+    int order = this->shapeset->get_order(al->idx[i], mode);
+    degree = std::max(degree, std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order)));
+  }
+  std::vector<double> points, weights;
+  gauss_legendre(degree + 1, points, weights);
+  int n = points.size();
+  int num_points = n * n;
+
+  values.num_points = num_points;
+  values.x.resize(num_points);
+  values.y.resize(num_points);
+  values.wt.resize(num_points);
+  values.inv_jac.resize(4 * num_points);
+  values.idx.assign(al->idx, al->idx + al->cnt);
+  values.fn.resize(al->cnt * num_points);
+  values.dx.resize(al->cnt * num_points);
+  values.dy.resize(al->cnt * num_points);
+
+  int nvert = e->get_nvert();
+  for(int a = 0; a < n; a++)
+    for(int b = 0; b < n; b++)
+    {
+      int k = a * n + b;
+      double xi = points[a], eta = points[b], weight = weights[a] * weights[b];
+      double x, y, x_xi, x_eta, y_xi, y_eta;
+      if(e->is_triangle())
+      {
+        // The square (-1, 1)^2 collapsed to the reference triangle (-1, -1), (1, -1), (-1, 1).
+        xi = (1.0 + points[a]) * (1.0 - points[b]) / 2 - 1.0;
+        weight *= (1.0 - points[b]) / 2;
+        Node** v = e->vn;
+        x_xi = (v[1]->x - v[0]->x) / 2;
+        x_eta = (v[2]->x - v[0]->x) / 2;
+        y_xi = (v[1]->y - v[0]->y) / 2;
+        y_eta = (v[2]->y - v[0]->y) / 2;
+        x = v[0]->x + x_xi * (xi + 1) + x_eta * (eta + 1);
+        y = v[0]->y + y_xi * (xi + 1) + y_eta * (eta + 1);
+      }
+      else
+      {
+        // The bilinear map of the reference quad (-1, 1)^2.
+        const double xi_vertex[4] = { -1.0, 1.0, 1.0, -1.0 };
+        const double eta_vertex[4] = { -1.0, -1.0, 1.0, 1.0 };
+        x = y = x_xi = x_eta = y_xi = y_eta = 0.0;
+        for(int i = 0; i < 4; i++)
+        {
+          double s = 1.0 + xi_vertex[i] * xi, t = 1.0 + eta_vertex[i] * eta;
+          x += e->vn[i]->x * s * t / 4;
+          y += e->vn[i]->y * s * t / 4;
+          x_xi += e->vn[i]->x * xi_vertex[i] * t / 4;
+          y_xi += e->vn[i]->y * xi_vertex[i] * t / 4;
+          x_eta += e->vn[i]->x * s * eta_vertex[i] / 4;
+          y_eta += e->vn[i]->y * s * eta_vertex[i] / 4;
+        }
+      }
+      double det = x_xi * y_eta - x_eta * y_xi;
+      double xi_x = y_eta / det, xi_y = -x_eta / det, eta_x = -y_xi / det, eta_y = x_xi / det;
+
+      values.x[k] = x;
+      values.y[k] = y;
+      values.wt[k] = weight * std::abs(det);
+      values.inv_jac[4 * k] = xi_x;
+      values.inv_jac[4 * k + 1] = xi_y;
+      values.inv_jac[4 * k + 2] = eta_x;
+      values.inv_jac[4 * k + 3] = eta_y;
+
+      for(int i = 0; i < al->cnt; i++)
+      {
+        double u_xi = this->shapeset->get_dx_value(al->idx[i], xi, eta, 0, mode);
+        double u_eta = this->shapeset->get_dy_value(al->idx[i], xi, eta, 0, mode);
+        values.fn[i * num_points + k] = this->shapeset->get_fn_value(al->idx[i], xi, eta, 0, mode);
+        values.dx[i * num_points + k] = u_xi * xi_x + u_eta * eta_x;
+        values.dy[i * num_points + k] = u_xi * xi_y + u_eta * eta_y;
+      }
+    }
+
+  // The vertices are counterclockwise, so (dy, -dx) of an edge points outwards.
+  values.nx.resize(nvert);
+  values.ny.resize(nvert);
+  for(int i = 0; i < nvert; i++)
+  {
+    Node* v1 = e->vn[i];
+    Node* v2 = e->vn[(i + 1) % nvert];
+    double length = std::sqrt((v2->x - v1->x) * (v2->x - v1->x) + (v2->y - v1->y) * (v2->y - v1->y));
+    values.nx[i] = (v2->y - v1->y) / length;
+    values.ny[i] = -(v2->x - v1->x) / length;
+  }
+}
+
+void ElementValueCache::evict()
+{
+  while(this->memory > this->memory_cap && !this->usage.empty())
+  {
+    std::map<int, Entry>::iterator it = this->entries.find(this->usage.back());
+    this->memory -= it->second.values.get_size();
+    this->entries.erase(it);
+    this->usage.pop_back();
+    this->evictions++;
+  }
+}
+
+template<typename Scalar>
+bool ElementValueCache::update(const Space<Scalar>* space)
+{
+  if(space->get_seq() == this->space_seq && space->get_num_dofs() == this->space_ndofs)
+    return false;
+  this->clear();
+  this->space_seq = space->get_seq();
+  this->space_ndofs = space->get_num_dofs();
+  return true;
+}
+
+void ElementValueCache::clear()
+{
+  this->entries.clear();
+  this->usage.clear();
+  this->memory = 0;
+}
+
+void ElementValueCache::set_memory_cap(size_t memory_cap)
+{
+  this->memory_cap = memory_cap;
+  this->evict();
+}
+
+int ElementValueCache::get_num_cached() const
+{
+  return this->entries.size();
+}
+
+size_t ElementValueCache::get_memory() const
+{
+  return this->memory;
+}
+
+int ElementValueCache::get_hits() const
+{
+  return this->hits;
+}
+
+int ElementValueCache::get_misses() const
+{
+  return this->misses;
+}
+
+int ElementValueCache::get_evictions() const
+{
+  return this->evictions;
+}
+
+template bool ElementValueCache::update<double>(const Space<double>* space);
+template bool ElementValueCache::update<std::complex<double> >(const Space<std::complex<double> >* space);
@@ -0,0 +1,111 @@
+#ifndef __HERMES_TESTING_ELEMENT_VALUE_CACHE_H
+#define __HERMES_TESTING_ELEMENT_VALUE_CACHE_H
+
+#include "hermes2d.h"
+#include <list>
+
+/// Cache of the geometry and of the shape function values at the quadrature points of the elements,
+/// kept across forms, Newton iterations and time steps as long as the mesh and the orders do not change.
+///
+/// For an element and the shape functions of its assembly list, the cache holds the physical quadrature
+/// points, the weights including |det J|, the inverse Jacobians, the outer normals of the edges and the
+/// values and physical derivatives of the shape functions. The points are the Gauss rule with degree + 1
+/// points in each direction (collapsed to the reference triangle on triangles), where degree is the
+/// highest degree of the shape functions, which integrates the products exactly on affine elements.
+///
+/// The elements are identified by their ids. update() drops everything when the DOFs of the space were
+/// assigned again (after a refinement or a change of the orders). When the memory exceeds the cap, the
+/// least recently used elements are evicted. Curved elements are not cached (get() returns NULL) and
+/// are left to the quadrature of the assembler. The cache is not synchronized, use one instance per thread.
+///
+/// An assembly repeated on unchanged spaces (the Newton iterations, the Runge-Kutta stages) then costs
+/// one get() lookup per element instead of the reference map and the shape function values: after the
+/// first assembly every get() is a hit unless the cap evicts (see the element-value-cache test).
+///
+/// Typical usage:
+///   ElementValueCache cache(space.get_shapeset());
+///   for(each Newton iteration)
+///   {
+///     cache.update(&space);
+///     for_all_active_elements(e, mesh)
+///     {
+///       space.get_element_assembly_list(e, &al);
+///       const ElementValueCache::Values* values = cache.get(e, &al);
+///       ...
+///     }
+///   }
+class ElementValueCache
+{
+public:
+  ElementValueCache(Hermes::Hermes2D::Shapeset* shapeset, size_t memory_cap = DEFAULT_MEMORY_CAP);
+
+  /// The cached data of one element.
+  struct Values
+  {
+    int num_points;
+    /// Physical coordinates of the points.
+    std::vector<double> x, y;
+    /// Weights of the points times |det J|.
+    std::vector<double> wt;
+    /// d xi / dx, d xi / dy, d eta / dx, d eta / dy at the point k are inv_jac[4 * k + 0 ... 3].
+    std::vector<double> inv_jac;
+    /// Outer unit normals of the edges.
+    std::vector<double> nx, ny;
+    /// Shape functions (AsmList::idx) and their values, the function i at the point k is fn[i * num_points + k].
+    std::vector<int> idx;
+    std::vector<double> fn, dx, dy;
+
+    size_t get_size() const;
+    /// Exchanges the arrays (without copying them).
+    void swap(Values& values);
+  };
+
+  /// Values of the element with the shape functions of the assembly list (without the coefficients
+  /// al->coef). The pointer is valid until the next call of get(), update() or clear().
+  /// NULL for curved elements.
+  const Values* get(Hermes::Hermes2D::Element* e, Hermes::Hermes2D::AsmList<double>* al);
+
+  /// Clears the cache if the DOFs of the space were assigned since the last call, which is returned.
+  template<typename Scalar>
+  bool update(const Hermes::Hermes2D::Space<Scalar>* space);
+
+  void clear();
+
+  /// Evicts the least recently used elements down to the new cap.
+  void set_memory_cap(size_t memory_cap);
+
+  int get_num_cached() const;
+  size_t get_memory() const;
+  int get_hits() const;
+  int get_misses() const;
+  int get_evictions() const;
+
+  static const size_t DEFAULT_MEMORY_CAP = 256 * 1048576;
+
+private:
+  struct Entry
+  {
+    Values values;
+    std::list<int>::iterator position;
+  };
+
+  void calculate(Hermes::Hermes2D::Element* e, Hermes::Hermes2D::AsmList<double>* al, Values& values) const;
+  void evict();
+
+  Hermes::Hermes2D::Shapeset* shapeset;
+  size_t memory_cap;
+  size_t memory;
+  std::map<int, Entry> entries;
+  /// Element ids from the most to the least recently used.
+  std::list<int> usage;
+  /// The values of an element which alone exceeds the cap.
+  Values uncached;
+
+  int hits, misses, evictions;
+
+  /// The state of the space the values were computed for.
+  int space_seq;
+  int space_ndofs;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#include "functional_evaluator.h"
+#include "element_arena.h"
+#include <set>
+
+using namespace Hermes::Hermes2D;
+
+Functional::Functional(const Hermes::vector<std::string>& areas, const Hermes::vector<std::string>& boundaries) : areas(areas), boundaries(boundaries)
+{
+}
+
+Functional::~Functional()
+{
+}
+
+double Functional::volume(const FunctionalValues& values) const
+{
+  return 0.0;
+}
+
+double Functional::surface(const FunctionalValues& values) const
+{
+  return 0.0;
+}
+
+const Hermes::vector<std::string>& Functional::get_areas() const
+{
+  return this->areas;
+}
+
+const Hermes::vector<std::string>& Functional::get_boundaries() const
+{
+  return this->boundaries;
+}
+
+namespace
+{
+  /// An element (edge == -1) or a boundary edge with the functionals evaluated on it.
+  struct Item
+  {
+    Element* e;
+    int edge;
+    const std::vector<int>* functionals;
+  };
+
+  class EvaluationTask : public WorkStealingScheduler::Task
+  {
+  public:
+    EvaluationTask(const std::vector<Item>& items, const std::vector<Functional*>& functionals,
+      const Hermes::vector<MeshFunction<double>*>& solutions, int order, int num_threads)
+      : items(items), functionals(functionals), order(order), threads(num_threads)
+    {
+      for(int t = 0; t < num_threads; t++)
+      {
+        Thread& thread = this->threads[t];
+        thread.refmap = new RefMap();
+        thread.refmap->set_quad_2d(&g_quad_2d_std);
+        for(unsigned int i = 0; i < solutions.size(); i++)
+        {
+          // Also the calling thread (0) evaluates clones, so that the quadrature and the active
+          // element of the solutions of the caller stay untouched.
+          MeshFunction<double>* solution = solutions[i]->clone();
+          solution->set_quad_2d(&g_quad_2d_std);
+          thread.solutions.push_back(solution);
+        }
+        thread.results.assign(functionals.size(), 0.0);
+        thread.values.val.resize(solutions.size());
+        thread.values.dx.resize(solutions.size());
+        thread.values.dy.resize(solutions.size());
+        thread.values.kernels = IntegrationKernels::get_kernels();
+      }
+    }
+
+    ~EvaluationTask()
+    {
+      for(unsigned int t = 0; t < this->threads.size(); t++)
+      {
+        delete this->threads[t].refmap;
+        for(unsigned int i = 0; i < this->threads[t].solutions.size(); i++)
+          delete this->threads[t].solutions[i];
+      }
+    }
+
+    void execute(int item_index, int thread_index)
+    {
+      const Item& item = this->items[item_index];
+      Thread& thread = this->threads[thread_index];
+      ElementArena& arena = ElementArena::get_thread_arena();
+      arena.reset();
+      Element* e = item.e;
+      ElementMode2D mode = e->get_mode();
+      Quad2D* quad = &g_quad_2d_std;
+      RefMap* rm = thread.refmap;
+      rm->set_active_element(e);
+
+      int order = std::min(this->order, quad->get_max_order(mode));
+      FunctionalValues& values = thread.values;
+      if(item.edge < 0)
+      {
+        // Volume.
+        int np = quad->get_num_points(order, mode);
+        double3* points = quad->get_points(order, mode);
+        double* wt = arena.allocate<double>(np);
+        if(rm->is_jacobian_const())
+          for(int i = 0; i < np; i++)
+            wt[i] = points[i][2] * rm->get_const_jacobian();
+        else
+        {
+          double* jacobian = rm->get_jacobian(order);
+          for(int i = 0; i < np; i++)
+            wt[i] = points[i][2] * jacobian[i];
+        }
+        values.n = np;
+        values.wt = wt;
+        values.x = rm->get_phys_x(order);
+        values.y = rm->get_phys_y(order);
+        values.nx = values.ny = NULL;
+        values.marker = e->marker;
+      }
+      else
+      {
+        // Surface, the normals as in init_geom_surf().
+        order = quad->get_edge_points(item.edge, order, mode);
+        int np = quad->get_num_points(order, mode);
+        double3* points = quad->get_points(order, mode);
+        double3* tangents = rm->get_tangent(item.edge, order);
+        double* wt = arena.allocate<double>(np);
+        double* nx = arena.allocate<double>(np);
+        double* ny = arena.allocate<double>(np);
+        for(int i = 0; i < np; i++)
+        {
+          // Weights sum up to two on every edge.
+          wt[i] = 0.5 * points[i][2] * tangents[i][2];
+          nx[i] = tangents[i][1];
+          ny[i] = -tangents[i][0];
+        }
+        values.n = np;
+        values.wt = wt;
+        values.x = rm->get_phys_x(order);
+        values.y = rm->get_phys_y(order);
+        values.nx = nx;
+        values.ny = ny;
+        values.marker = e->en[item.edge]->marker;
+      }
+      double* one = arena.allocate<double>(values.n);
+      for(int i = 0; i < values.n; i++)
+        one[i] = 1.0;
+      values.one = one;
+
+      for(unsigned int i = 0; i < thread.solutions.size(); i++)
+      {
+        MeshFunction<double>* solution = thread.solutions[i];
+        solution->set_active_element(e);
+        solution->set_quad_order(order, H2D_FN_DEFAULT);
+        values.val[i] = solution->get_fn_values();
+        values.dx[i] = solution->get_dx_values();
+        values.dy[i] = solution->get_dy_values();
+      }
+
+      for(unsigned int k = 0; k < item.functionals->size(); k++)
+      {
+        int f = (*item.functionals)[k];
+        thread.results[f] += item.edge < 0 ? this->functionals[f]->volume(values) : this->functionals[f]->surface(values);
+      }
+    }
+
+    std::vector<double> get_results() const
+    {
+      std::vector<double> results(this->functionals.size(), 0.0);
+      for(unsigned int t = 0; t < this->threads.size(); t++)
+        for(unsigned int f = 0; f < results.size(); f++)
+          results[f] += this->threads[t].results[f];
+      return results;
+    }
+
+  private:
+    struct Thread
+    {
+      RefMap* refmap;
+      std::vector<MeshFunction<double>*> solutions;
+      std::vector<double> results;
+      FunctionalValues values;
+    };
+
+    const std::vector<Item>& items;
+    const std::vector<Functional*>& functionals;
+    int order;
+    std::vector<Thread> threads;
+  };
+}
+
+FunctionalEvaluator::FunctionalEvaluator(Mesh* mesh, const Hermes::vector<MeshFunction<double>*>& solutions, int order)
+  : mesh(mesh), solutions(solutions), order(order), scheduler(NULL)
+{
+  for(unsigned int i = 0; i < solutions.size(); i++)
+    if(solutions[i]->get_mesh() != mesh)
+      throw Hermes::Exceptions::Exception("FunctionalEvaluator: the solutions have to be defined on the mesh of the evaluator.");
+}
+
+FunctionalEvaluator::~FunctionalEvaluator()
+{
+  delete this->scheduler;
+}
+
+void FunctionalEvaluator::add(Functional* functional)
+{
+  this->functionals.push_back(functional);
+}
+
+std::vector<double> FunctionalEvaluator::evaluate(int num_threads)
+{
+  this->index.update(this->mesh);
+
+  // The functionals per internal marker, every marker once per functional (even if it is given
+  // several times or together with HERMES_ANY).
+  std::map<int, std::vector<int> > area_functionals, boundary_functionals;
+  std::vector<int> all_area_markers = this->index.get_area_markers();
+  std::vector<int> all_boundary_markers = this->index.get_boundary_markers();
+  for(unsigned int f = 0; f < this->functionals.size(); f++)
+  {
+    std::set<int> area_markers, boundary_markers;
+    const Hermes::vector<std::string>& areas = this->functionals[f]->get_areas();
+    if(std::find(areas.begin(), areas.end(), HERMES_ANY) != areas.end())
+      area_markers.insert(all_area_markers.begin(), all_area_markers.end());
+    else
+      for(unsigned int i = 0; i < areas.size(); i++)
+      {
+        Mesh::MarkersConversion::IntValid marker = this->mesh->get_element_markers_conversion().get_internal_marker(areas[i]);
+        if(marker.valid)
+          area_markers.insert(marker.marker);
+      }
+
+    const Hermes::vector<std::string>& boundaries = this->functionals[f]->get_boundaries();
+    if(std::find(boundaries.begin(), boundaries.end(), HERMES_ANY) != boundaries.end())
+      boundary_markers.insert(all_boundary_markers.begin(), all_boundary_markers.end());
+    else
+      for(unsigned int i = 0; i < boundaries.size(); i++)
+      {
+        Mesh::MarkersConversion::IntValid marker = this->mesh->get_boundary_markers_conversion().get_internal_marker(boundaries[i]);
+        if(marker.valid)
+          boundary_markers.insert(marker.marker);
+      }
+
+    for(std::set<int>::iterator it = area_markers.begin(); it != area_markers.end(); it++)
+      area_functionals[*it].push_back(f);
+    for(std::set<int>::iterator it = boundary_markers.begin(); it != boundary_markers.end(); it++)
+      boundary_functionals[*it].push_back(f);
+  }
+
+  // The elements and the edges with any functional, the costs are the numbers of points.
+  std::vector<Item> items;
+  std::vector<double> costs;
+  for(std::map<int, std::vector<int> >::iterator it = area_functionals.begin(); it != area_functionals.end(); it++)
+  {
+    const std::vector<Element*>& elements = this->index.get_elements(it->first);
+    for(unsigned int i = 0; i < elements.size(); i++)
+    {
+      Item item = { elements[i], -1, &it->second };
+      items.push_back(item);
+      costs.push_back(g_quad_2d_std.get_num_points(std::min(this->order, g_quad_2d_std.get_max_order(elements[i]->get_mode())),
+        elements[i]->get_mode()) * (this->solutions.size() + it->second.size()));
+    }
+  }
+  for(std::map<int, std::vector<int> >::iterator it = boundary_functionals.begin(); it != boundary_functionals.end(); it++)
+  {
+    const std::vector<MarkerIndex::BoundaryEdge>& edges = this->index.get_boundary_edges(it->first);
+    for(unsigned int i = 0; i < edges.size(); i++)
+    {
+      Item item = { edges[i].e, edges[i].edge, &it->second };
+      items.push_back(item);
+      costs.push_back((this->order / 2 + 1) * (this->solutions.size() + it->second.size()));
+    }
+  }
+
+  EvaluationTask task(items, this->functionals, this->solutions, this->order, num_threads);
+  if(this->scheduler == NULL || this->scheduler->get_num_threads() != num_threads)
+  {
+    delete this->scheduler;
+    this->scheduler = new WorkStealingScheduler(num_threads);
+  }
+  this->scheduler->run(costs, task);
+  return task.get_results();
+}
@@ -0,0 +1,104 @@
+#ifndef __HERMES_TESTING_FUNCTIONAL_EVALUATOR_H
+#define __HERMES_TESTING_FUNCTIONAL_EVALUATOR_H
+
+#include "hermes2d.h"
+#include "integration_kernels.h"
+#include "marker_index.h"
+#include "work_stealing_scheduler.h"
+
+/// The values of the solutions at the quadrature points of an element (volume) or a boundary edge (surface).
+struct FunctionalValues
+{
+  int n;
+  /// Weights times the Jacobian (volume) or the length of the edge (surface).
+  const double* wt;
+  /// Physical coordinates of the points.
+  const double* x;
+  const double* y;
+  /// Outer unit normals, NULL on elements.
+  const double* nx;
+  const double* ny;
+  /// n ones, to integrate a single array by kernels.u_v(n, wt, f, one).
+  const double* one;
+  /// The integration kernels, resolved once per evaluate().
+  IntegrationKernels::Kernels kernels;
+  /// Values and derivatives of the solutions (in the order given to FunctionalEvaluator).
+  std::vector<const double*> val;
+  std::vector<const double*> dx;
+  std::vector<const double*> dy;
+  /// Internal area marker of the element or boundary marker of the edge.
+  int marker;
+};
+
+/// A quantity integrated over areas and / or boundaries: lift and drag, a heat flux, a perimeter, ...
+///
+/// volume() is called for the elements with any of the area markers, surface() for the boundary edges
+/// with any of the boundary markers (the user markers, HERMES_ANY for all), the results are summed.
+/// Both are called concurrently by several threads, so they must not modify the functional.
+class Functional
+{
+public:
+  Functional(const Hermes::vector<std::string>& areas, const Hermes::vector<std::string>& boundaries);
+  virtual ~Functional();
+
+  /// The integral over one element.
+  virtual double volume(const FunctionalValues& values) const;
+  /// The integral over one boundary edge.
+  virtual double surface(const FunctionalValues& values) const;
+
+  const Hermes::vector<std::string>& get_areas() const;
+  const Hermes::vector<std::string>& get_boundaries() const;
+
+private:
+  Hermes::vector<std::string> areas;
+  Hermes::vector<std::string> boundaries;
+};
+
+/// Evaluation of several functionals of the solutions in one pass over the mesh, by several threads.
+///
+/// The elements and the boundary edges are taken from a MarkerIndex (only those with markers of any
+/// functional are visited) and scheduled by WorkStealingScheduler, weighted by their numbers of points.
+/// On every element (edge) the reference map and the solutions are evaluated once for all functionals.
+/// Every thread (also with one thread) evaluates clones of the solutions (MeshFunction::clone()), so
+/// the solutions themselves are not modified; they have to be defined on the mesh of the evaluator.
+/// A marker given several times to one functional is integrated once. The partial sums of the threads
+/// are added at the end, so the results with several threads may differ from those with one thread
+/// in the last bits. The weights and normals of an element come from the ElementArena of the thread;
+/// the scheduler is kept between the calls of evaluate() with the same number of threads (e.g. in
+/// every time step), so are its threads and their arenas.
+///
+/// Typical usage:
+///   FunctionalEvaluator evaluator(&mesh, Hermes::vector<MeshFunction<double>*>(&xvel, &yvel, &p));
+///   evaluator.add(&drag);
+///   evaluator.add(&lift);
+///   std::vector<double> results = evaluator.evaluate(num_threads);
+class FunctionalEvaluator
+{
+public:
+  /// order is the order of the quadrature (limited by the maximum order of g_quad_2d_std).
+  FunctionalEvaluator(Hermes::Hermes2D::Mesh* mesh, const Hermes::vector<Hermes::Hermes2D::MeshFunction<double>*>& solutions,
+    int order = DEFAULT_ORDER);
+  ~FunctionalEvaluator();
+
+  /// Adds a functional (not owned).
+  void add(Functional* functional);
+
+  /// Values of all functionals (in the order of add()).
+  std::vector<double> evaluate(int num_threads = 1);
+
+  static const int DEFAULT_ORDER = 10;
+
+private:
+  FunctionalEvaluator(const FunctionalEvaluator&);
+  FunctionalEvaluator& operator=(const FunctionalEvaluator&);
+
+  Hermes::Hermes2D::Mesh* mesh;
+  Hermes::vector<Hermes::Hermes2D::MeshFunction<double>*> solutions;
+  int order;
+  std::vector<Functional*> functionals;
+  MarkerIndex index;
+  /// Created by evaluate(), replaced when the number of threads changes.
+  WorkStealingScheduler* scheduler;
+};
+
+#endif
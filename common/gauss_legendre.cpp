@@ -0,0 +1,31 @@
+#include "gauss_legendre.h"
+#include <cmath>
+
+void gauss_legendre(int n, std::vector<double>& points, std::vector<double>& weights)
+{
+  points.resize(n);
+  weights.resize(n);
+  for(int i = 0; i < n; i++)
+  {
+    // Newton's iterations from the Chebyshev-like initial guess.
+    double x = std::cos(3.14159265358979323846 * (i + 0.75) / (n + 0.5));
+    double derivative = 1.0;
+    for(int iteration = 0; iteration < 100; iteration++)
+    {
+      double p0 = 1.0, p1 = x;
+      for(int k = 2; k <= n; k++)
+      {
+        double p2 = ((2 * k - 1) * x * p1 - (k - 1) * p0) / k;
+        p0 = p1;
+        p1 = p2;
+      }
+      derivative = n * (x * p1 - p0) / (x * x - 1.0);
+      double dx = p1 / derivative;
+      x -= dx;
+      if(std::abs(dx) < 1e-15)
+        break;
+    }
+    points[i] = x;
+    weights[i] = 2.0 / ((1.0 - x * x) * derivative * derivative);
+  }
+}
@@ -0,0 +1,9 @@
+#ifndef __HERMES_TESTING_GAUSS_LEGENDRE_H
+#define __HERMES_TESTING_GAUSS_LEGENDRE_H
+
+#include <vector>
+
+/// Gauss-Legendre rule with n points on (-1, 1), exact for polynomials of degree 2n - 1.
+void gauss_legendre(int n, std::vector<double>& points, std::vector<double>& weights);
+
+#endif
@@ -0,0 +1,254 @@
+#include "instrumentation.h"
+#include "json_escape.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace
+{
+  struct TimerTotals
+  {
+    int calls;
+    double total;
+    double min;
+    double max;
+  };
+
+  // One timed section ('X') or counter update ('C') of the trace, times in microseconds.
+  struct Event
+  {
+    const char* name;
+    char type;
+    double start;
+    double value;
+  };
+
+  // Compares the names by their contents, a lookup does not copy the name.
+  struct NameLess
+  {
+    bool operator()(const char* a, const char* b) const
+    {
+      return strcmp(a, b) < 0;
+    }
+  };
+
+  struct InstrumentationData
+  {
+    std::string name;
+    Instrumentation::Output output;
+    double start;
+    // The first pointer of every name is kept.
+    std::map<const char*, TimerTotals, NameLess> timers;
+    std::map<const char*, double, NameLess> counters;
+    std::vector<Event> events;
+    int max_events;
+    int dropped_events;
+  };
+
+  // Never deleted, it has to be available in the atexit handler.
+  InstrumentationData* data = NULL;
+  bool enabled = false;
+
+  void write_at_exit()
+  {
+    Instrumentation::write();
+  }
+}
+
+double Instrumentation::now()
+{
+#ifdef _WIN32
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return 1e6 * counter.QuadPart / frequency.QuadPart;
+#else
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return 1e6 * time.tv_sec + 1e-3 * time.tv_nsec;
+#endif
+}
+
+void Instrumentation::init(const char* name, int max_trace_events)
+{
+  const char* output = getenv("HERMES_INSTRUMENTATION");
+  if(output == NULL || strlen(output) == 0)
+    init(name, NoOutput, max_trace_events);
+  else if(strcmp(output, "json") == 0)
+    init(name, JsonOutput, max_trace_events);
+  else if(strcmp(output, "trace") == 0)
+    init(name, TraceOutput, max_trace_events);
+  else
+    throw Hermes::Exceptions::Exception("Unknown HERMES_INSTRUMENTATION output '%s', use 'json' or 'trace'.", output);
+}
+
+void Instrumentation::init(const char* name, Output output, int max_trace_events)
+{
+  if(data != NULL)
+    throw Hermes::Exceptions::Exception("Instrumentation::init() called twice.");
+  if(max_trace_events < 0)
+    throw Hermes::Exceptions::Exception("Instrumentation: the number of trace events has to be non-negative.");
+
+  data = new InstrumentationData;
+  data->name = name;
+  data->output = output;
+  data->start = now();
+  data->max_events = max_trace_events;
+  data->dropped_events = 0;
+
+  // The events are only appended, so that recording them does not allocate.
+  if(output == TraceOutput)
+    data->events.reserve(max_trace_events);
+
+  enabled = output != NoOutput;
+  if(enabled)
+    atexit(write_at_exit);
+}
+
+void Instrumentation::declare_timer(const char* name)
+{
+  if(!enabled || data->timers.find(name) != data->timers.end())
+    return;
+  TimerTotals totals = { 0, 0.0, 0.0, 0.0 };
+  data->timers.insert(std::pair<const char*, TimerTotals>(name, totals));
+}
+
+void Instrumentation::declare_counter(const char* name)
+{
+  if(enabled)
+    data->counters[name] += 0.0;
+}
+
+bool Instrumentation::is_enabled()
+{
+  return enabled;
+}
+
+void Instrumentation::count(const char* name, double value)
+{
+  if(!enabled)
+    return;
+
+  double& total = data->counters[name];
+  total += value;
+  if(data->output == TraceOutput)
+  {
+    if((int)data->events.size() < data->max_events)
+    {
+      Event event = { name, 'C', now() - data->start, total };
+      data->events.push_back(event);
+    }
+    else
+      data->dropped_events++;
+  }
+}
+
+Instrumentation::ScopedTimer::ScopedTimer(const char* name) : name(name), start(0.0), running(enabled)
+{
+  if(this->running)
+    this->start = Instrumentation::now();
+}
+
+Instrumentation::ScopedTimer::~ScopedTimer()
+{
+  this->stop();
+}
+
+void Instrumentation::ScopedTimer::stop()
+{
+  if(this->running && enabled)
+    Instrumentation::add_time(this->name, this->start, Instrumentation::now());
+  this->running = false;
+}
+
+void Instrumentation::add_time(const char* name, double start, double end)
+{
+  double duration = end - start;
+  std::map<const char*, TimerTotals, NameLess>::iterator it = data->timers.find(name);
+  if(it == data->timers.end())
+  {
+    TimerTotals totals = { 1, duration, duration, duration };
+    data->timers.insert(std::pair<const char*, TimerTotals>(name, totals));
+  }
+  else
+  {
+    it->second.min = it->second.calls == 0 ? duration : std::min(it->second.min, duration);
+    it->second.max = it->second.calls == 0 ? duration : std::max(it->second.max, duration);
+    it->second.calls++;
+    it->second.total += duration;
+  }
+
+  if(data->output == TraceOutput)
+  {
+    if((int)data->events.size() < data->max_events)
+    {
+      Event event = { name, 'X', start - data->start, duration };
+      data->events.push_back(event);
+    }
+    else
+      data->dropped_events++;
+  }
+}
+
+void Instrumentation::write()
+{
+  if(!enabled)
+    return;
+  // Only once, also when called explicitly before the exit.
+  enabled = false;
+
+  // The declared timers which never ran are left out.
+  std::vector<const char*> timer_names;
+  for(std::map<const char*, TimerTotals, NameLess>::iterator it = data->timers.begin(); it != data->timers.end(); it++)
+    if(it->second.calls > 0)
+      timer_names.push_back(it->first);
+
+  std::string filename = data->name + (data->output == JsonOutput ? "-instrumentation.json" : "-trace.json");
+  FILE* file = fopen(filename.c_str(), "w");
+  if(file == NULL)
+  {
+    // Called at exit, an exception would only terminate the process.
+    printf("Instrumentation: could not open %s for writing.\n", filename.c_str());
+    return;
+  }
+
+  if(data->output == JsonOutput)
+  {
+    fprintf(file, "{\n  \"name\": \"%s\",\n  \"unit\": \"s\",\n  \"wall time\": %.9g,\n  \"timers\": [", json_escape(data->name.c_str()).c_str(), 1e-6 * (now() - data->start));
+    for(unsigned int i = 0; i < timer_names.size(); i++)
+    {
+      TimerTotals& totals = data->timers[timer_names[i]];
+      fprintf(file, "%s\n    {\"name\": \"%s\", \"calls\": %d, \"total\": %.9g, \"mean\": %.9g, \"min\": %.9g, \"max\": %.9g}",
+        i ? "," : "", json_escape(timer_names[i]).c_str(), totals.calls, 1e-6 * totals.total, 1e-6 * totals.total / totals.calls,
+        1e-6 * totals.min, 1e-6 * totals.max);
+    }
+    fprintf(file, "\n  ],\n  \"counters\": [");
+    bool first = true;
+    for(std::map<const char*, double, NameLess>::iterator it = data->counters.begin(); it != data->counters.end(); it++, first = false)
+      fprintf(file, "%s\n    {\"name\": \"%s\", \"value\": %.9g}", first ? "" : ",", json_escape(it->first).c_str(), it->second);
+    fprintf(file, "\n  ]\n}\n");
+  }
+  else
+  {
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"otherData\": {\"name\": \"%s\", \"dropped events\": %d},\n\"traceEvents\": [",
+      json_escape(data->name.c_str()).c_str(), data->dropped_events);
+    for(unsigned int i = 0; i < data->events.size(); i++)
+    {
+      Event& event = data->events[i];
+      if(event.type == 'X')
+        fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"dur\": %.3f}",
+          i ? "," : "", json_escape(event.name).c_str(), event.start, event.value);
+      else
+        fprintf(file, "%s\n{\"name\": \"%s\", \"ph\": \"C\", \"pid\": 1, \"tid\": 1, \"ts\": %.3f, \"args\": {\"value\": %.9g}}",
+          i ? "," : "", json_escape(event.name).c_str(), event.start, event.value);
+    }
+    fprintf(file, "\n]}\n");
+  }
+
+  fclose(file);
+}
@@ -0,0 +1,83 @@
+#ifndef __HERMES_TESTING_INSTRUMENTATION_H
+#define __HERMES_TESTING_INSTRUMENTATION_H
+
+#include "hermes_common.h"
+
+/// Named scoped timers and counters for the hot paths of a test run.
+///
+/// Typical usage in a test main:
+///   Instrumentation::init("03-navier-stokes");
+///   ...
+///   {
+///     Instrumentation::ScopedTimer timer("newton solve");
+///     newton.solve(coeff_vec);
+///   }
+///   Instrumentation::count("time steps");
+///
+/// The output is selected by the environment variable HERMES_INSTRUMENTATION and written when the process exits:
+///   "json"  ... <name>-instrumentation.json, number of calls and total / min / max time of every timer, totals of the counters,
+///   "trace" ... <name>-trace.json, every timed section and counter update in the Chrome trace event format
+///               (to be opened in chrome://tracing or Perfetto).
+/// When it is not set, a timer or a counter costs one test of a flag, so the instrumentation can be left in release builds.
+/// When it is set, the first use of a name inserts it into a map (allocates), the following ones do not. The names
+/// used in hot loops can be declared after init() by declare_timer() / declare_counter(). The names are compared by
+/// their contents, so the same name used in several places (or built at run time) is one timer or counter.
+/// The trace events are reserved in init() (max_trace_events of them), so recording them does not allocate either.
+///
+/// The names have to be string literals (or otherwise outlive the process), they are not copied.
+/// The instrumentation is meant for the main thread, the calls are not synchronized.
+class Instrumentation
+{
+public:
+  enum Output
+  {
+    NoOutput,
+    JsonOutput,
+    TraceOutput
+  };
+
+  /// Initializes the instrumentation with the output given by HERMES_INSTRUMENTATION.
+  /// max_trace_events is the number of events kept for the trace output (reserved here, about 32 bytes each),
+  /// the following ones are only summed up.
+  static void init(const char* name, int max_trace_events = DEFAULT_MAX_TRACE_EVENTS);
+
+  /// Initializes the instrumentation with the given output.
+  static void init(const char* name, Output output, int max_trace_events = DEFAULT_MAX_TRACE_EVENTS);
+
+  static bool is_enabled();
+
+  /// Adds the value to the counter.
+  static void count(const char* name, double value = 1.0);
+
+  /// Registers the name in advance, so that its first use does not allocate (no-op when disabled).
+  static void declare_timer(const char* name);
+  static void declare_counter(const char* name);
+
+  /// Measures the time from its construction to its destruction (or to stop()).
+  class ScopedTimer
+  {
+  public:
+    ScopedTimer(const char* name);
+    ~ScopedTimer();
+
+    /// Ends the measurement before the end of the scope.
+    void stop();
+
+  private:
+    const char* name;
+    double start;
+    bool running;
+  };
+
+  /// Writes the output (called automatically at exit).
+  static void write();
+
+  /// Default number of events kept for the trace output (about 32 MB).
+  static const int DEFAULT_MAX_TRACE_EVENTS = 1000000;
+
+private:
+  static void add_time(const char* name, double start, double end);
+  static double now();
+};
+
+#endif
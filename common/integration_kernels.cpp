@@ -0,0 +1,250 @@
+#include "integration_kernels.h"
+#include <cstdlib>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace
+{
+  typedef IntegrationKernels::Kernels Kernels;
+
+  const Kernels scalar_kernels = { IntegrationKernels::u_v_scalar, IntegrationKernels::grad_u_grad_v_scalar, IntegrationKernels::w_nabla_u_v_scalar };
+
+#ifdef X86_KERNELS
+  // AVX2 + FMA: two accumulators of four lanes, the remainder by the scalar loop.
+  __attribute__((target("avx2,fma")))
+  inline double sum_lanes(__m256d sum)
+  {
+    __m128d low = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+  }
+
+  __attribute__((target("avx2,fma")))
+  double u_v_avx2(int n, const double* wt, const double* u, const double* v)
+  {
+    __m256d sum_0 = _mm256_setzero_pd(), sum_1 = _mm256_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      sum_0 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(wt + i), _mm256_loadu_pd(u + i)), _mm256_loadu_pd(v + i), sum_0);
+      sum_1 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(wt + i + 4), _mm256_loadu_pd(u + i + 4)), _mm256_loadu_pd(v + i + 4), sum_1);
+    }
+    if(i + 4 <= n)
+    {
+      sum_0 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(wt + i), _mm256_loadu_pd(u + i)), _mm256_loadu_pd(v + i), sum_0);
+      i += 4;
+    }
+    double result = sum_lanes(_mm256_add_pd(sum_0, sum_1));
+    for(; i < n; i++)
+      result += wt[i] * u[i] * v[i];
+    return result;
+  }
+
+  __attribute__((target("avx2,fma")))
+  double grad_u_grad_v_avx2(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy)
+  {
+    __m256d sum_0 = _mm256_setzero_pd(), sum_1 = _mm256_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m256d grad_0 = _mm256_fmadd_pd(_mm256_loadu_pd(u_dx + i), _mm256_loadu_pd(v_dx + i), _mm256_mul_pd(_mm256_loadu_pd(u_dy + i), _mm256_loadu_pd(v_dy + i)));
+      __m256d grad_1 = _mm256_fmadd_pd(_mm256_loadu_pd(u_dx + i + 4), _mm256_loadu_pd(v_dx + i + 4), _mm256_mul_pd(_mm256_loadu_pd(u_dy + i + 4), _mm256_loadu_pd(v_dy + i + 4)));
+      sum_0 = _mm256_fmadd_pd(_mm256_loadu_pd(wt + i), grad_0, sum_0);
+      sum_1 = _mm256_fmadd_pd(_mm256_loadu_pd(wt + i + 4), grad_1, sum_1);
+    }
+    if(i + 4 <= n)
+    {
+      __m256d grad = _mm256_fmadd_pd(_mm256_loadu_pd(u_dx + i), _mm256_loadu_pd(v_dx + i), _mm256_mul_pd(_mm256_loadu_pd(u_dy + i), _mm256_loadu_pd(v_dy + i)));
+      sum_0 = _mm256_fmadd_pd(_mm256_loadu_pd(wt + i), grad, sum_0);
+      i += 4;
+    }
+    double result = sum_lanes(_mm256_add_pd(sum_0, sum_1));
+    for(; i < n; i++)
+      result += wt[i] * (u_dx[i] * v_dx[i] + u_dy[i] * v_dy[i]);
+    return result;
+  }
+
+  __attribute__((target("avx2,fma")))
+  double w_nabla_u_v_avx2(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v)
+  {
+    __m256d sum_0 = _mm256_setzero_pd(), sum_1 = _mm256_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m256d convection_0 = _mm256_fmadd_pd(_mm256_loadu_pd(w1 + i), _mm256_loadu_pd(u_dx + i), _mm256_mul_pd(_mm256_loadu_pd(w2 + i), _mm256_loadu_pd(u_dy + i)));
+      __m256d convection_1 = _mm256_fmadd_pd(_mm256_loadu_pd(w1 + i + 4), _mm256_loadu_pd(u_dx + i + 4), _mm256_mul_pd(_mm256_loadu_pd(w2 + i + 4), _mm256_loadu_pd(u_dy + i + 4)));
+      sum_0 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(wt + i), convection_0), _mm256_loadu_pd(v + i), sum_0);
+      sum_1 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(wt + i + 4), convection_1), _mm256_loadu_pd(v + i + 4), sum_1);
+    }
+    if(i + 4 <= n)
+    {
+      __m256d convection = _mm256_fmadd_pd(_mm256_loadu_pd(w1 + i), _mm256_loadu_pd(u_dx + i), _mm256_mul_pd(_mm256_loadu_pd(w2 + i), _mm256_loadu_pd(u_dy + i)));
+      sum_0 = _mm256_fmadd_pd(_mm256_mul_pd(_mm256_loadu_pd(wt + i), convection), _mm256_loadu_pd(v + i), sum_0);
+      i += 4;
+    }
+    double result = sum_lanes(_mm256_add_pd(sum_0, sum_1));
+    for(; i < n; i++)
+      result += wt[i] * (w1[i] * u_dx[i] + w2[i] * u_dy[i]) * v[i];
+    return result;
+  }
+
+  const Kernels avx2_kernels = { u_v_avx2, grad_u_grad_v_avx2, w_nabla_u_v_avx2 };
+
+  // AVX-512: eight lanes, the remainder by masked loads (the masked-off lanes are zero).
+  __attribute__((target("avx512f")))
+  double u_v_avx512(int n, const double* wt, const double* u, const double* v)
+  {
+    __m512d sum = _mm512_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+      sum = _mm512_fmadd_pd(_mm512_mul_pd(_mm512_loadu_pd(wt + i), _mm512_loadu_pd(u + i)), _mm512_loadu_pd(v + i), sum);
+    if(i < n)
+    {
+      __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+      sum = _mm512_fmadd_pd(_mm512_mul_pd(_mm512_maskz_loadu_pd(mask, wt + i), _mm512_maskz_loadu_pd(mask, u + i)), _mm512_maskz_loadu_pd(mask, v + i), sum);
+    }
+    return _mm512_reduce_add_pd(sum);
+  }
+
+  __attribute__((target("avx512f")))
+  double grad_u_grad_v_avx512(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy)
+  {
+    __m512d sum = _mm512_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m512d grad = _mm512_fmadd_pd(_mm512_loadu_pd(u_dx + i), _mm512_loadu_pd(v_dx + i), _mm512_mul_pd(_mm512_loadu_pd(u_dy + i), _mm512_loadu_pd(v_dy + i)));
+      sum = _mm512_fmadd_pd(_mm512_loadu_pd(wt + i), grad, sum);
+    }
+    if(i < n)
+    {
+      __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+      __m512d grad = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, u_dx + i), _mm512_maskz_loadu_pd(mask, v_dx + i),
+        _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, u_dy + i), _mm512_maskz_loadu_pd(mask, v_dy + i)));
+      sum = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, wt + i), grad, sum);
+    }
+    return _mm512_reduce_add_pd(sum);
+  }
+
+  __attribute__((target("avx512f")))
+  double w_nabla_u_v_avx512(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v)
+  {
+    __m512d sum = _mm512_setzero_pd();
+    int i = 0;
+    for(; i + 8 <= n; i += 8)
+    {
+      __m512d convection = _mm512_fmadd_pd(_mm512_loadu_pd(w1 + i), _mm512_loadu_pd(u_dx + i), _mm512_mul_pd(_mm512_loadu_pd(w2 + i), _mm512_loadu_pd(u_dy + i)));
+      sum = _mm512_fmadd_pd(_mm512_mul_pd(_mm512_loadu_pd(wt + i), convection), _mm512_loadu_pd(v + i), sum);
+    }
+    if(i < n)
+    {
+      __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+      __m512d convection = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, w1 + i), _mm512_maskz_loadu_pd(mask, u_dx + i),
+        _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, w2 + i), _mm512_maskz_loadu_pd(mask, u_dy + i)));
+      sum = _mm512_fmadd_pd(_mm512_mul_pd(_mm512_maskz_loadu_pd(mask, wt + i), convection), _mm512_maskz_loadu_pd(mask, v + i), sum);
+    }
+    return _mm512_reduce_add_pd(sum);
+  }
+
+  const Kernels avx512_kernels = { u_v_avx512, grad_u_grad_v_avx512, w_nabla_u_v_avx512 };
+#endif
+
+  const Kernels* find_kernels(IntegrationKernels::InstructionSet instruction_set)
+  {
+#ifdef X86_KERNELS
+    if(instruction_set == IntegrationKernels::AVX512)
+      return &avx512_kernels;
+    if(instruction_set == IntegrationKernels::AVX2)
+      return &avx2_kernels;
+#endif
+    return &scalar_kernels;
+  }
+
+  IntegrationKernels::InstructionSet current_instruction_set = IntegrationKernels::get_best_instruction_set();
+  const Kernels* kernels = find_kernels(current_instruction_set);
+}
+
+IntegrationKernels::InstructionSet IntegrationKernels::get_best_instruction_set()
+{
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return AVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return AVX2;
+#endif
+  return Scalar;
+}
+
+IntegrationKernels::InstructionSet IntegrationKernels::get_instruction_set()
+{
+  return current_instruction_set;
+}
+
+void IntegrationKernels::set_instruction_set(InstructionSet instruction_set)
+{
+  if(instruction_set > get_best_instruction_set())
+    throw Hermes::Exceptions::Exception("The instruction set %s is not supported by this CPU.", get_name(instruction_set));
+  current_instruction_set = instruction_set;
+  kernels = find_kernels(instruction_set);
+}
+
+const char* IntegrationKernels::get_name(InstructionSet instruction_set)
+{
+  switch(instruction_set)
+  {
+  case AVX512:
+    return "avx512";
+  case AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+IntegrationKernels::Kernels IntegrationKernels::get_kernels()
+{
+  return *kernels;
+}
+
+double IntegrationKernels::u_v(int n, const double* wt, const double* u, const double* v)
+{
+  return kernels->u_v(n, wt, u, v);
+}
+
+double IntegrationKernels::grad_u_grad_v(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy)
+{
+  return kernels->grad_u_grad_v(n, wt, u_dx, u_dy, v_dx, v_dy);
+}
+
+double IntegrationKernels::w_nabla_u_v(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v)
+{
+  return kernels->w_nabla_u_v(n, wt, w1, w2, u_dx, u_dy, v);
+}
+
+double* IntegrationKernels::allocate(int n)
+{
+#ifdef _WIN32
+  double* data = (double*)_aligned_malloc(n * sizeof(double), alignment);
+#else
+  void* data = NULL;
+  if(posix_memalign(&data, alignment, n * sizeof(double)) != 0)
+    data = NULL;
+#endif
+  if(data == NULL)
+    throw Hermes::Exceptions::Exception("Could not allocate %d doubles.", n);
+  return (double*)data;
+}
+
+void IntegrationKernels::free(double* data)
+{
+#ifdef _WIN32
+  _aligned_free(data);
+#else
+  ::free(data);
+#endif
+}
@@ -0,0 +1,118 @@
+#ifndef __HERMES_TESTING_INTEGRATION_KERNELS_H
+#define __HERMES_TESTING_INTEGRATION_KERNELS_H
+
+#include "hermes_common.h"
+
+/// Vectorized versions of the integration loops of the weak forms (int_u_v, int_grad_u_grad_v, ...)
+/// over the quadrature points, for the values and derivatives of Func<double>.
+///
+/// Typical usage in a form:
+///   CustomForm(...) : MatrixFormVol<double>(i, j), kernels(IntegrationKernels::get_kernels()) { ... }
+///
+///   double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v, ...) const
+///   {
+///     return kernels.grad_u_grad_v(n, wt, u->dx, u->dy, v->dx, v->dy) / Reynolds;
+///   }
+///
+/// The instruction set (AVX-512, AVX2 + FMA, or the scalar loops) is chosen at runtime by the CPU,
+/// so the binaries stay portable. get_kernels() resolves it once, a form keeps the result from its
+/// construction on (set_instruction_set() applies to the forms constructed afterwards). Below
+/// SCALAR_THRESHOLD quadrature points (the lowest orders) the scalar loops are inlined instead of
+/// calling the vector kernels, whose setup and horizontal sum do not pay off there. The kernels use unaligned loads: the arrays of Func<double> are
+/// allocated by Hermes, on current CPUs the unaligned loads of aligned data cost the same as the
+/// aligned ones. Data owned by the caller should be allocated by allocate() (aligned to a cache line).
+///
+/// The sums are accumulated in several lanes, so the results may differ from the scalar loops
+/// in the last bits.
+class IntegrationKernels
+{
+public:
+  enum InstructionSet
+  {
+    Scalar,
+    AVX2,
+    AVX512
+  };
+
+  /// The instruction set in use (the best one supported by the CPU unless set_instruction_set() was called).
+  static InstructionSet get_instruction_set();
+
+  /// The best instruction set supported by the CPU (and the compiler).
+  static InstructionSet get_best_instruction_set();
+
+  /// Selects the kernels, e.g. to compare them in a benchmark. Throws if the CPU does not support them.
+  static void set_instruction_set(InstructionSet instruction_set);
+
+  static const char* get_name(InstructionSet instruction_set);
+
+  /// Numbers of quadrature points below which the scalar loops are used by every instruction set.
+  static const int SCALAR_THRESHOLD = 8;
+
+  /// sum wt[i] * u[i] * v[i] (int_u_v, also int_u_dvdx etc. with the derivative arrays).
+  static double u_v_scalar(int n, const double* wt, const double* u, const double* v)
+  {
+    double result = 0.0;
+    for(int i = 0; i < n; i++)
+      result += wt[i] * u[i] * v[i];
+    return result;
+  }
+
+  /// sum wt[i] * (u_dx[i] * v_dx[i] + u_dy[i] * v_dy[i]) (int_grad_u_grad_v).
+  static double grad_u_grad_v_scalar(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy)
+  {
+    double result = 0.0;
+    for(int i = 0; i < n; i++)
+      result += wt[i] * (u_dx[i] * v_dx[i] + u_dy[i] * v_dy[i]);
+    return result;
+  }
+
+  /// sum wt[i] * (w1[i] * u_dx[i] + w2[i] * u_dy[i]) * v[i] (int_w_nabla_u_v).
+  static double w_nabla_u_v_scalar(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v)
+  {
+    double result = 0.0;
+    for(int i = 0; i < n; i++)
+      result += wt[i] * (w1[i] * u_dx[i] + w2[i] * u_dy[i]) * v[i];
+    return result;
+  }
+
+  /// The kernels of one instruction set, see get_kernels().
+  struct Kernels
+  {
+    double u_v(int n, const double* wt, const double* u, const double* v) const
+    {
+      return n < SCALAR_THRESHOLD ? u_v_scalar(n, wt, u, v) : u_v_kernel(n, wt, u, v);
+    }
+
+    double grad_u_grad_v(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy) const
+    {
+      return n < SCALAR_THRESHOLD ? grad_u_grad_v_scalar(n, wt, u_dx, u_dy, v_dx, v_dy) : grad_u_grad_v_kernel(n, wt, u_dx, u_dy, v_dx, v_dy);
+    }
+
+    double w_nabla_u_v(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v) const
+    {
+      return n < SCALAR_THRESHOLD ? w_nabla_u_v_scalar(n, wt, w1, w2, u_dx, u_dy, v) : w_nabla_u_v_kernel(n, wt, w1, w2, u_dx, u_dy, v);
+    }
+
+    double (*u_v_kernel)(int n, const double* wt, const double* u, const double* v);
+    double (*grad_u_grad_v_kernel)(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy);
+    double (*w_nabla_u_v_kernel)(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v);
+  };
+
+  /// The kernels of the instruction set in use, to be kept by a form (or an assembly) instead of
+  /// calling the static functions below for every element.
+  static Kernels get_kernels();
+
+  /// The kernels of the instruction set in use, resolved on every call.
+  static double u_v(int n, const double* wt, const double* u, const double* v);
+  static double grad_u_grad_v(int n, const double* wt, const double* u_dx, const double* u_dy, const double* v_dx, const double* v_dy);
+  static double w_nabla_u_v(int n, const double* wt, const double* w1, const double* w2, const double* u_dx, const double* u_dy, const double* v);
+
+  /// Alignment of allocate().
+  static const int alignment = 64;
+
+  /// Array of n doubles aligned to alignment, to be freed by free().
+  static double* allocate(int n);
+  static void free(double* data);
+};
+
+#endif
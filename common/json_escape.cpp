@@ -0,0 +1,38 @@
+#include "json_escape.h"
+#include <cstdio>
+
+std::string json_escape(const char* text)
+{
+  std::string escaped;
+  for(const char* c = text; *c; c++)
+  {
+    switch(*c)
+    {
+    case '"':
+      escaped += "\\\"";
+      break;
+    case '\\':
+      escaped += "\\\\";
+      break;
+    case '\n':
+      escaped += "\\n";
+      break;
+    case '\r':
+      escaped += "\\r";
+      break;
+    case '\t':
+      escaped += "\\t";
+      break;
+    default:
+      if((unsigned char)*c < 0x20)
+      {
+        char code[8];
+        sprintf(code, "\\u%04x", (unsigned char)*c);
+        escaped += code;
+      }
+      else
+        escaped += *c;
+    }
+  }
+  return escaped;
+}
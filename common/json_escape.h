@@ -0,0 +1,14 @@
+#ifndef __HERMES_TESTING_JSON_ESCAPE_H
+#define __HERMES_TESTING_JSON_ESCAPE_H
+
+#include <string>
+
+/// The text as the contents of a JSON string: quotes and backslashes are escaped, control
+/// characters written as \n, \t, ... or \u00XX. Used for the names in the JSON outputs of
+/// Benchmark and Instrumentation.
+///
+/// Typical usage:
+///   fprintf(file, "{\"name\": \"%s\"}", json_escape(name.c_str()).c_str());
+std::string json_escape(const char* text);
+
+#endif
@@ -0,0 +1,548 @@
+#include "linear_system_reader.h"
+#include <algorithm>
+#include <cctype>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  double squared_norm(double value)
+  {
+    return value * value;
+  }
+  double squared_norm(std::complex<double> value)
+  {
+    return std::norm(value);
+  }
+}
+
+template<typename Scalar>
+CSRSystem<Scalar>::CSRSystem() : size(0)
+{
+}
+
+template<typename Scalar>
+int CSRSystem<Scalar>::get_size() const
+{
+  return this->size;
+}
+
+template<typename Scalar>
+int CSRSystem<Scalar>::get_nnz() const
+{
+  return this->col_ind.size();
+}
+
+template<typename Scalar>
+void CSRSystem<Scalar>::multiply(const Scalar* x, Scalar* y) const
+{
+  for(int i = 0; i < this->size; i++)
+  {
+    Scalar sum = 0.0;
+    for(int k = this->row_ptr[i]; k < this->row_ptr[i + 1]; k++)
+      sum += this->values[k] * x[this->col_ind[k]];
+    y[i] = sum;
+  }
+}
+
+template<typename Scalar>
+double CSRSystem<Scalar>::relative_residual(const Scalar* x) const
+{
+  std::vector<Scalar> product(this->size);
+  if(this->size > 0)
+    this->multiply(x, &product[0]);
+
+  double residual_norm = 0.0, rhs_norm = 0.0;
+  for(int i = 0; i < this->size; i++)
+  {
+    residual_norm += squared_norm(this->rhs[i] - product[i]);
+    rhs_norm += squared_norm(this->rhs[i]);
+  }
+
+  return rhs_norm > 0.0 ? std::sqrt(residual_norm / rhs_norm) : std::sqrt(residual_norm);
+}
+
+template class CSRSystem<double>;
+template class CSRSystem<std::complex<double> >;
+
+namespace
+{
+  // Read-only memory mapping of a whole file.
+  class MappedFile
+  {
+  public:
+    MappedFile(const char* filename) : data(NULL), length(0)
+    {
+#ifdef _WIN32
+      this->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+      this->mapping = NULL;
+      if(this->file == INVALID_HANDLE_VALUE)
+        throw Hermes::Exceptions::Exception("Could not open %s.", filename);
+      LARGE_INTEGER file_size;
+      GetFileSizeEx(this->file, &file_size);
+      this->length = file_size.QuadPart;
+      if(this->length > 0)
+      {
+        this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(this->mapping != NULL)
+          this->data = (const char*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+        if(this->data == NULL)
+        {
+          this->close();
+          throw Hermes::Exceptions::Exception("Could not map %s.", filename);
+        }
+      }
+#else
+      this->file = open(filename, O_RDONLY);
+      if(this->file < 0)
+        throw Hermes::Exceptions::Exception("Could not open %s.", filename);
+      struct stat file_stat;
+      fstat(this->file, &file_stat);
+      this->length = file_stat.st_size;
+      if(this->length > 0)
+      {
+        void* mapped = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, this->file, 0);
+        if(mapped == MAP_FAILED)
+        {
+          this->close();
+          throw Hermes::Exceptions::Exception("Could not map %s.", filename);
+        }
+        this->data = (const char*)mapped;
+        // The file is read once from the beginning to the end.
+        madvise(mapped, this->length, MADV_SEQUENTIAL);
+      }
+#endif
+    }
+
+    ~MappedFile()
+    {
+      this->close();
+    }
+
+    const char* begin() const { return this->data; }
+    const char* end() const { return this->data + this->length; }
+
+  private:
+    void close()
+    {
+#ifdef _WIN32
+      if(this->data != NULL)
+        UnmapViewOfFile(this->data);
+      if(this->mapping != NULL)
+        CloseHandle(this->mapping);
+      CloseHandle(this->file);
+#else
+      if(this->data != NULL)
+        munmap((void*)this->data, this->length);
+      ::close(this->file);
+#endif
+      this->data = NULL;
+    }
+
+    const char* data;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+  };
+
+  // Numbers on one line of the mapped file.
+  class LineParser
+  {
+  public:
+    LineParser(const char* begin, const char* end) : position(begin), end(end)
+    {
+    }
+
+    bool at_end() const
+    {
+      return this->position >= this->end;
+    }
+
+    /// Reads at most max_count numbers from the current line and moves to the next line,
+    /// returns the number of the numbers on the line (comment lines starting with '%' are empty).
+    int read_line(double* numbers, int max_count)
+    {
+      int count = 0;
+      if(this->position < this->end && *this->position == '%')
+        this->skip_line();
+      else
+      {
+        while(this->position < this->end && *this->position != '\n')
+        {
+          if(*this->position == ' ' || *this->position == '\t' || *this->position == '\r')
+          {
+            this->position++;
+            continue;
+          }
+
+          // Tokens are copied to a buffer, the mapped file is not terminated.
+          char token[64];
+          int length = 0;
+          while(this->position < this->end && !isspace(*this->position) && length < 63)
+            token[length++] = *this->position++;
+          token[length] = '\0';
+          // Too long tokens are skipped as a whole.
+          while(this->position < this->end && !isspace(*this->position))
+            this->position++;
+
+          char* token_end;
+          double number = strtod(token, &token_end);
+          if(token_end == token)
+            continue;
+          if(count < max_count)
+            numbers[count] = number;
+          count++;
+        }
+        if(this->position < this->end)
+          this->position++;
+      }
+      return count;
+    }
+
+    /// Skips the rest of the current line, returns it (for the Matrix Market banner).
+    std::string skip_line()
+    {
+      const char* start = this->position;
+      while(this->position < this->end && *this->position != '\n')
+        this->position++;
+      std::string line(start, this->position);
+      if(this->position < this->end)
+        this->position++;
+      return line;
+    }
+
+  private:
+    const char* position;
+    const char* end;
+  };
+
+  template<typename Scalar> Scalar make_scalar(double real, double imag);
+  template<> double make_scalar<double>(double real, double imag)
+  {
+    if(imag != 0.0)
+      throw Hermes::Exceptions::Exception("Complex entry in a real system.");
+    return real;
+  }
+  template<> std::complex<double> make_scalar<std::complex<double> >(double real, double imag)
+  {
+    return std::complex<double>(real, imag);
+  }
+
+  double conjugate(double value)
+  {
+    return value;
+  }
+  std::complex<double> conjugate(std::complex<double> value)
+  {
+    return std::conj(value);
+  }
+
+  // Entries in the order of the file.
+  template<typename Scalar>
+  struct Triplets
+  {
+    std::vector<int> rows;
+    std::vector<int> cols;
+    std::vector<Scalar> values;
+    int count;
+  };
+
+  // Counting sort of the triplets by rows, then sorting by columns within the rows and summing up the duplicates.
+  template<typename Scalar>
+  void build_csr(int size, Triplets<Scalar>& triplets, CSRSystem<Scalar>& system)
+  {
+    system.size = size;
+    system.row_ptr.assign(size + 1, 0);
+    for(int k = 0; k < triplets.count; k++)
+    {
+      if(triplets.rows[k] < 0 || triplets.rows[k] >= size || triplets.cols[k] < 0 || triplets.cols[k] >= size)
+        throw Hermes::Exceptions::Exception("Entry (%d, %d) out of the matrix of size %d.", triplets.rows[k], triplets.cols[k], size);
+      system.row_ptr[triplets.rows[k] + 1]++;
+    }
+    int max_row_length = 0;
+    for(int i = 0; i < size; i++)
+    {
+      max_row_length = std::max(max_row_length, system.row_ptr[i + 1]);
+      system.row_ptr[i + 1] += system.row_ptr[i];
+    }
+
+    // The triplets of every row, in the order of the file.
+    std::vector<int> order(triplets.count);
+    std::vector<int> next(system.row_ptr.begin(), system.row_ptr.end() - 1);
+    for(int k = 0; k < triplets.count; k++)
+      order[next[triplets.rows[k]]++] = k;
+
+    // Every row is sorted by (column, position in the file), so the duplicates are summed up in the order of the file.
+    std::vector<int> col_ind(triplets.count);
+    std::vector<Scalar> values(triplets.count);
+    std::vector<std::pair<int, int> > row(max_row_length);
+    int nnz = 0;
+    for(int i = 0; i < size; i++)
+    {
+      int begin = system.row_ptr[i], length = system.row_ptr[i + 1] - begin;
+      for(int k = 0; k < length; k++)
+        row[k] = std::pair<int, int>(triplets.cols[order[begin + k]], order[begin + k]);
+      std::sort(row.begin(), row.begin() + length);
+
+      system.row_ptr[i] = nnz;
+      for(int k = 0; k < length; k++)
+      {
+        if(k > 0 && row[k].first == row[k - 1].first)
+          values[nnz - 1] += triplets.values[row[k].second];
+        else
+        {
+          col_ind[nnz] = row[k].first;
+          values[nnz] = triplets.values[row[k].second];
+          nnz++;
+        }
+      }
+    }
+    system.row_ptr[size] = nnz;
+
+    col_ind.resize(nnz);
+    values.resize(nnz);
+    system.col_ind.swap(col_ind);
+    system.values.swap(values);
+  }
+
+  template<typename Scalar>
+  void read_linsys(const MappedFile& file, CSRSystem<Scalar>& system)
+  {
+    // Every line holds at most one entry.
+    int lines = std::count(file.begin(), file.end(), '\n') + 1;
+    Triplets<Scalar> triplets;
+    triplets.rows.resize(lines);
+    triplets.cols.resize(lines);
+    triplets.values.resize(lines);
+    triplets.count = 0;
+
+    LineParser parser(file.begin(), file.end());
+    double numbers[5];
+
+    // Size, number of nonzeros.
+    int size = -1;
+    while(!parser.at_end() && size < 0)
+      if(parser.read_line(numbers, 5) >= 1)
+        size = (int)numbers[0];
+    if(size < 0)
+      throw Hermes::Exceptions::Exception("Missing size of the system.");
+    parser.read_line(numbers, 5);
+
+    // Entries until the first line without an entry, the number of numbers
+    // on the first line decides between real (3) and complex (4) values.
+    int entry_numbers = 0;
+    while(!parser.at_end())
+    {
+      int count = parser.read_line(numbers, 5);
+      if(entry_numbers == 0 && (count == 3 || count == 4))
+        entry_numbers = count;
+      if(entry_numbers == 0 || count != entry_numbers)
+        break;
+      triplets.rows[triplets.count] = (int)numbers[0];
+      triplets.cols[triplets.count] = (int)numbers[1];
+      triplets.values[triplets.count] = make_scalar<Scalar>(numbers[2], entry_numbers == 4 ? numbers[3] : 0.0);
+      triplets.count++;
+    }
+    build_csr(size, triplets, system);
+
+    // Right-hand side.
+    system.rhs.assign(size, Scalar(0.0));
+    while(!parser.at_end())
+    {
+      int count = parser.read_line(numbers, 5);
+      if(count == entry_numbers - 1)
+      {
+        int row = (int)numbers[0];
+        if(row < 0 || row >= size)
+          throw Hermes::Exceptions::Exception("Right-hand side entry %d out of the system of size %d.", row, size);
+        system.rhs[row] = make_scalar<Scalar>(numbers[1], entry_numbers == 4 ? numbers[2] : 0.0);
+      }
+    }
+  }
+
+  template<typename Scalar>
+  void read_matrix_market(const MappedFile& file, CSRSystem<Scalar>& system)
+  {
+    LineParser parser(file.begin(), file.end());
+    char object[64], format[64], field[64], symmetry[64];
+    std::string banner = parser.skip_line();
+    if(sscanf(banner.c_str(), "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4
+      || strcasecmp(object, "matrix") != 0 || strcasecmp(format, "coordinate") != 0)
+      throw Hermes::Exceptions::Exception("Only Matrix Market matrices in the coordinate format are supported.");
+    bool pattern = strcasecmp(field, "pattern") == 0;
+    bool complex = strcasecmp(field, "complex") == 0;
+    bool skew = strcasecmp(symmetry, "skew-symmetric") == 0;
+    bool hermitian = strcasecmp(symmetry, "hermitian") == 0;
+    bool symmetric = skew || hermitian || strcasecmp(symmetry, "symmetric") == 0;
+
+    double numbers[4];
+    int count = 0;
+    while(!parser.at_end() && count == 0)
+      count = parser.read_line(numbers, 4);
+    if(count != 3 || numbers[0] != numbers[1])
+      throw Hermes::Exceptions::Exception("Only square Matrix Market matrices are supported.");
+    int size = (int)numbers[0];
+    int entries = (int)numbers[2];
+
+    Triplets<Scalar> triplets;
+    triplets.rows.resize(symmetric ? 2 * entries : entries);
+    triplets.cols.resize(triplets.rows.size());
+    triplets.values.resize(triplets.rows.size());
+    triplets.count = 0;
+
+    int expected = pattern ? 2 : (complex ? 4 : 3);
+    for(int k = 0; k < entries; )
+    {
+      if(parser.at_end())
+        throw Hermes::Exceptions::Exception("Matrix Market file with %d entries instead of %d.", k, entries);
+      count = parser.read_line(numbers, 4);
+      if(count == 0)
+        continue;
+      if(count != expected)
+        throw Hermes::Exceptions::Exception("Matrix Market entry with %d numbers instead of %d.", count, expected);
+
+      // Indices in the file are 1-based.
+      int row = (int)numbers[0] - 1, col = (int)numbers[1] - 1;
+      Scalar value = pattern ? Scalar(1.0) : make_scalar<Scalar>(numbers[2], complex ? numbers[3] : 0.0);
+      triplets.rows[triplets.count] = row;
+      triplets.cols[triplets.count] = col;
+      triplets.values[triplets.count++] = value;
+      if(symmetric && row != col)
+      {
+        triplets.rows[triplets.count] = col;
+        triplets.cols[triplets.count] = row;
+        triplets.values[triplets.count++] = skew ? -value : (hermitian ? conjugate(value) : value);
+      }
+      k++;
+    }
+    build_csr(size, triplets, system);
+
+    std::vector<Scalar> ones(size, Scalar(1.0));
+    system.rhs.resize(size);
+    if(size > 0)
+      system.multiply(&ones[0], &system.rhs[0]);
+  }
+
+  // Header of the binary cache, with the size and the modification time of the file it was read from.
+  struct CacheHeader
+  {
+    char magic[8];
+    int scalar_size;
+    int size;
+    int nnz;
+    long long source_size;
+    long long source_mtime;
+  };
+  const char cache_magic[8] = { 'H', 'T', 'C', 'S', 'R', '0', '0', '2' };
+
+  template<typename Scalar>
+  bool read_cache(const char* filename, const std::string& cache_filename, CSRSystem<Scalar>& system)
+  {
+    struct stat file_stat;
+    if(stat(filename, &file_stat) != 0)
+      return false;
+
+    FILE* file = fopen(cache_filename.c_str(), "rb");
+    if(file == NULL)
+      return false;
+    // A cache of another version of the file (also one with an older modification time, e.g. restored
+    // from an archive) is not used.
+    CacheHeader header;
+    bool valid = fread(&header, sizeof(CacheHeader), 1, file) == 1 && memcmp(header.magic, cache_magic, 8) == 0
+      && header.scalar_size == (int)sizeof(Scalar) && header.source_size == (long long)file_stat.st_size
+      && header.source_mtime == (long long)file_stat.st_mtime;
+    if(valid)
+    {
+      system.size = header.size;
+      system.row_ptr.resize(header.size + 1);
+      system.col_ind.resize(header.nnz);
+      system.values.resize(header.nnz);
+      system.rhs.resize(header.size);
+      valid = fread(&system.row_ptr[0], sizeof(int), header.size + 1, file) == (size_t)header.size + 1
+        && (header.nnz == 0 || fread(&system.col_ind[0], sizeof(int), header.nnz, file) == (size_t)header.nnz)
+        && (header.nnz == 0 || fread(&system.values[0], sizeof(Scalar), header.nnz, file) == (size_t)header.nnz)
+        && (header.size == 0 || fread(&system.rhs[0], sizeof(Scalar), header.size, file) == (size_t)header.size);
+    }
+    fclose(file);
+    return valid;
+  }
+
+  template<typename Scalar>
+  void write_cache(const char* filename, const std::string& cache_filename, const CSRSystem<Scalar>& system)
+  {
+    // The cache is optional, the system was read anyway.
+    struct stat file_stat;
+    if(stat(filename, &file_stat) != 0)
+      return;
+    FILE* file = fopen(cache_filename.c_str(), "wb");
+    if(file == NULL)
+      return;
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+    memcpy(header.magic, cache_magic, 8);
+    header.scalar_size = sizeof(Scalar);
+    header.size = system.size;
+    header.nnz = system.get_nnz();
+    header.source_size = file_stat.st_size;
+    header.source_mtime = file_stat.st_mtime;
+    fwrite(&header, sizeof(CacheHeader), 1, file);
+    fwrite(&system.row_ptr[0], sizeof(int), system.size + 1, file);
+    if(header.nnz > 0)
+    {
+      fwrite(&system.col_ind[0], sizeof(int), header.nnz, file);
+      fwrite(&system.values[0], sizeof(Scalar), header.nnz, file);
+    }
+    if(system.size > 0)
+      fwrite(&system.rhs[0], sizeof(Scalar), system.size, file);
+    fclose(file);
+  }
+}
+
+bool LinearSystemReader::is_matrix_market(const char* filename)
+{
+  FILE* file = fopen(filename, "r");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s.", filename);
+  char banner[15] = "";
+  bool matrix_market = fgets(banner, 15, file) != NULL && strncmp(banner, "%%MatrixMarket", 14) == 0;
+  fclose(file);
+  return matrix_market;
+}
+
+std::string LinearSystemReader::get_cache_filename(const char* filename)
+{
+  return std::string(filename) + ".csr-cache";
+}
+
+template<typename Scalar>
+void LinearSystemReader::read(const char* filename, CSRSystem<Scalar>& system, bool use_cache)
+{
+  std::string cache_filename = get_cache_filename(filename);
+  if(use_cache && read_cache(filename, cache_filename, system))
+    return;
+
+  bool matrix_market = is_matrix_market(filename);
+  {
+    MappedFile file(filename);
+    if(matrix_market)
+      read_matrix_market(file, system);
+    else
+      read_linsys(file, system);
+  }
+
+  if(use_cache)
+    write_cache(filename, cache_filename, system);
+}
+
+template void LinearSystemReader::read<double>(const char* filename, CSRSystem<double>& system, bool use_cache);
+template void LinearSystemReader::read<std::complex<double> >(const char* filename, CSRSystem<std::complex<double> >& system, bool use_cache);
@@ -0,0 +1,60 @@
+#ifndef __HERMES_TESTING_LINEAR_SYSTEM_READER_H
+#define __HERMES_TESTING_LINEAR_SYSTEM_READER_H
+
+#include "hermes_common.h"
+
+/// Sparse linear system in the compressed sparse row format (0-based indices,
+/// sorted column indices within a row, no duplicate entries).
+template<typename Scalar>
+class CSRSystem
+{
+public:
+  CSRSystem();
+
+  int get_size() const;
+  int get_nnz() const;
+
+  /// y = A x.
+  void multiply(const Scalar* x, Scalar* y) const;
+
+  /// ||b - A x|| / ||b|| (||b - A x|| for a zero right-hand side).
+  double relative_residual(const Scalar* x) const;
+
+  int size;
+  /// Start of the rows in col_ind and values, size + 1 items.
+  std::vector<int> row_ptr;
+  std::vector<int> col_ind;
+  std::vector<Scalar> values;
+  std::vector<Scalar> rhs;
+};
+
+/// Reader of linear systems into CSRSystem, for systems with millions of nonzeros.
+///
+/// Supported formats:
+///   - linsys (the files of the linear solver tests): the size, the number of nonzeros,
+///     lines "row column value", an empty line, lines "row value" of the right-hand side.
+///     Complex values are given as two numbers (real and imaginary part).
+///   - Matrix Market coordinate format (real, integer, complex or pattern entries, general,
+///     symmetric, skew-symmetric or hermitian storage), the right-hand side is A * (1, ..., 1).
+/// Duplicate entries are summed up (as SparseMatrix::add() does).
+///
+/// The file is memory-mapped and parsed in place, the entries are stored in preallocated
+/// arrays and sorted into the CSR arrays by a counting sort by rows and std::sort within the rows,
+/// so there is no allocation per entry.
+///
+/// With use_cache, the parsed system is stored in the binary file FILE.csr-cache together with the size
+/// and the modification time of FILE, and read instead of FILE as long as both are unchanged.
+class LinearSystemReader
+{
+public:
+  template<typename Scalar>
+  static void read(const char* filename, CSRSystem<Scalar>& system, bool use_cache = false);
+
+  /// True if the file starts with the Matrix Market banner.
+  static bool is_matrix_market(const char* filename);
+
+  /// Name of the binary cache of the file.
+  static std::string get_cache_filename(const char* filename);
+};
+
+#endif
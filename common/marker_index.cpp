@@ -0,0 +1,101 @@
+#include "marker_index.h"
+
+using namespace Hermes::Hermes2D;
+
+MarkerIndex::MarkerIndex() : mesh(NULL), mesh_seq(-1)
+{
+}
+
+bool MarkerIndex::update(Mesh* mesh)
+{
+  if(mesh == this->mesh && (int)mesh->get_seq() == this->mesh_seq)
+    return false;
+  this->mesh = mesh;
+  this->mesh_seq = mesh->get_seq();
+
+  this->elements.clear();
+  this->all_elements.clear();
+  this->boundary_edges.clear();
+  this->all_boundary_edges.clear();
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    this->elements[e->marker].push_back(e);
+    this->all_elements.push_back(e);
+    for(int edge = 0; edge < e->get_nvert(); edge++)
+      if(e->en[edge]->bnd)
+      {
+        BoundaryEdge boundary_edge = { e, edge };
+        this->boundary_edges[e->en[edge]->marker].push_back(boundary_edge);
+        this->all_boundary_edges.push_back(boundary_edge);
+      }
+  }
+  return true;
+}
+
+const std::vector<Element*>& MarkerIndex::get_elements(int marker) const
+{
+  std::map<int, std::vector<Element*> >::const_iterator it = this->elements.find(marker);
+  return it == this->elements.end() ? this->empty : it->second;
+}
+
+const std::vector<Element*>& MarkerIndex::get_elements(const std::string& marker) const
+{
+  if(this->mesh == NULL)
+    throw Hermes::Exceptions::Exception("MarkerIndex: update() has to be called first.");
+  if(marker == HERMES_ANY)
+    return this->all_elements;
+  Mesh::MarkersConversion::IntValid internal = this->mesh->get_element_markers_conversion().get_internal_marker(marker);
+  return internal.valid ? this->get_elements(internal.marker) : this->empty;
+}
+
+const std::vector<MarkerIndex::BoundaryEdge>& MarkerIndex::get_boundary_edges(int marker) const
+{
+  std::map<int, std::vector<BoundaryEdge> >::const_iterator it = this->boundary_edges.find(marker);
+  return it == this->boundary_edges.end() ? this->empty_edges : it->second;
+}
+
+const std::vector<MarkerIndex::BoundaryEdge>& MarkerIndex::get_boundary_edges(const std::string& marker) const
+{
+  if(this->mesh == NULL)
+    throw Hermes::Exceptions::Exception("MarkerIndex: update() has to be called first.");
+  if(marker == HERMES_ANY)
+    return this->all_boundary_edges;
+  Mesh::MarkersConversion::IntValid internal = this->mesh->get_boundary_markers_conversion().get_internal_marker(marker);
+  return internal.valid ? this->get_boundary_edges(internal.marker) : this->empty_edges;
+}
+
+std::vector<int> MarkerIndex::get_area_markers() const
+{
+  std::vector<int> markers;
+  for(std::map<int, std::vector<Element*> >::const_iterator it = this->elements.begin(); it != this->elements.end(); it++)
+    markers.push_back(it->first);
+  return markers;
+}
+
+std::vector<int> MarkerIndex::get_boundary_markers() const
+{
+  std::vector<int> markers;
+  for(std::map<int, std::vector<BoundaryEdge> >::const_iterator it = this->boundary_edges.begin(); it != this->boundary_edges.end(); it++)
+    markers.push_back(it->first);
+  return markers;
+}
+
+template<typename Scalar>
+std::vector<Scalar> MarkerIndex::get_area_values(const std::map<std::string, Scalar>& values, Scalar default_value) const
+{
+  if(this->mesh == NULL)
+    throw Hermes::Exceptions::Exception("MarkerIndex: update() has to be called first.");
+  std::vector<Scalar> table(this->elements.empty() ? 0 : this->elements.rbegin()->first + 1, default_value);
+  for(typename std::map<std::string, Scalar>::const_iterator it = values.begin(); it != values.end(); it++)
+  {
+    Mesh::MarkersConversion::IntValid internal = this->mesh->get_element_markers_conversion().get_internal_marker(it->first);
+    if(internal.valid && internal.marker < (int)table.size())
+      table[internal.marker] = it->second;
+  }
+  return table;
+}
+
+template std::vector<double> MarkerIndex::get_area_values<double>(const std::map<std::string, double>& values, double default_value) const;
+template std::vector<std::complex<double> > MarkerIndex::get_area_values<std::complex<double> >(const std::map<std::string, std::complex<double> >& values,
+  std::complex<double> default_value) const;
@@ -0,0 +1,76 @@
+#ifndef __HERMES_TESTING_MARKER_INDEX_H
+#define __HERMES_TESTING_MARKER_INDEX_H
+
+#include "hermes2d.h"
+
+/// Lists of the active elements of a mesh per area marker and of the boundary edges per boundary marker.
+///
+/// A form restricted to an area (a material) iterates over the list of its marker instead of visiting
+/// all elements and checking the marker, so the traversal of all forms costs O(elements) instead of
+/// O(elements x forms) marker checks. Likewise, surface forms and boundary integrals iterate over
+/// the edges of their boundary marker, i.e. in O(boundary edges) instead of O(elements). The lists
+/// are rebuilt by update() when the mesh changed (refinement, unrefinement, ...) since the last call.
+/// Forms assembled by Hermes use get_area_values() instead, for a coefficient per area marker.
+///
+/// Typical usage:
+///   MarkerIndex index;
+///   index.update(&mesh);
+///   for(each form)
+///   {
+///     const std::vector<Element*>& elements = index.get_elements(form->areas[0]);
+///     for(unsigned int i = 0; i < elements.size(); i++)
+///       ... the form on elements[i] ...
+///   }
+///   const std::vector<MarkerIndex::BoundaryEdge>& edges = index.get_boundary_edges("Outer");
+///   for(unsigned int i = 0; i < edges.size(); i++)
+///     ... the surface form on the edge edges[i].edge of edges[i].e ...
+class MarkerIndex
+{
+public:
+  MarkerIndex();
+
+  /// An edge of an active element on the boundary.
+  struct BoundaryEdge
+  {
+    Hermes::Hermes2D::Element* e;
+    int edge;
+  };
+
+  /// Rebuilds the lists if the mesh is another one or it changed since the last call, which is returned.
+  bool update(Hermes::Hermes2D::Mesh* mesh);
+
+  /// Active elements with the internal area marker.
+  const std::vector<Hermes::Hermes2D::Element*>& get_elements(int marker) const;
+  /// Active elements with the user area marker, all active elements for HERMES_ANY.
+  const std::vector<Hermes::Hermes2D::Element*>& get_elements(const std::string& marker) const;
+
+  /// Boundary edges with the internal boundary marker.
+  const std::vector<BoundaryEdge>& get_boundary_edges(int marker) const;
+  /// Boundary edges with the user boundary marker, all boundary edges for HERMES_ANY.
+  const std::vector<BoundaryEdge>& get_boundary_edges(const std::string& marker) const;
+
+  /// Internal area markers of the active elements.
+  std::vector<int> get_area_markers() const;
+
+  /// Values of a piecewise constant coefficient given per user area marker, indexed by the internal
+  /// area marker (Geom::elem_marker in a form), default_value for the markers not given. With it, one
+  /// form over HERMES_ANY replaces a form restricted to each area.
+  template<typename Scalar>
+  std::vector<Scalar> get_area_values(const std::map<std::string, Scalar>& values, Scalar default_value) const;
+  /// Internal markers of the boundary edges.
+  std::vector<int> get_boundary_markers() const;
+
+private:
+  Hermes::Hermes2D::Mesh* mesh;
+  int mesh_seq;
+
+  std::map<int, std::vector<Hermes::Hermes2D::Element*> > elements;
+  std::vector<Hermes::Hermes2D::Element*> all_elements;
+  std::map<int, std::vector<BoundaryEdge> > boundary_edges;
+  std::vector<BoundaryEdge> all_boundary_edges;
+  /// Returned for the markers without elements (edges).
+  std::vector<Hermes::Hermes2D::Element*> empty;
+  std::vector<BoundaryEdge> empty_edges;
+};
+
+#endif
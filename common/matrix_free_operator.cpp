@@ -0,0 +1,332 @@
+#include "matrix_free_operator.h"
+#include "gauss_legendre.h"
+#include <algorithm>
+
+namespace
+{
+  struct Triplet
+  {
+    int row, col;
+    double value;
+    bool operator<(const Triplet& other) const
+    {
+      return row < other.row || (row == other.row && col < other.col);
+    }
+  };
+
+  double dot(int n, const double* x, const double* y)
+  {
+    double result = 0.0;
+    for(int i = 0; i < n; i++)
+      result += x[i] * y[i];
+    return result;
+  }
+}
+
+MatrixFreeOperator::MatrixFreeOperator(int nx, int ny, double width, double height, int degree) :
+  nx(nx), ny(ny), hx(width / nx), hy(height / ny), degree(degree),
+  size_x(nx * degree + 1), size_y(ny * degree + 1), sum_factorization(degree, degree + 2)
+{
+  if(nx < 1 || ny < 1 || degree < 1)
+    throw Hermes::Exceptions::Exception("Wrong parameters of MatrixFreeOperator.");
+
+  // The reference map x = x0 + hx (xi + 1) / 2, y = y0 + hy (eta + 1) / 2.
+  this->det = this->hx * this->hy / 4;
+  this->g_xx = this->hy / this->hx;
+  this->g_yy = this->hx / this->hy;
+
+  // The vertex functions at the ends of both directions.
+  for(int i = 0; i < this->size_x; i++)
+    for(int j = 0; j < this->size_y; j++)
+      if(i == 0 || i == nx || j == 0 || j == ny)
+        this->boundary_dofs.push_back(i * this->size_y + j);
+
+  int num_points = this->sum_factorization.get_num_points();
+  this->values.resize(num_points);
+  this->dx.resize(num_points);
+  this->dy.resize(num_points);
+}
+
+int MatrixFreeOperator::get_size() const
+{
+  return this->size_x * this->size_y;
+}
+
+int MatrixFreeOperator::get_degree() const
+{
+  return this->degree;
+}
+
+void MatrixFreeOperator::get_dofs(int element_x, int element_y, int* dofs) const
+{
+  // 1D numbering: the vertices 0 ... n, then the bubbles of the elements one after another.
+  int n = this->degree + 1;
+  for(int i = 0; i < n; i++)
+  {
+    int index_x = i == 0 ? element_x : i == 1 ? element_x + 1 : this->nx + 1 + element_x * (this->degree - 1) + i - 2;
+    bool boundary_x = i < 2 && (index_x == 0 || index_x == this->nx);
+    for(int j = 0; j < n; j++)
+    {
+      int index_y = j == 0 ? element_y : j == 1 ? element_y + 1 : this->ny + 1 + element_y * (this->degree - 1) + j - 2;
+      bool boundary_y = j < 2 && (index_y == 0 || index_y == this->ny);
+      dofs[i * n + j] = boundary_x || boundary_y ? -1 : index_x * this->size_y + index_y;
+    }
+  }
+}
+
+void MatrixFreeOperator::apply_local(double mass, double diffusion, const double* local, double* result) const
+{
+  int num_points = this->sum_factorization.get_num_points();
+  this->sum_factorization.evaluate(local, &this->values[0], &this->dx[0], &this->dy[0]);
+  for(int k = 0; k < num_points; k++)
+  {
+    this->values[k] *= mass * this->det;
+    this->dx[k] *= diffusion * this->g_xx;
+    this->dy[k] *= diffusion * this->g_yy;
+  }
+  this->sum_factorization.integrate(mass != 0.0 ? &this->values[0] : NULL, &this->dx[0], &this->dy[0], result);
+}
+
+void MatrixFreeOperator::apply(double mass, double diffusion, const double* x, double* y) const
+{
+  int num_functions = this->sum_factorization.get_num_functions();
+  std::vector<int> dofs(num_functions);
+  std::vector<double> local(num_functions), result(num_functions);
+
+  std::fill(y, y + this->get_size(), 0.0);
+  for(int element_x = 0; element_x < this->nx; element_x++)
+    for(int element_y = 0; element_y < this->ny; element_y++)
+    {
+      this->get_dofs(element_x, element_y, &dofs[0]);
+      for(int k = 0; k < num_functions; k++)
+        local[k] = dofs[k] >= 0 ? x[dofs[k]] : 0.0;
+      this->apply_local(mass, diffusion, &local[0], &result[0]);
+      for(int k = 0; k < num_functions; k++)
+        if(dofs[k] >= 0)
+          y[dofs[k]] += result[k];
+    }
+
+  for(unsigned int i = 0; i < this->boundary_dofs.size(); i++)
+    y[this->boundary_dofs[i]] = x[this->boundary_dofs[i]];
+}
+
+void MatrixFreeOperator::get_diagonal(double mass, double diffusion, double* diagonal) const
+{
+  // The diagonal of the local matrix is a product of the 1D integrals
+  // m_k = int l_k^2 and s_k = int l_k'^2.
+  int n = this->degree + 1;
+  std::vector<double> points, weights;
+  gauss_legendre(this->degree + 2, points, weights);
+  std::vector<double> m(n, 0.0), s(n, 0.0);
+  for(int k = 0; k < n; k++)
+    for(unsigned int a = 0; a < points.size(); a++)
+    {
+      m[k] += weights[a] * SumFactorization::lobatto(k, points[a]) * SumFactorization::lobatto(k, points[a]);
+      s[k] += weights[a] * SumFactorization::lobatto_dx(k, points[a]) * SumFactorization::lobatto_dx(k, points[a]);
+    }
+
+  std::vector<int> dofs(n * n);
+  std::fill(diagonal, diagonal + this->get_size(), 0.0);
+  for(int element_x = 0; element_x < this->nx; element_x++)
+    for(int element_y = 0; element_y < this->ny; element_y++)
+    {
+      this->get_dofs(element_x, element_y, &dofs[0]);
+      for(int i = 0; i < n; i++)
+        for(int j = 0; j < n; j++)
+          if(dofs[i * n + j] >= 0)
+            diagonal[dofs[i * n + j]] += mass * this->det * m[i] * m[j]
+              + diffusion * (this->g_xx * s[i] * m[j] + this->g_yy * m[i] * s[j]);
+    }
+
+  for(unsigned int i = 0; i < this->boundary_dofs.size(); i++)
+    diagonal[this->boundary_dofs[i]] = 1.0;
+}
+
+int MatrixFreeOperator::solve(double mass, double diffusion, const double* rhs, double* x, double tolerance, int max_iterations) const
+{
+  int size = this->get_size();
+  std::vector<double> diagonal(size), r(size), z(size), p(size), q(size);
+  this->get_diagonal(mass, diffusion, &diagonal[0]);
+
+  this->apply(mass, diffusion, x, &q[0]);
+  for(int i = 0; i < size; i++)
+  {
+    r[i] = rhs[i] - q[i];
+    z[i] = r[i] / diagonal[i];
+    p[i] = z[i];
+  }
+  double rhs_norm = std::sqrt(dot(size, rhs, rhs));
+  if(rhs_norm == 0.0)
+    rhs_norm = 1.0;
+  double rz = dot(size, &r[0], &z[0]);
+
+  for(int iteration = 0; iteration < max_iterations; iteration++)
+  {
+    if(std::sqrt(dot(size, &r[0], &r[0])) <= tolerance * rhs_norm)
+      return iteration;
+
+    this->apply(mass, diffusion, &p[0], &q[0]);
+    double alpha = rz / dot(size, &p[0], &q[0]);
+    for(int i = 0; i < size; i++)
+    {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+      z[i] = r[i] / diagonal[i];
+    }
+    double rz_new = dot(size, &r[0], &z[0]);
+    double beta = rz_new / rz;
+    rz = rz_new;
+    for(int i = 0; i < size; i++)
+      p[i] = z[i] + beta * p[i];
+  }
+  throw Hermes::Exceptions::Exception("The conjugate gradients did not converge in %d iterations.", max_iterations);
+}
+
+void MatrixFreeOperator::integrate(double (*f)(double x, double y), double* rhs) const
+{
+  int num_functions = this->sum_factorization.get_num_functions();
+  int num_points = this->sum_factorization.get_num_points();
+  std::vector<int> dofs(num_functions);
+  std::vector<double> result(num_functions);
+
+  std::fill(rhs, rhs + this->get_size(), 0.0);
+  for(int element_x = 0; element_x < this->nx; element_x++)
+    for(int element_y = 0; element_y < this->ny; element_y++)
+    {
+      for(int k = 0; k < num_points; k++)
+      {
+        double xi, eta;
+        this->sum_factorization.get_point(k, xi, eta);
+        this->values[k] = this->det * f((element_x + (xi + 1) / 2) * this->hx, (element_y + (eta + 1) / 2) * this->hy);
+      }
+      this->sum_factorization.integrate(&this->values[0], NULL, NULL, &result[0]);
+      this->get_dofs(element_x, element_y, &dofs[0]);
+      for(int k = 0; k < num_functions; k++)
+        if(dofs[k] >= 0)
+          rhs[dofs[k]] += result[k];
+    }
+}
+
+void MatrixFreeOperator::project(double (*f)(double x, double y), double* x) const
+{
+  std::vector<double> rhs(this->get_size());
+  this->integrate(f, &rhs[0]);
+  std::fill(x, x + this->get_size(), 0.0);
+  this->solve(1.0, 0.0, &rhs[0], x, 1e-14);
+}
+
+double MatrixFreeOperator::l2_error(const double* u, double (*f)(double x, double y)) const
+{
+  int num_functions = this->sum_factorization.get_num_functions();
+  int num_points = this->sum_factorization.get_num_points();
+  const double* weights = this->sum_factorization.get_weights();
+  std::vector<int> dofs(num_functions);
+  std::vector<double> local(num_functions);
+
+  double error = 0.0;
+  for(int element_x = 0; element_x < this->nx; element_x++)
+    for(int element_y = 0; element_y < this->ny; element_y++)
+    {
+      this->get_dofs(element_x, element_y, &dofs[0]);
+      for(int k = 0; k < num_functions; k++)
+        local[k] = dofs[k] >= 0 ? u[dofs[k]] : 0.0;
+      this->sum_factorization.evaluate(&local[0], &this->values[0]);
+      for(int k = 0; k < num_points; k++)
+      {
+        double xi, eta;
+        this->sum_factorization.get_point(k, xi, eta);
+        double difference = this->values[k] - f((element_x + (xi + 1) / 2) * this->hx, (element_y + (eta + 1) / 2) * this->hy);
+        error += weights[k] * this->det * difference * difference;
+      }
+    }
+  return std::sqrt(error);
+}
+
+void MatrixFreeOperator::explicit_rk_step(Hermes::ButcherTable* bt, double diffusion, double tau, double* u, double tolerance) const
+{
+  int size = this->get_size();
+  int num_stages = bt->get_size();
+  std::vector<std::vector<double> > k(num_stages, std::vector<double>(size, 0.0));
+  std::vector<double> stage(size), rhs(size);
+
+  for(int i = 0; i < num_stages; i++)
+  {
+    for(int j = i; j < num_stages; j++)
+      if(bt->get_A(i, j) != 0.0)
+        throw Hermes::Exceptions::Exception("The Butcher's table is not explicit.");
+
+    // M k_i = -diffusion K (u + tau sum_j a_ij k_j).
+    for(int l = 0; l < size; l++)
+    {
+      stage[l] = u[l];
+      for(int j = 0; j < i; j++)
+        stage[l] += tau * bt->get_A(i, j) * k[j][l];
+    }
+    this->apply(0.0, diffusion, &stage[0], &rhs[0]);
+    for(int l = 0; l < size; l++)
+      rhs[l] = -rhs[l];
+    // The boundary rows of rhs are -u there, i.e. zero.
+    if(i > 0)
+      k[i] = k[i - 1];
+    this->solve(1.0, 0.0, &rhs[0], &k[i][0], tolerance);
+  }
+
+  for(int i = 0; i < num_stages; i++)
+    for(int l = 0; l < size; l++)
+      u[l] += tau * bt->get_B(i) * k[i][l];
+}
+
+void MatrixFreeOperator::assemble(double mass, double diffusion, CSRSystem<double>& system) const
+{
+  int num_functions = this->sum_factorization.get_num_functions();
+  std::vector<int> dofs(num_functions);
+  std::vector<double> unit(num_functions, 0.0), column(num_functions);
+
+  // The local matrices column by column, then the triplets sorted and summed.
+  std::vector<Triplet> triplets;
+  for(int element_x = 0; element_x < this->nx; element_x++)
+    for(int element_y = 0; element_y < this->ny; element_y++)
+    {
+      this->get_dofs(element_x, element_y, &dofs[0]);
+      for(int c = 0; c < num_functions; c++)
+      {
+        if(dofs[c] < 0)
+          continue;
+        unit[c] = 1.0;
+        this->apply_local(mass, diffusion, &unit[0], &column[0]);
+        unit[c] = 0.0;
+        for(int r = 0; r < num_functions; r++)
+          if(dofs[r] >= 0)
+          {
+            Triplet triplet = { dofs[r], dofs[c], column[r] };
+            triplets.push_back(triplet);
+          }
+      }
+    }
+  for(unsigned int i = 0; i < this->boundary_dofs.size(); i++)
+  {
+    Triplet triplet = { this->boundary_dofs[i], this->boundary_dofs[i], 1.0 };
+    triplets.push_back(triplet);
+  }
+  std::sort(triplets.begin(), triplets.end());
+
+  int size = this->get_size();
+  system.size = size;
+  system.row_ptr.assign(size + 1, 0);
+  system.col_ind.clear();
+  system.values.clear();
+  system.rhs.assign(size, 0.0);
+  for(unsigned int i = 0; i < triplets.size(); i++)
+  {
+    if(i > 0 && triplets[i].row == triplets[i - 1].row && triplets[i].col == triplets[i - 1].col)
+    {
+      system.values.back() += triplets[i].value;
+      continue;
+    }
+    system.col_ind.push_back(triplets[i].col);
+    system.values.push_back(triplets[i].value);
+    system.row_ptr[triplets[i].row + 1]++;
+  }
+  for(int i = 0; i < size; i++)
+    system.row_ptr[i + 1] += system.row_ptr[i];
+}
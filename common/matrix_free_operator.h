@@ -0,0 +1,81 @@
+#ifndef __HERMES_TESTING_MATRIX_FREE_OPERATOR_H
+#define __HERMES_TESTING_MATRIX_FREE_OPERATOR_H
+
+#include "hermes_common.h"
+#include "linear_system_reader.h"
+#include "sum_factorization.h"
+
+/// The operator  mass * M + diffusion * K  (M the mass matrix, K the stiffness matrix of the Laplacian)
+/// of the continuous H1 space of degree p on an nx x ny grid of rectangles covering (0, width) x (0, height),
+/// with homogeneous Dirichlet conditions, applied element by element without assembling any matrix.
+///
+/// The basis is the tensor product of the 1D Lobatto functions (see SumFactorization), the vertex
+/// functions are shared by the neighbouring elements, the bubbles are local to an element. The values
+/// and gradients at the quadrature points are obtained and integrated by sum factorization, the geometric
+/// factors of the elements are computed once. The memory is O(number of DOFs), against the
+/// O(number of DOFs * (2p + 1)^2) of the sparse matrix.
+///
+/// The rows of the boundary DOFs are the identity, so the operator is symmetric positive definite and
+/// the vectors which are zero on the boundary stay so.
+///
+/// Only apply() and get_diagonal() touch the operator, so solve() (the conjugate gradients) and
+/// explicit_rk_step() need no matrix at all; assemble() gives the CSRSystem of the same operator for
+/// the sparse solvers. At p = 8 on 16 x 16 elements the matrix takes 18 MB for 17k DOFs, while the
+/// operator keeps the geometric factors of one element size (see 07-matrix-free).
+class MatrixFreeOperator
+{
+public:
+  MatrixFreeOperator(int nx, int ny, double width, double height, int degree);
+
+  /// Number of DOFs, including the boundary ones.
+  int get_size() const;
+  int get_degree() const;
+
+  /// y = (mass * M + diffusion * K) x.
+  void apply(double mass, double diffusion, const double* x, double* y) const;
+
+  /// The diagonal of mass * M + diffusion * K.
+  void get_diagonal(double mass, double diffusion, double* diagonal) const;
+
+  /// Solves (mass * M + diffusion * K) x = rhs by the conjugate gradients with the Jacobi preconditioner,
+  /// x is the initial guess. Returns the number of iterations, throws if the relative residual does not
+  /// drop below the tolerance in max_iterations.
+  int solve(double mass, double diffusion, const double* rhs, double* x, double tolerance, int max_iterations = 10000) const;
+
+  /// Integrals of f against the basis functions (zero for the boundary DOFs).
+  void integrate(double (*f)(double x, double y), double* rhs) const;
+
+  /// L2 projection of f (f should vanish on the boundary).
+  void project(double (*f)(double x, double y), double* x) const;
+
+  /// || u - f ||_L2.
+  double l2_error(const double* u, double (*f)(double x, double y)) const;
+
+  /// One step of an explicit Runge-Kutta method for M u' = -diffusion * K u, the stages are obtained
+  /// by solve() with the mass matrix.
+  void explicit_rk_step(Hermes::ButcherTable* bt, double diffusion, double tau, double* u, double tolerance) const;
+
+  /// The assembled matrix (the same boundary rows), for comparison.
+  void assemble(double mass, double diffusion, CSRSystem<double>& system) const;
+
+private:
+  /// Global DOFs of the (p + 1)^2 functions of the element (-1 for the boundary ones).
+  void get_dofs(int element_x, int element_y, int* dofs) const;
+  /// Values of one element, after sum_factorization.evaluate(), multiplied by the geometric factors.
+  void apply_local(double mass, double diffusion, const double* local, double* result) const;
+
+  int nx, ny;
+  double hx, hy;
+  int degree;
+  /// Number of the 1D functions in x and y (vertices and bubbles).
+  int size_x, size_y;
+  SumFactorization sum_factorization;
+  std::vector<int> boundary_dofs;
+  /// Geometric factors of the (identical) elements: |det J| and |det J| J^-1 J^-T (diagonal).
+  double det, g_xx, g_yy;
+
+  /// Work arrays of the points.
+  mutable std::vector<double> values, dx, dy;
+};
+
+#endif
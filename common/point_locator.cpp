@@ -0,0 +1,244 @@
+#include "point_locator.h"
+
+using namespace Hermes::Hermes2D;
+
+const double PointLocator::TOLERANCE = 1e-10;
+
+bool PointLocator::Box::contains(double x, double y) const
+{
+  return x >= this->x_min && x <= this->x_max && y >= this->y_min && y <= this->y_max;
+}
+
+bool PointLocator::Box::intersects(const Box& box) const
+{
+  return this->x_min <= box.x_max && box.x_min <= this->x_max && this->y_min <= box.y_max && box.y_min <= this->y_max;
+}
+
+PointLocator::PointLocator(Mesh* mesh) : mesh(mesh), mesh_seq(-1), depth(0), num_tested(0)
+{
+  this->refmap.set_quad_2d(&g_quad_2d_std);
+}
+
+PointLocator::Box PointLocator::get_box(Element* e)
+{
+  Box box = { e->vn[0]->x, e->vn[0]->y, e->vn[0]->x, e->vn[0]->y };
+  for(int i = 1; i < e->get_nvert(); i++)
+  {
+    box.x_min = std::min(box.x_min, e->vn[i]->x);
+    box.x_max = std::max(box.x_max, e->vn[i]->x);
+    box.y_min = std::min(box.y_min, e->vn[i]->y);
+    box.y_max = std::max(box.y_max, e->vn[i]->y);
+  }
+  if(e->is_curved())
+  {
+    // The points of the highest edge rule on all edges.
+    this->refmap.set_active_element(e);
+    Quad2D* quad = this->refmap.get_quad_2d();
+    for(int edge = 0; edge < e->get_nvert(); edge++)
+    {
+      int points = quad->get_edge_points(edge, quad->get_max_order(e->get_mode()), e->get_mode());
+      int np = quad->get_num_points(points, e->get_mode());
+      double* x = this->refmap.get_phys_x(points);
+      double* y = this->refmap.get_phys_y(points);
+      for(int i = 0; i < np; i++)
+      {
+        box.x_min = std::min(box.x_min, x[i]);
+        box.x_max = std::max(box.x_max, x[i]);
+        box.y_min = std::min(box.y_min, y[i]);
+        box.y_max = std::max(box.y_max, y[i]);
+      }
+    }
+  }
+
+  // The points on the edges are found in both elements, also the curved edges between the points.
+  double margin = (e->is_curved() ? 0.05 : TOLERANCE) * std::max(box.x_max - box.x_min, box.y_max - box.y_min);
+  box.x_min -= margin;
+  box.y_min -= margin;
+  box.x_max += margin;
+  box.y_max += margin;
+  return box;
+}
+
+void PointLocator::build()
+{
+  this->elements.clear();
+  this->boxes.clear();
+  this->nodes.clear();
+  this->leaf_elements.clear();
+  this->depth = 0;
+
+  Element* e;
+  for_all_active_elements(e, this->mesh)
+  {
+    this->elements.push_back(e);
+    this->boxes.push_back(this->get_box(e));
+  }
+  if(this->elements.empty())
+    return;
+
+  TreeNode root;
+  root.box = this->boxes[0];
+  for(unsigned int i = 1; i < this->boxes.size(); i++)
+  {
+    root.box.x_min = std::min(root.box.x_min, this->boxes[i].x_min);
+    root.box.x_max = std::max(root.box.x_max, this->boxes[i].x_max);
+    root.box.y_min = std::min(root.box.y_min, this->boxes[i].y_min);
+    root.box.y_max = std::max(root.box.y_max, this->boxes[i].y_max);
+  }
+  this->nodes.push_back(root);
+
+  std::vector<int> all(this->elements.size());
+  for(unsigned int i = 0; i < all.size(); i++)
+    all[i] = i;
+  this->build_node(0, all, 0, false);
+}
+
+void PointLocator::build_node(int node, std::vector<int>& elements, int depth, bool leaf)
+{
+  this->depth = std::max(this->depth, depth);
+  if(leaf || (int)elements.size() <= LEAF_SIZE || depth == MAX_DEPTH)
+  {
+    this->nodes[node].children = -1;
+    this->nodes[node].begin = this->leaf_elements.size();
+    this->leaf_elements.insert(this->leaf_elements.end(), elements.begin(), elements.end());
+    this->nodes[node].end = this->leaf_elements.size();
+    return;
+  }
+
+  // The quadrants (push_back may move the nodes, so no references are kept).
+  Box box = this->nodes[node].box;
+  double x_mid = (box.x_min + box.x_max) / 2, y_mid = (box.y_min + box.y_max) / 2;
+  int children = this->nodes.size();
+  this->nodes[node].children = children;
+  for(int i = 0; i < 4; i++)
+  {
+    TreeNode child;
+    child.box.x_min = i % 2 ? x_mid : box.x_min;
+    child.box.x_max = i % 2 ? box.x_max : x_mid;
+    child.box.y_min = i / 2 ? y_mid : box.y_min;
+    child.box.y_max = i / 2 ? box.y_max : y_mid;
+    this->nodes.push_back(child);
+  }
+
+  for(int i = 0; i < 4; i++)
+  {
+    std::vector<int> child_elements;
+    for(unsigned int k = 0; k < elements.size(); k++)
+      if(this->boxes[elements[k]].intersects(this->nodes[children + i].box))
+        child_elements.push_back(elements[k]);
+    // Elements larger than the quadrant: splitting further would not help.
+    this->build_node(children + i, child_elements, depth + 1, child_elements.size() == elements.size());
+  }
+}
+
+bool PointLocator::contains(Element* e, double x, double y, double& xi, double& eta)
+{
+  if(e->is_curved())
+  {
+    this->refmap.set_active_element(e);
+    this->refmap.untransform(e, x, y, xi, eta);
+  }
+  else if(e->is_triangle())
+  {
+    // The reference triangle (-1, -1), (1, -1), (-1, 1).
+    Node** v = e->vn;
+    double a = v[1]->x - v[0]->x, b = v[2]->x - v[0]->x;
+    double c = v[1]->y - v[0]->y, d = v[2]->y - v[0]->y;
+    double det = a * d - b * c;
+    xi = 2 * (d * (x - v[0]->x) - b * (y - v[0]->y)) / det - 1;
+    eta = 2 * (-c * (x - v[0]->x) + a * (y - v[0]->y)) / det - 1;
+  }
+  else
+  {
+    // Newton's method for the bilinear map of the reference quad (-1, 1)^2.
+    const double xi_vertex[4] = { -1.0, 1.0, 1.0, -1.0 };
+    const double eta_vertex[4] = { -1.0, -1.0, 1.0, 1.0 };
+    xi = eta = 0.0;
+    for(int iteration = 0; iteration < 20; iteration++)
+    {
+      double fx = -x, fy = -y, x_xi = 0, x_eta = 0, y_xi = 0, y_eta = 0;
+      for(int i = 0; i < 4; i++)
+      {
+        double s = 1.0 + xi_vertex[i] * xi, t = 1.0 + eta_vertex[i] * eta;
+        fx += e->vn[i]->x * s * t / 4;
+        fy += e->vn[i]->y * s * t / 4;
+        x_xi += e->vn[i]->x * xi_vertex[i] * t / 4;
+        y_xi += e->vn[i]->y * xi_vertex[i] * t / 4;
+        x_eta += e->vn[i]->x * s * eta_vertex[i] / 4;
+        y_eta += e->vn[i]->y * s * eta_vertex[i] / 4;
+      }
+      double det = x_xi * y_eta - x_eta * y_xi;
+      double d_xi = (y_eta * fx - x_eta * fy) / det, d_eta = (-y_xi * fx + x_xi * fy) / det;
+      xi -= d_xi;
+      eta -= d_eta;
+      if(std::abs(d_xi) + std::abs(d_eta) < 1e-14)
+        break;
+    }
+  }
+  if(e->is_triangle())
+    return xi >= -1 - TOLERANCE && eta >= -1 - TOLERANCE && xi + eta <= TOLERANCE;
+  return std::abs(xi) <= 1 + TOLERANCE && std::abs(eta) <= 1 + TOLERANCE;
+}
+
+Element* PointLocator::locate(double x, double y, double& xi, double& eta)
+{
+  if((int)this->mesh->get_seq() != this->mesh_seq)
+  {
+    this->build();
+    this->mesh_seq = this->mesh->get_seq();
+  }
+
+  this->num_tested = 0;
+  if(this->nodes.empty() || !this->nodes[0].box.contains(x, y))
+    return NULL;
+  int node = 0;
+  while(this->nodes[node].children >= 0)
+  {
+    const Box& box = this->nodes[node].box;
+    int i = (x >= (box.x_min + box.x_max) / 2 ? 1 : 0) + (y >= (box.y_min + box.y_max) / 2 ? 2 : 0);
+    node = this->nodes[node].children + i;
+  }
+
+  for(int k = this->nodes[node].begin; k < this->nodes[node].end; k++)
+  {
+    int index = this->leaf_elements[k];
+    if(!this->boxes[index].contains(x, y))
+      continue;
+    this->num_tested++;
+    if(this->contains(this->elements[index], x, y, xi, eta))
+      return this->elements[index];
+  }
+  return NULL;
+}
+
+Element* PointLocator::locate(double x, double y)
+{
+  double xi, eta;
+  return this->locate(x, y, xi, eta);
+}
+
+template<typename Scalar>
+bool PointLocator::get_value(Solution<Scalar>* sln, double x, double y, Scalar& value, int item)
+{
+  if(sln->get_mesh() != this->mesh)
+    throw Hermes::Exceptions::Exception("PointLocator: the solution has to be defined on the mesh of the locator.");
+  double xi, eta;
+  Element* e = this->locate(x, y, xi, eta);
+  if(e == NULL)
+    return false;
+  value = item == 0 ? sln->get_ref_value(e, xi, eta) : sln->get_ref_value_transformed(e, xi, eta, 0, item);
+  return true;
+}
+
+int PointLocator::get_num_tested() const
+{
+  return this->num_tested;
+}
+
+int PointLocator::get_depth() const
+{
+  return this->depth;
+}
+
+template bool PointLocator::get_value<double>(Solution<double>* sln, double x, double y, double& value, int item);
+template bool PointLocator::get_value<std::complex<double> >(Solution<std::complex<double> >* sln, double x, double y, std::complex<double>& value, int item);
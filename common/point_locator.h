@@ -0,0 +1,85 @@
+#ifndef __HERMES_TESTING_POINT_LOCATOR_H
+#define __HERMES_TESTING_POINT_LOCATOR_H
+
+#include "hermes2d.h"
+
+/// Location of the active element containing a point, for repeated point values (probes, transfer
+/// of solutions between meshes, ...) instead of the search of Solution::get_pt_value().
+///
+/// The bounding boxes of the active elements are stored in a quadtree, which is built on the first
+/// locate() after the construction or a change of the mesh (refinement, ...). A point is tested only
+/// against the elements of its leaf: straight triangles by the inverse of their affine map, straight
+/// quads by the Newton iteration for their bilinear map, curved elements by the Newton iteration
+/// of RefMap::untransform(). The bounding boxes of curved elements are taken from points on their edges.
+///
+/// Typical usage:
+///   PointLocator locator(&mesh);
+///   for(each probe)
+///   {
+///     double value;
+///     if(locator.get_value(&sln, x, y, value))
+///       ...
+///   }
+class PointLocator
+{
+public:
+  PointLocator(Hermes::Hermes2D::Mesh* mesh);
+
+  /// The active element containing the point and the reference coordinates of the point in it,
+  /// NULL if the point is outside of the mesh. A point on an edge may be found in either element.
+  Hermes::Hermes2D::Element* locate(double x, double y, double& xi, double& eta);
+  Hermes::Hermes2D::Element* locate(double x, double y);
+
+  /// Value of the solution (defined on the mesh of the locator) at the point, false if it is outside of the mesh.
+  /// item selects the value (0) or a derivative (1 = dx, 2 = dy), as in Solution::get_ref_value_transformed().
+  template<typename Scalar>
+  bool get_value(Hermes::Hermes2D::Solution<Scalar>* sln, double x, double y, Scalar& value, int item = 0);
+
+  /// Number of the elements tested by the last locate().
+  int get_num_tested() const;
+  /// Depth of the quadtree.
+  int get_depth() const;
+
+  /// Maximum number of elements in a leaf (unless the depth is MAX_DEPTH).
+  static const int LEAF_SIZE = 8;
+  static const int MAX_DEPTH = 24;
+  /// Relative tolerance of the reference coordinates and the bounding boxes.
+  static const double TOLERANCE;
+
+private:
+  struct Box
+  {
+    double x_min, y_min, x_max, y_max;
+    bool contains(double x, double y) const;
+    bool intersects(const Box& box) const;
+  };
+
+  struct TreeNode
+  {
+    Box box;
+    /// Index of the first of the four children, -1 in a leaf.
+    int children;
+    /// Elements of a leaf: indices to leaf_elements.
+    int begin, end;
+  };
+
+  void build();
+  /// leaf if splitting further would not help (all elements are larger than the quadrants).
+  void build_node(int node, std::vector<int>& elements, int depth, bool leaf);
+  Box get_box(Hermes::Hermes2D::Element* e);
+  bool contains(Hermes::Hermes2D::Element* e, double x, double y, double& xi, double& eta);
+
+  Hermes::Hermes2D::Mesh* mesh;
+  int mesh_seq;
+
+  std::vector<Hermes::Hermes2D::Element*> elements;
+  std::vector<Box> boxes;
+  std::vector<TreeNode> nodes;
+  std::vector<int> leaf_elements;
+  int depth;
+  int num_tested;
+
+  Hermes::Hermes2D::RefMap refmap;
+};
+
+#endif
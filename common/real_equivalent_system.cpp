@@ -0,0 +1,197 @@
+#include "real_equivalent_system.h"
+
+RealEquivalentSystem::RealEquivalentSystem(const CSRSystem<std::complex<double> >& system) : system(system)
+{
+}
+
+int RealEquivalentSystem::get_size() const
+{
+  return 2 * this->system.get_size();
+}
+
+int RealEquivalentSystem::get_nnz() const
+{
+  return 4 * this->system.get_nnz();
+}
+
+int RealEquivalentSystem::get_row(int row, int* cols, double* values) const
+{
+  int i = row / 2;
+  bool imaginary_row = row % 2 == 1;
+  int count = 0;
+  for(int k = this->system.row_ptr[i]; k < this->system.row_ptr[i + 1]; k++)
+  {
+    std::complex<double> value = this->system.values[k];
+    int col = 2 * this->system.col_ind[k];
+    cols[count] = col;
+    values[count++] = imaginary_row ? value.imag() : value.real();
+    cols[count] = col + 1;
+    values[count++] = imaginary_row ? value.real() : -value.imag();
+  }
+  return count;
+}
+
+int RealEquivalentSystem::get_max_row_length() const
+{
+  int length = 0;
+  for(int i = 0; i < this->system.get_size(); i++)
+    length = std::max(length, this->system.row_ptr[i + 1] - this->system.row_ptr[i]);
+  return 2 * length;
+}
+
+void RealEquivalentSystem::get_rhs(double* rhs) const
+{
+  for(int i = 0; i < this->system.get_size(); i++)
+  {
+    rhs[2 * i] = this->system.rhs[i].real();
+    rhs[2 * i + 1] = this->system.rhs[i].imag();
+  }
+}
+
+void RealEquivalentSystem::multiply(const double* x, double* y) const
+{
+  // The 2 x 2 blocks are applied as complex products, in the order of the complex entries.
+  for(int i = 0; i < this->system.get_size(); i++)
+  {
+    double real = 0.0, imag = 0.0;
+    for(int k = this->system.row_ptr[i]; k < this->system.row_ptr[i + 1]; k++)
+    {
+      std::complex<double> value = this->system.values[k];
+      double x_real = x[2 * this->system.col_ind[k]], x_imag = x[2 * this->system.col_ind[k] + 1];
+      real += value.real() * x_real - value.imag() * x_imag;
+      imag += value.imag() * x_real + value.real() * x_imag;
+    }
+    y[2 * i] = real;
+    y[2 * i + 1] = imag;
+  }
+}
+
+static double dot(int n, const double* x, const double* y)
+{
+  double result = 0.0;
+  for(int i = 0; i < n; i++)
+    result += x[i] * y[i];
+  return result;
+}
+
+int RealEquivalentSystem::solve(double* x, double tolerance, int max_iterations) const
+{
+  int n = this->system.get_size();
+  int size = 2 * n;
+  if(size == 0)
+    return 0;
+
+  // Inverses of the diagonal entries, the preconditioner applied to the pair (2i, 2i + 1) is their product.
+  std::vector<std::complex<double> > inverse_diagonal(n, std::complex<double>(1.0, 0.0));
+  for(int i = 0; i < n; i++)
+    for(int k = this->system.row_ptr[i]; k < this->system.row_ptr[i + 1]; k++)
+      if(this->system.col_ind[k] == i && this->system.values[k] != 0.0)
+        inverse_diagonal[i] = 1.0 / this->system.values[k];
+
+  std::vector<double> b(size), r(size), r_hat(size), p(size, 0.0), v(size, 0.0), y(size), s(size), z(size), t(size);
+  this->get_rhs(&b[0]);
+  this->multiply(x, &r[0]);
+  for(int i = 0; i < size; i++)
+    r[i] = b[i] - r[i];
+  r_hat = r;
+  double rhs_norm = std::sqrt(dot(size, &b[0], &b[0]));
+  if(rhs_norm == 0.0)
+    rhs_norm = 1.0;
+
+  double rho = 1.0, alpha = 1.0, omega = 1.0;
+  for(int iteration = 0; iteration < max_iterations; iteration++)
+  {
+    if(std::sqrt(dot(size, &r[0], &r[0])) <= tolerance * rhs_norm)
+      return iteration;
+
+    double rho_new = dot(size, &r_hat[0], &r[0]);
+    if(rho_new == 0.0 || omega == 0.0)
+      throw Hermes::Exceptions::Exception("RealEquivalentSystem: BiCGStab broke down in the iteration %d.", iteration);
+    double beta = (rho_new / rho) * (alpha / omega);
+    rho = rho_new;
+    for(int i = 0; i < size; i++)
+      p[i] = r[i] + beta * (p[i] - omega * v[i]);
+
+    this->precondition(&inverse_diagonal[0], &p[0], &y[0]);
+    this->multiply(&y[0], &v[0]);
+    alpha = rho / dot(size, &r_hat[0], &v[0]);
+    for(int i = 0; i < size; i++)
+      s[i] = r[i] - alpha * v[i];
+    if(std::sqrt(dot(size, &s[0], &s[0])) <= tolerance * rhs_norm)
+    {
+      for(int i = 0; i < size; i++)
+        x[i] += alpha * y[i];
+      return iteration + 1;
+    }
+
+    this->precondition(&inverse_diagonal[0], &s[0], &z[0]);
+    this->multiply(&z[0], &t[0]);
+    omega = dot(size, &t[0], &s[0]) / dot(size, &t[0], &t[0]);
+    for(int i = 0; i < size; i++)
+    {
+      x[i] += alpha * y[i] + omega * z[i];
+      r[i] = s[i] - omega * t[i];
+    }
+  }
+  throw Hermes::Exceptions::Exception("RealEquivalentSystem: BiCGStab did not converge in %d iterations.", max_iterations);
+}
+
+void RealEquivalentSystem::precondition(const std::complex<double>* inverse_diagonal, const double* x, double* y) const
+{
+  for(int i = 0; i < this->system.get_size(); i++)
+  {
+    std::complex<double> value = inverse_diagonal[i] * std::complex<double>(x[2 * i], x[2 * i + 1]);
+    y[2 * i] = value.real();
+    y[2 * i + 1] = value.imag();
+  }
+}
+
+double RealEquivalentSystem::relative_residual(const double* x) const
+{
+  std::vector<std::complex<double> > z(this->system.get_size());
+  if(this->system.get_size() > 0)
+    to_complex(this->system.get_size(), x, &z[0]);
+  return this->system.relative_residual(z.empty() ? NULL : &z[0]);
+}
+
+void RealEquivalentSystem::assemble(Hermes::Algebra::SparseMatrix<double>* matrix, Hermes::Algebra::Vector<double>* rhs) const
+{
+  int n = this->system.get_size();
+  matrix->prealloc(2 * n);
+  for(int i = 0; i < n; i++)
+    for(int k = this->system.row_ptr[i]; k < this->system.row_ptr[i + 1]; k++)
+    {
+      int j = this->system.col_ind[k];
+      matrix->pre_add_ij(2 * i, 2 * j);
+      matrix->pre_add_ij(2 * i, 2 * j + 1);
+      matrix->pre_add_ij(2 * i + 1, 2 * j);
+      matrix->pre_add_ij(2 * i + 1, 2 * j + 1);
+    }
+
+  matrix->alloc();
+  for(int i = 0; i < n; i++)
+    for(int k = this->system.row_ptr[i]; k < this->system.row_ptr[i + 1]; k++)
+    {
+      int j = this->system.col_ind[k];
+      std::complex<double> value = this->system.values[k];
+      matrix->add(2 * i, 2 * j, value.real());
+      matrix->add(2 * i, 2 * j + 1, -value.imag());
+      matrix->add(2 * i + 1, 2 * j, value.imag());
+      matrix->add(2 * i + 1, 2 * j + 1, value.real());
+    }
+  matrix->finish();
+
+  rhs->alloc(2 * n);
+  for(int i = 0; i < n; i++)
+  {
+    rhs->add(2 * i, this->system.rhs[i].real());
+    rhs->add(2 * i + 1, this->system.rhs[i].imag());
+  }
+  rhs->finish();
+}
+
+void RealEquivalentSystem::to_complex(int n, const double* x, std::complex<double>* z)
+{
+  for(int i = 0; i < n; i++)
+    z[i] = std::complex<double>(x[2 * i], x[2 * i + 1]);
+}
@@ -0,0 +1,62 @@
+#ifndef __HERMES_TESTING_REAL_EQUIVALENT_SYSTEM_H
+#define __HERMES_TESTING_REAL_EQUIVALENT_SYSTEM_H
+
+#include "linear_system_reader.h"
+
+/// Real-equivalent form of a complex linear system A x = b for real solvers.
+///
+/// The unknowns are interleaved, x = (Re x_0, Im x_0, Re x_1, Im x_1, ...), so every complex
+/// entry a_ij becomes the 2 x 2 block
+///   [Re a_ij  -Im a_ij]
+///   [Im a_ij   Re a_ij]
+/// at the rows 2i, 2i + 1 and the columns 2j, 2j + 1. The real matrix keeps the sparsity
+/// structure of the complex one (which is what the fill-reducing orderings and the incomplete
+/// factorizations of the real solvers see), unlike the split form [Re A, -Im A; Im A, Re A].
+///
+/// The operator works directly on the CSR arrays of the complex system. solve() is matrix-free,
+/// the 2n x 2n matrix with four times the nonzeros is never stored; assemble() inserts it into
+/// the matrix of a (direct) real solver, which then holds all the 4 * nnz entries.
+class RealEquivalentSystem
+{
+public:
+  RealEquivalentSystem(const CSRSystem<std::complex<double> >& system);
+
+  /// 2n.
+  int get_size() const;
+  /// Four times the nonzeros of the complex matrix.
+  int get_nnz() const;
+
+  /// Column indices and values of one row of the real matrix, returns their number.
+  /// The arrays have to hold get_max_row_length() items.
+  int get_row(int row, int* cols, double* values) const;
+  int get_max_row_length() const;
+
+  /// Right-hand side (2n items).
+  void get_rhs(double* rhs) const;
+
+  /// y = A x, both 2n items.
+  void multiply(const double* x, double* y) const;
+
+  /// Solves A x = b by BiCGStab with multiply() and the block Jacobi preconditioner (the 2 x 2 blocks
+  /// of the complex diagonal, inverted as complex numbers), x (2n items) is the initial guess.
+  /// Returns the number of iterations, throws on a breakdown or if the relative residual does not
+  /// drop below the tolerance in max_iterations.
+  int solve(double* x, double tolerance, int max_iterations = 10000) const;
+
+  /// ||b - A x|| / ||b||, equal to the relative residual of the complex solution.
+  double relative_residual(const double* x) const;
+
+  /// Inserts the matrix and the right-hand side into the structures of a real solver.
+  void assemble(Hermes::Algebra::SparseMatrix<double>* matrix, Hermes::Algebra::Vector<double>* rhs) const;
+
+  /// Complex solution (n items) from the real one (2n items).
+  static void to_complex(int n, const double* x, std::complex<double>* z);
+
+private:
+  /// y = D^-1 x with the 2 x 2 blocks of the diagonal.
+  void precondition(const std::complex<double>* inverse_diagonal, const double* x, double* y) const;
+
+  const CSRSystem<std::complex<double> >& system;
+};
+
+#endif
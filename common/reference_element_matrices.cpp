@@ -0,0 +1,148 @@
+#include "reference_element_matrices.h"
+#include "gauss_legendre.h"
+
+using namespace Hermes::Hermes2D;
+
+namespace
+{
+  int get_degree(Shapeset* shapeset, int index, ElementMode2D mode)
+  {
+    int order = shapeset->get_order(index, mode);
+    return std::max(H2D_GET_H_ORDER(order), H2D_GET_V_ORDER(order));
+  }
+}
+
+ReferenceElementMatrices::ReferenceElementMatrices(Shapeset* shapeset) : shapeset(shapeset)
+{
+}
+
+bool ReferenceElementMatrices::is_affine(Element* e)
+{
+  if(e->is_curved())
+    return false;
+  if(e->is_triangle())
+    return true;
+
+  // A parallelogram: v0 + v2 == v1 + v3.
+  double dx = e->vn[0]->x + e->vn[2]->x - e->vn[1]->x - e->vn[3]->x;
+  double dy = e->vn[0]->y + e->vn[2]->y - e->vn[1]->y - e->vn[3]->y;
+  double diameter = std::abs(e->vn[2]->x - e->vn[0]->x) + std::abs(e->vn[2]->y - e->vn[0]->y)
+    + std::abs(e->vn[3]->x - e->vn[1]->x) + std::abs(e->vn[3]->y - e->vn[1]->y);
+  return std::abs(dx) + std::abs(dy) <= 1e-12 * diameter;
+}
+
+bool ReferenceElementMatrices::get_local_matrix(Element* e, AsmList<double>* al, double diffusion, double mass, double* local)
+{
+  if(!is_affine(e))
+    return false;
+
+  // The reference map x = x0 + J (xi + 1, eta + 1) / 2 of the vertices 0, 1 and the last one,
+  // the reference triangle is (-1, -1), (1, -1), (-1, 1), the reference quad (-1, 1)^2.
+  Node* v0 = e->vn[0];
+  Node* v1 = e->vn[1];
+  Node* v2 = e->vn[e->get_nvert() - 1];
+  double a = (v1->x - v0->x) / 2, b = (v2->x - v0->x) / 2;
+  double c = (v1->y - v0->y) / 2, d = (v2->y - v0->y) / 2;
+  double det = std::abs(a * d - b * c);
+
+  // G = |det J| J^-1 J^-T.
+  double g_xx = (b * b + d * d) / det;
+  double g_xy = -(a * b + c * d) / det;
+  double g_yy = (a * a + c * c) / det;
+
+  const Block& block = this->get_block(e->get_mode(), al);
+  const double* dx_dx = &block.dx_dx[0];
+  const double* dx_dy = &block.dx_dy[0];
+  const double* dy_dy = &block.dy_dy[0];
+  const double* u_v = &block.u_v[0];
+  double mass_det = mass * det;
+  int cnt = al->cnt;
+  for(int i = 0; i < cnt; i++)
+  {
+    double coef_i = al->coef[i];
+    for(int j = 0, k = i * cnt; j < cnt; j++, k++)
+      local[k] = (diffusion * (g_xx * dx_dx[k] + g_xy * dx_dy[k] + g_yy * dy_dy[k]) + mass_det * u_v[k]) * coef_i * al->coef[j];
+  }
+  return true;
+}
+
+int ReferenceElementMatrices::get_num_cached() const
+{
+  return this->cache[0].size() + this->cache[1].size();
+}
+
+int ReferenceElementMatrices::get_num_blocks() const
+{
+  return this->blocks[0].size() + this->blocks[1].size();
+}
+
+const ReferenceElementMatrices::Block& ReferenceElementMatrices::get_block(ElementMode2D mode, AsmList<double>* al)
+{
+  std::map<std::vector<int>, Block>& blocks = this->blocks[mode == HERMES_MODE_QUAD ? 1 : 0];
+  int cnt = al->cnt;
+  this->key.assign(al->idx, al->idx + cnt);
+  std::map<std::vector<int>, Block>::iterator it = blocks.find(this->key);
+  if(it != blocks.end())
+    return it->second;
+
+  // The mixed derivatives enter the local matrix only as a sum (G is symmetric).
+  Block block;
+  block.dx_dx.resize(cnt * cnt);
+  block.dx_dy.resize(cnt * cnt);
+  block.dy_dy.resize(cnt * cnt);
+  block.u_v.resize(cnt * cnt);
+  for(int i = 0; i < cnt; i++)
+    for(int j = 0; j < cnt; j++)
+    {
+      const Integrals& integrals = this->get_integrals(mode, al->idx[j], al->idx[i]);
+      block.dx_dx[i * cnt + j] = integrals.dx_dx;
+      block.dx_dy[i * cnt + j] = integrals.dx_dy + integrals.dy_dx;
+      block.dy_dy[i * cnt + j] = integrals.dy_dy;
+      block.u_v[i * cnt + j] = integrals.u_v;
+    }
+  return blocks.insert(std::make_pair(this->key, block)).first->second;
+}
+
+const ReferenceElementMatrices::Integrals& ReferenceElementMatrices::get_integrals(ElementMode2D mode, int index_u, int index_v)
+{
+  std::map<std::pair<int, int>, Integrals>& cache = this->cache[mode == HERMES_MODE_QUAD ? 1 : 0];
+  std::pair<int, int> key(index_u, index_v);
+  std::map<std::pair<int, int>, Integrals>::iterator it = cache.find(key);
+  if(it == cache.end())
+    it = cache.insert(std::make_pair(key, this->calculate_integrals(mode, index_u, index_v))).first;
+  return it->second;
+}
+
+ReferenceElementMatrices::Integrals ReferenceElementMatrices::calculate_integrals(ElementMode2D mode, int index_u, int index_v) const
+{
+  // Exact for the product (plus one for the collapsed coordinates of the triangle).
+  int degree = get_degree(this->shapeset, index_u, mode) + get_degree(this->shapeset, index_v, mode);
+  std::vector<double> points, weights;
+  gauss_legendre(degree / 2 + 2, points, weights);
+
+  Integrals integrals = { 0.0, 0.0, 0.0, 0.0, 0.0 };
+  int n = points.size();
+  for(int i = 0; i < n; i++)
+    for(int j = 0; j < n; j++)
+    {
+      double x = points[i], y = points[j], weight = weights[i] * weights[j];
+      if(mode == HERMES_MODE_TRIANGLE)
+      {
+        // The square (-1, 1)^2 collapsed to the reference triangle.
+        x = (1.0 + points[i]) * (1.0 - points[j]) / 2 - 1.0;
+        weight *= (1.0 - points[j]) / 2;
+      }
+      double u = this->shapeset->get_fn_value(index_u, x, y, 0, mode);
+      double u_dx = this->shapeset->get_dx_value(index_u, x, y, 0, mode);
+      double u_dy = this->shapeset->get_dy_value(index_u, x, y, 0, mode);
+      double v = this->shapeset->get_fn_value(index_v, x, y, 0, mode);
+      double v_dx = this->shapeset->get_dx_value(index_v, x, y, 0, mode);
+      double v_dy = this->shapeset->get_dy_value(index_v, x, y, 0, mode);
+      integrals.dx_dx += weight * u_dx * v_dx;
+      integrals.dx_dy += weight * u_dx * v_dy;
+      integrals.dy_dx += weight * u_dy * v_dx;
+      integrals.dy_dy += weight * u_dy * v_dy;
+      integrals.u_v += weight * u * v;
+    }
+  return integrals;
+}
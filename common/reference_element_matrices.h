@@ -0,0 +1,69 @@
+#ifndef __HERMES_TESTING_REFERENCE_ELEMENT_MATRICES_H
+#define __HERMES_TESTING_REFERENCE_ELEMENT_MATRICES_H
+
+#include "hermes2d.h"
+
+/// Local matrices of the constant-coefficient form
+///   diffusion * int grad u . grad v + mass * int u v
+/// (DefaultJacobianDiffusion + DefaultMatrixFormVol with constant Hermes1DFunction / Hermes2DFunction)
+/// on affine elements, without any quadrature on the elements.
+///
+/// The geometry of an affine element (a triangle or a parallelogram with straight edges) enters
+/// only through the constant Jacobian J of the reference map, so
+///   int_K grad u . grad v = sum_ab G_ab int_ref d_a u d_b v,   G = |det J| J^-1 J^-T,
+///   int_K u v = |det J| int_ref u v.
+/// The reference integrals are computed once per element type and pair of shape functions and
+/// cached in dense blocks, one per element type and list of shape functions of an element (given
+/// by its orders and the orientation of its edges) and indexed by the position in the assembly
+/// list. The local matrix of an element is then one lookup and a contiguous combination of four
+/// cached arrays.
+///
+/// Elements which are not affine (curved or general quadrilaterals) are left to the quadrature
+/// of the assembler, see get_local_matrix(). The cache is not synchronized, use one instance per thread.
+class ReferenceElementMatrices
+{
+public:
+  ReferenceElementMatrices(Hermes::Hermes2D::Shapeset* shapeset);
+
+  /// Straight-sided triangle or parallelogram.
+  static bool is_affine(Hermes::Hermes2D::Element* e);
+
+  /// Local matrix (al->cnt x al->cnt, row-major, rows for the test functions) of the element,
+  /// including the coefficients of the assembly list. Returns false (and leaves local untouched)
+  /// if the element is not affine.
+  bool get_local_matrix(Hermes::Hermes2D::Element* e, Hermes::Hermes2D::AsmList<double>* al,
+    double diffusion, double mass, double* local);
+
+  /// Number of cached pairs of shape functions.
+  int get_num_cached() const;
+
+  /// Number of cached blocks (lists of shape functions).
+  int get_num_blocks() const;
+
+private:
+  /// Reference integrals of one pair of shape functions (u, v).
+  struct Integrals
+  {
+    double dx_dx, dx_dy, dy_dx, dy_dy;
+    double u_v;
+  };
+
+  /// Reference integrals of all pairs of the shape functions of an element, row-major
+  /// (rows for the test functions) in the order of the assembly list.
+  struct Block
+  {
+    std::vector<double> dx_dx, dx_dy, dy_dy, u_v;
+  };
+
+  const Block& get_block(Hermes::Hermes2D::ElementMode2D mode, Hermes::Hermes2D::AsmList<double>* al);
+  const Integrals& get_integrals(Hermes::Hermes2D::ElementMode2D mode, int index_u, int index_v);
+  Integrals calculate_integrals(Hermes::Hermes2D::ElementMode2D mode, int index_u, int index_v) const;
+
+  Hermes::Hermes2D::Shapeset* shapeset;
+  std::map<std::pair<int, int>, Integrals> cache[2];
+  std::map<std::vector<int>, Block> blocks[2];
+  /// The key of the last lookup, kept so that a lookup does not allocate.
+  std::vector<int> key;
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include "sum_factorization.h"
+#include "gauss_legendre.h"
+#include <cmath>
+
+namespace
+{
+  /// Legendre polynomials P_0 ... P_n at x.
+  void legendre(int n, double x, double* p)
+  {
+    p[0] = 1.0;
+    if(n > 0)
+      p[1] = x;
+    for(int k = 2; k <= n; k++)
+      p[k] = ((2 * k - 1) * x * p[k - 1] - (k - 1) * p[k - 2]) / k;
+  }
+}
+
+SumFactorization::SumFactorization(int degree, int num_points) : degree(degree), num_points(num_points)
+{
+  gauss_legendre(num_points, this->points_1d, this->weights_1d);
+
+  int n = degree + 1;
+  this->basis.resize(n * num_points);
+  this->basis_dx.resize(n * num_points);
+  for(int k = 0; k < n; k++)
+    for(int a = 0; a < num_points; a++)
+    {
+      this->basis[k * num_points + a] = lobatto(k, this->points_1d[a]);
+      this->basis_dx[k * num_points + a] = lobatto_dx(k, this->points_1d[a]);
+    }
+
+  this->weights.resize(num_points * num_points);
+  for(int a = 0; a < num_points; a++)
+    for(int b = 0; b < num_points; b++)
+      this->weights[a * num_points + b] = this->weights_1d[a] * this->weights_1d[b];
+
+  this->work.resize(n * num_points);
+  this->work_d.resize(n * num_points);
+}
+
+int SumFactorization::get_degree() const
+{
+  return this->degree;
+}
+
+int SumFactorization::get_num_functions() const
+{
+  return (this->degree + 1) * (this->degree + 1);
+}
+
+int SumFactorization::get_num_points() const
+{
+  return this->num_points * this->num_points;
+}
+
+const double* SumFactorization::get_weights() const
+{
+  return &this->weights[0];
+}
+
+void SumFactorization::get_point(int index, double& x, double& y) const
+{
+  x = this->points_1d[index / this->num_points];
+  y = this->points_1d[index % this->num_points];
+}
+
+void SumFactorization::evaluate(const double* coefs, double* values, double* dx, double* dy) const
+{
+  int n = this->degree + 1, q = this->num_points;
+  const double* B = &this->basis[0];
+  const double* D = &this->basis_dx[0];
+  double* t = &this->work[0];
+  double* t_d = &this->work_d[0];
+
+  // t_ib = sum_j c_ij l_j(y_b), t_d_ib = sum_j c_ij l_j'(y_b).
+  for(int i = 0; i < n; i++)
+    for(int b = 0; b < q; b++)
+    {
+      double sum = 0.0, sum_d = 0.0;
+      for(int j = 0; j < n; j++)
+      {
+        sum += coefs[i * n + j] * B[j * q + b];
+        sum_d += coefs[i * n + j] * D[j * q + b];
+      }
+      t[i * q + b] = sum;
+      t_d[i * q + b] = sum_d;
+    }
+
+  // u_ab = sum_i l_i(x_a) t_ib, u_dx_ab = sum_i l_i'(x_a) t_ib, u_dy_ab = sum_i l_i(x_a) t_d_ib.
+  for(int a = 0; a < q; a++)
+    for(int b = 0; b < q; b++)
+    {
+      double value = 0.0, value_dx = 0.0, value_dy = 0.0;
+      for(int i = 0; i < n; i++)
+      {
+        value += B[i * q + a] * t[i * q + b];
+        value_dx += D[i * q + a] * t[i * q + b];
+        value_dy += B[i * q + a] * t_d[i * q + b];
+      }
+      values[a * q + b] = value;
+      if(dx)
+        dx[a * q + b] = value_dx;
+      if(dy)
+        dy[a * q + b] = value_dy;
+    }
+}
+
+void SumFactorization::integrate(const double* f, const double* f_dx, const double* f_dy, double* result) const
+{
+  int n = this->degree + 1, q = this->num_points;
+  const double* B = &this->basis[0];
+  const double* D = &this->basis_dx[0];
+  const double* w = &this->weights_1d[0];
+  double* s = &this->work[0];
+  double* s_d = &this->work_d[0];
+
+  // s_ib = sum_a w_a (l_i(x_a) f_ab + l_i'(x_a) f_dx_ab), s_d_ib = sum_a w_a l_i(x_a) f_dy_ab.
+  for(int i = 0; i < n; i++)
+    for(int b = 0; b < q; b++)
+    {
+      double sum = 0.0, sum_d = 0.0;
+      for(int a = 0; a < q; a++)
+      {
+        double value = 0.0;
+        if(f)
+          value += B[i * q + a] * f[a * q + b];
+        if(f_dx)
+          value += D[i * q + a] * f_dx[a * q + b];
+        sum += w[a] * value;
+        if(f_dy)
+          sum_d += w[a] * B[i * q + a] * f_dy[a * q + b];
+      }
+      s[i * q + b] = sum;
+      s_d[i * q + b] = sum_d;
+    }
+
+  // r_ij = sum_b w_b (s_ib l_j(y_b) + s_d_ib l_j'(y_b)).
+  for(int i = 0; i < n; i++)
+    for(int j = 0; j < n; j++)
+    {
+      double sum = 0.0;
+      for(int b = 0; b < q; b++)
+        sum += w[b] * (s[i * q + b] * B[j * q + b] + s_d[i * q + b] * D[j * q + b]);
+      result[i * n + j] = sum;
+    }
+}
+
+void SumFactorization::evaluate_direct(const double* coefs, double* values, double* dx, double* dy) const
+{
+  int n = this->degree + 1, q = this->num_points;
+  const double* B = &this->basis[0];
+  const double* D = &this->basis_dx[0];
+  for(int a = 0; a < q; a++)
+    for(int b = 0; b < q; b++)
+    {
+      double value = 0.0, value_dx = 0.0, value_dy = 0.0;
+      for(int i = 0; i < n; i++)
+        for(int j = 0; j < n; j++)
+        {
+          value += coefs[i * n + j] * B[i * q + a] * B[j * q + b];
+          value_dx += coefs[i * n + j] * D[i * q + a] * B[j * q + b];
+          value_dy += coefs[i * n + j] * B[i * q + a] * D[j * q + b];
+        }
+      values[a * q + b] = value;
+      if(dx)
+        dx[a * q + b] = value_dx;
+      if(dy)
+        dy[a * q + b] = value_dy;
+    }
+}
+
+void SumFactorization::integrate_direct(const double* f, const double* f_dx, const double* f_dy, double* result) const
+{
+  int n = this->degree + 1, q = this->num_points;
+  const double* B = &this->basis[0];
+  const double* D = &this->basis_dx[0];
+  for(int i = 0; i < n; i++)
+    for(int j = 0; j < n; j++)
+    {
+      double sum = 0.0;
+      for(int a = 0; a < q; a++)
+        for(int b = 0; b < q; b++)
+        {
+          double value = 0.0;
+          if(f)
+            value += f[a * q + b] * B[i * q + a] * B[j * q + b];
+          if(f_dx)
+            value += f_dx[a * q + b] * D[i * q + a] * B[j * q + b];
+          if(f_dy)
+            value += f_dy[a * q + b] * B[i * q + a] * D[j * q + b];
+          sum += this->weights[a * q + b] * value;
+        }
+      result[i * n + j] = sum;
+    }
+}
+
+double SumFactorization::lobatto(int k, double x)
+{
+  if(k == 0)
+    return (1.0 - x) / 2;
+  if(k == 1)
+    return (1.0 + x) / 2;
+  std::vector<double> p(k + 1);
+  legendre(k, x, &p[0]);
+  return (p[k] - p[k - 2]) / std::sqrt(2.0 * (2 * k - 1));
+}
+
+double SumFactorization::lobatto_dx(int k, double x)
+{
+  if(k == 0)
+    return -0.5;
+  if(k == 1)
+    return 0.5;
+  std::vector<double> p(k);
+  legendre(k - 1, x, &p[0]);
+  return std::sqrt((2 * k - 1) / 2.0) * p[k - 1];
+}
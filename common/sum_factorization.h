@@ -0,0 +1,73 @@
+#ifndef __HERMES_TESTING_SUM_FACTORIZATION_H
+#define __HERMES_TESTING_SUM_FACTORIZATION_H
+
+#include <cstddef>
+#include <vector>
+
+/// Sum-factorized evaluation and integration for tensor-product bases on the reference quad (-1, 1)^2.
+///
+/// The basis consists of the products l_i(x) l_j(y), 0 <= i, j <= degree, of the 1D Lobatto functions
+///   l_0 = (1 - x) / 2, l_1 = (1 + x) / 2, l_k = (P_k - P_{k-2}) / sqrt(2 (2k - 1)),
+/// which are the vertex, edge and bubble functions of the H1 shapeset of Hermes on quads (up to
+/// their numbering and the signs of the odd edge functions). The points are the tensor product
+/// of num_points Gauss-Legendre points in each direction.
+///
+/// Evaluating the (p + 1)^2 functions at the q^2 points one by one costs O(p^2 q^2), i.e. O(p^4)
+/// per element. Here the sums over i and j are done one after the other through the 1D tables,
+/// which costs O(p q (p + q)), i.e. O(p^3). The same holds for the integration against all the test
+/// functions (the element residual, or the action of the local matrix in a matrix-free method).
+///
+/// MatrixFreeOperator applies its element operators through evaluate() and integrate(). The direct
+/// versions are kept as the reference of 06-sum-factorization and as the point-by-point element cost
+/// in 08-work-stealing, whose orders (up to 9) are those of the quads of visualization/views.
+///
+/// Layouts: the coefficient of l_i(x) l_j(y) is coefs[i * (degree + 1) + j], the point (x_a, y_b)
+/// has the index a * num_points + b. The derivatives are with respect to the reference coordinates.
+class SumFactorization
+{
+public:
+  SumFactorization(int degree, int num_points);
+
+  int get_degree() const;
+  /// (degree + 1)^2.
+  int get_num_functions() const;
+  /// num_points^2.
+  int get_num_points() const;
+
+  /// Weights of the points (get_num_points() items).
+  const double* get_weights() const;
+  /// Coordinates of the points.
+  void get_point(int index, double& x, double& y) const;
+
+  /// Values (and derivatives if dx, dy are not NULL) at all points of the function with the coefficients.
+  void evaluate(const double* coefs, double* values, double* dx = NULL, double* dy = NULL) const;
+
+  /// result_ij = sum over points of wt * (f l_i l_j + f_dx l_i' l_j + f_dy l_i l_j'),
+  /// i.e. the integrals of the f's against all basis functions and their derivatives.
+  /// Any of f, f_dx, f_dy may be NULL.
+  void integrate(const double* f, const double* f_dx, const double* f_dy, double* result) const;
+
+  /// The same point by point (O(p^4)), for comparison.
+  void evaluate_direct(const double* coefs, double* values, double* dx = NULL, double* dy = NULL) const;
+  void integrate_direct(const double* f, const double* f_dx, const double* f_dy, double* result) const;
+
+  /// 1D Lobatto function l_k and its derivative.
+  static double lobatto(int k, double x);
+  static double lobatto_dx(int k, double x);
+
+private:
+  int degree;
+  int num_points;
+  /// The 1D tables: basis[k * num_points + a] = l_k(x_a).
+  std::vector<double> basis;
+  std::vector<double> basis_dx;
+  std::vector<double> points_1d;
+  std::vector<double> weights_1d;
+  std::vector<double> weights;
+
+  /// Work arrays of (degree + 1) * num_points items.
+  mutable std::vector<double> work;
+  mutable std::vector<double> work_d;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "thread_scaling.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+ThreadScaling::ThreadScaling(const std::string& name) : name(name)
+{
+}
+
+int ThreadScaling::get_num_cores()
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return num_cores > 0 ? (int)num_cores : 1;
+#endif
+}
+
+std::vector<int> ThreadScaling::get_thread_counts(int max_threads)
+{
+  if(max_threads < 1)
+    max_threads = get_num_cores();
+
+  std::vector<int> thread_counts;
+  for(int num_threads = 1; num_threads < max_threads; num_threads *= 2)
+    thread_counts.push_back(num_threads);
+  thread_counts.push_back(max_threads);
+  return thread_counts;
+}
+
+void ThreadScaling::add(int num_threads, const Benchmark& benchmark)
+{
+  this->num_threads.push_back(num_threads);
+  this->medians.push_back(std::map<std::string, double>());
+  for(unsigned int i = 0; i < benchmark.get_phases().size(); i++)
+  {
+    const std::string& phase = benchmark.get_phases()[i];
+    if(std::find(this->phases.begin(), this->phases.end(), phase) == this->phases.end())
+      this->phases.push_back(phase);
+    this->medians.back()[phase] = benchmark.get_statistics(phase).median;
+  }
+}
+
+double ThreadScaling::get_time(int num_threads_index, const std::string& phase) const
+{
+  std::map<std::string, double>::const_iterator it = this->medians[num_threads_index].find(phase);
+  return it == this->medians[num_threads_index].end() ? 0.0 : it->second;
+}
+
+double ThreadScaling::get_speedup(int num_threads_index, const std::string& phase) const
+{
+  double time = this->get_time(num_threads_index, phase);
+  return time > 0.0 ? this->get_time(0, phase) / time : 0.0;
+}
+
+double ThreadScaling::get_efficiency(int num_threads_index, const std::string& phase) const
+{
+  return this->get_speedup(num_threads_index, phase) * this->num_threads[0] / this->num_threads[num_threads_index];
+}
+
+void ThreadScaling::print_summary() const
+{
+  printf("Thread scaling of %s (median times in seconds, speedup, parallel efficiency):\n", this->name.c_str());
+  printf("  %-24s", "phase \\ threads");
+  for(unsigned int j = 0; j < this->num_threads.size(); j++)
+    printf(" %26d", this->num_threads[j]);
+  printf("\n");
+
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+  {
+    printf("  %-24s", this->phases[i].c_str());
+    for(unsigned int j = 0; j < this->num_threads.size(); j++)
+      printf(" %10.6f %6.2fx %6.1f%%", this->get_time(j, this->phases[i]), this->get_speedup(j, this->phases[i]),
+        100.0 * this->get_efficiency(j, this->phases[i]));
+    printf("\n");
+  }
+}
+
+void ThreadScaling::save_csv(const char* filename) const
+{
+  FILE* file = fopen(filename, "w");
+  if(file == NULL)
+    throw Hermes::Exceptions::Exception("Could not open %s for writing.", filename);
+
+  fprintf(file, "benchmark,phase,threads,median,speedup,efficiency\n");
+  for(unsigned int i = 0; i < this->phases.size(); i++)
+    for(unsigned int j = 0; j < this->num_threads.size(); j++)
+      fprintf(file, "%s,%s,%d,%.9g,%.9g,%.9g\n", this->name.c_str(), this->phases[i].c_str(), this->num_threads[j],
+        this->get_time(j, this->phases[i]), this->get_speedup(j, this->phases[i]), this->get_efficiency(j, this->phases[i]));
+
+  fclose(file);
+}
@@ -0,0 +1,44 @@
+#ifndef __HERMES_TESTING_THREAD_SCALING_H
+#define __HERMES_TESTING_THREAD_SCALING_H
+
+#include "benchmark.h"
+
+/// Comparison of benchmarks of one computation run with different numbers of threads.
+///
+/// The speedup of a phase with N threads is the ratio of its median time with the
+/// reference (the first added, typically 1 thread) and with N threads, the parallel
+/// efficiency is the speedup divided by N / reference number of threads.
+class ThreadScaling
+{
+public:
+  ThreadScaling(const std::string& name);
+
+  /// Number of cores available to the process.
+  static int get_num_cores();
+
+  /// Thread counts 1, 2, 4, ... up to max_threads (the number of cores by default),
+  /// max_threads itself is always included.
+  static std::vector<int> get_thread_counts(int max_threads = -1);
+
+  /// Adds the medians of all phases of the benchmark run with num_threads threads.
+  void add(int num_threads, const Benchmark& benchmark);
+
+  double get_speedup(int num_threads_index, const std::string& phase) const;
+  double get_efficiency(int num_threads_index, const std::string& phase) const;
+
+  /// Prints the times, speedups and efficiencies of all phases.
+  void print_summary() const;
+
+  /// One row per (phase, number of threads).
+  void save_csv(const char* filename) const;
+
+private:
+  double get_time(int num_threads_index, const std::string& phase) const;
+
+  std::string name;
+  std::vector<int> num_threads;
+  std::vector<std::string> phases;
+  std::vector<std::map<std::string, double> > medians;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "work_stealing_scheduler.h"
+
+WorkStealingScheduler::WorkStealingScheduler(int num_threads) : num_threads(num_threads), num_steals(0), stealing(true), task(NULL),
+  generation(0), num_running(0), shutdown(false)
+{
+  if(num_threads < 1)
+    throw Hermes::Exceptions::Exception("WorkStealingScheduler: the number of threads has to be positive.");
+
+  this->queues.resize(num_threads);
+  for(int t = 0; t < num_threads; t++)
+    pthread_mutex_init(&this->queues[t].mutex, NULL);
+  pthread_mutex_init(&this->steals_mutex, NULL);
+  pthread_mutex_init(&this->pool_mutex, NULL);
+  pthread_cond_init(&this->start_condition, NULL);
+  pthread_cond_init(&this->done_condition, NULL);
+
+  // The calling thread is the thread 0.
+  this->workers.resize(num_threads);
+  this->threads.resize(num_threads);
+  for(int t = 0; t < num_threads; t++)
+  {
+    this->workers[t].scheduler = this;
+    this->workers[t].thread = t;
+  }
+  for(int t = 1; t < num_threads; t++)
+    pthread_create(&this->threads[t], NULL, work, &this->workers[t]);
+}
+
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+  pthread_mutex_lock(&this->pool_mutex);
+  this->shutdown = true;
+  pthread_cond_broadcast(&this->start_condition);
+  pthread_mutex_unlock(&this->pool_mutex);
+  for(int t = 1; t < this->num_threads; t++)
+    pthread_join(this->threads[t], NULL);
+
+  pthread_cond_destroy(&this->done_condition);
+  pthread_cond_destroy(&this->start_condition);
+  pthread_mutex_destroy(&this->pool_mutex);
+  pthread_mutex_destroy(&this->steals_mutex);
+  for(int t = 0; t < this->num_threads; t++)
+    pthread_mutex_destroy(&this->queues[t].mutex);
+}
+
+int WorkStealingScheduler::get_num_threads() const
+{
+  return this->num_threads;
+}
+
+int WorkStealingScheduler::get_num_steals() const
+{
+  return this->num_steals;
+}
+
+double WorkStealingScheduler::estimate_element_cost(int order, int num_forms, bool triangle)
+{
+  double functions = triangle ? (order + 1) * (order + 2) / 2.0 : (order + 1) * (order + 1);
+  double points = triangle ? (order + 1) * (2 * order + 1) : (order + 1) * (order + 1);
+  return num_forms * functions * functions * points + 100.0;
+}
+
+void WorkStealingScheduler::run(const std::vector<double>& costs, Task& task)
+{
+  int num_items = costs.size();
+  double total = 0.0;
+  for(int i = 0; i < num_items; i++)
+    total += costs[i];
+
+  // Contiguous chunks of about total / num_chunks.
+  int num_chunks = this->num_threads * CHUNKS_PER_THREAD;
+  std::vector<Chunk> chunks;
+  double chunk_cost = total / num_chunks, current = 0.0;
+  Chunk chunk = { 0, 0 };
+  for(int i = 0; i < num_items; i++)
+  {
+    current += costs[i];
+    chunk.end = i + 1;
+    if(current >= chunk_cost || i == num_items - 1)
+    {
+      chunks.push_back(chunk);
+      chunk.begin = i + 1;
+      current = 0.0;
+    }
+  }
+
+  // Every thread gets a contiguous block of the chunks.
+  for(int t = 0; t < this->num_threads; t++)
+    this->queues[t].chunks.clear();
+  for(unsigned int c = 0; c < chunks.size(); c++)
+    this->queues[c * this->num_threads / chunks.size()].chunks.push_back(chunks[c]);
+
+  this->execute(task);
+}
+
+void WorkStealingScheduler::run_static(int num_items, Task& task)
+{
+  for(int t = 0; t < this->num_threads; t++)
+  {
+    this->queues[t].chunks.clear();
+    Chunk chunk = { (int)((long)num_items * t / this->num_threads), (int)((long)num_items * (t + 1) / this->num_threads) };
+    if(chunk.end > chunk.begin)
+      this->queues[t].chunks.push_back(chunk);
+  }
+
+  this->stealing = false;
+  this->execute(task);
+  this->stealing = true;
+}
+
+void WorkStealingScheduler::execute(Task& task)
+{
+  this->num_steals = 0;
+  this->error.clear();
+  this->task = &task;
+
+  pthread_mutex_lock(&this->pool_mutex);
+  this->num_running = this->num_threads - 1;
+  this->generation++;
+  pthread_cond_broadcast(&this->start_condition);
+  pthread_mutex_unlock(&this->pool_mutex);
+
+  this->process(0);
+
+  pthread_mutex_lock(&this->pool_mutex);
+  while(this->num_running > 0)
+    pthread_cond_wait(&this->done_condition, &this->pool_mutex);
+  pthread_mutex_unlock(&this->pool_mutex);
+  this->task = NULL;
+
+  if(!this->error.empty())
+    throw Hermes::Exceptions::Exception("WorkStealingScheduler: %s", this->error.c_str());
+}
+
+void* WorkStealingScheduler::work(void* data)
+{
+  Worker* worker = (Worker*)data;
+  WorkStealingScheduler* scheduler = worker->scheduler;
+  int generation = 0;
+  while(true)
+  {
+    pthread_mutex_lock(&scheduler->pool_mutex);
+    while(scheduler->generation == generation && !scheduler->shutdown)
+      pthread_cond_wait(&scheduler->start_condition, &scheduler->pool_mutex);
+    if(scheduler->shutdown)
+    {
+      pthread_mutex_unlock(&scheduler->pool_mutex);
+      return NULL;
+    }
+    generation = scheduler->generation;
+    pthread_mutex_unlock(&scheduler->pool_mutex);
+
+    scheduler->process(worker->thread);
+
+    pthread_mutex_lock(&scheduler->pool_mutex);
+    if(--scheduler->num_running == 0)
+      pthread_cond_signal(&scheduler->done_condition);
+    pthread_mutex_unlock(&scheduler->pool_mutex);
+  }
+}
+
+void WorkStealingScheduler::process(int thread)
+{
+  // Reported after all threads finish; the chunks left in the queues are processed by the others.
+  std::string message;
+  Chunk chunk;
+  try
+  {
+    while(this->pop(thread, chunk) || this->steal(thread, chunk))
+      for(int item = chunk.begin; item < chunk.end; item++)
+        this->task->execute(item, thread);
+  }
+  catch(Hermes::Exceptions::Exception& e)
+  {
+    message = e.what();
+  }
+  catch(std::exception& e)
+  {
+    message = e.what();
+  }
+  catch(...)
+  {
+    message = "an unknown exception in a task.";
+  }
+  if(!message.empty())
+  {
+    pthread_mutex_lock(&this->steals_mutex);
+    this->error = message;
+    pthread_mutex_unlock(&this->steals_mutex);
+  }
+}
+
+bool WorkStealingScheduler::pop(int thread, Chunk& chunk)
+{
+  Queue& queue = this->queues[thread];
+  pthread_mutex_lock(&queue.mutex);
+  bool found = !queue.chunks.empty();
+  if(found)
+  {
+    chunk = queue.chunks.front();
+    queue.chunks.pop_front();
+  }
+  pthread_mutex_unlock(&queue.mutex);
+  return found;
+}
+
+bool WorkStealingScheduler::steal(int thread, Chunk& chunk)
+{
+  // No work is added during a run, so all queues empty means the end.
+  if(!this->stealing)
+    return false;
+  for(int i = 1; i < this->num_threads; i++)
+  {
+    Queue& queue = this->queues[(thread + i) % this->num_threads];
+    pthread_mutex_lock(&queue.mutex);
+    bool found = !queue.chunks.empty();
+    if(found)
+    {
+      chunk = queue.chunks.back();
+      queue.chunks.pop_back();
+    }
+    pthread_mutex_unlock(&queue.mutex);
+    if(found)
+    {
+      pthread_mutex_lock(&this->steals_mutex);
+      this->num_steals++;
+      pthread_mutex_unlock(&this->steals_mutex);
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,116 @@
+#ifndef __HERMES_TESTING_WORK_STEALING_SCHEDULER_H
+#define __HERMES_TESTING_WORK_STEALING_SCHEDULER_H
+
+#include "hermes_common.h"
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include <string>
+
+/// Runs the items 0, ..., n - 1 (elements to assemble, project, estimate the error on, ...) on several
+/// threads, with chunks weighted by the estimated costs of the items and work stealing.
+///
+/// The items are split into contiguous chunks of about the same estimated cost (CHUNKS_PER_THREAD per
+/// thread), every thread starts with a contiguous block of chunks of about the same total cost and
+/// processes it from the front. A thread which runs out of work steals the chunks from the back of
+/// the other threads, which makes up for the errors of the estimates. On hp meshes the cost of an
+/// element grows like p^6 (see estimate_element_cost()), so the static partitions into equal numbers
+/// of elements leave the threads with the low orders idle.
+///
+/// The threads 1, ..., num_threads - 1 are created by the constructor and wait for the runs until the
+/// scheduler is deleted, the thread 0 is the calling one. So the thread of a given number is the same in
+/// all runs and the per-thread data (ElementArena::get_thread_arena(), caches) survive between them.
+/// An exception thrown by Task::execute() is rethrown by run() as Hermes::Exceptions::Exception.
+///
+/// Typical usage:
+///   class AssemblyTask : public WorkStealingScheduler::Task
+///   {
+///     void execute(int item, int thread) { ... element item, with the data of the thread ... }
+///   };
+///   WorkStealingScheduler scheduler(num_threads);
+///   scheduler.run(costs, task);
+class WorkStealingScheduler
+{
+public:
+  class Task
+  {
+  public:
+    virtual ~Task() {}
+    /// Processes one item, thread is in 0, ..., num_threads - 1. Called concurrently.
+    virtual void execute(int item, int thread) = 0;
+  };
+
+  WorkStealingScheduler(int num_threads);
+  ~WorkStealingScheduler();
+
+  int get_num_threads() const;
+
+  /// Processes all items, costs[i] is the estimated cost of the item i.
+  void run(const std::vector<double>& costs, Task& task);
+
+  /// Processes all items by the static partition into equal numbers of items per thread, for comparison.
+  void run_static(int num_items, Task& task);
+
+  /// Number of chunks stolen in the last run.
+  int get_num_steals() const;
+
+  /// Estimated cost of the local matrix of an element of the given order: the pairs of shape functions
+  /// times the quadrature points (of order 2 * order) times the number of forms, plus the overhead of
+  /// the element (reference map, assembly list).
+  static double estimate_element_cost(int order, int num_forms = 1, bool triangle = false);
+
+  /// Number of chunks per thread in run().
+  static const int CHUNKS_PER_THREAD = 16;
+
+private:
+  struct Chunk
+  {
+    int begin, end;
+  };
+
+  struct Queue
+  {
+    std::deque<Chunk> chunks;
+    pthread_mutex_t mutex;
+  };
+
+  struct Worker
+  {
+    WorkStealingScheduler* scheduler;
+    int thread;
+  };
+
+  WorkStealingScheduler(const WorkStealingScheduler&);
+  WorkStealingScheduler& operator=(const WorkStealingScheduler&);
+
+  /// The loop of the threads of the pool.
+  static void* work(void* worker);
+  /// Processes the chunks of one run by the given thread.
+  void process(int thread);
+  bool pop(int thread, Chunk& chunk);
+  bool steal(int thread, Chunk& chunk);
+  void execute(Task& task);
+
+  int num_threads;
+  /// One per thread, the mutexes are initialized once.
+  std::vector<Queue> queues;
+  int num_steals;
+  /// False in run_static().
+  bool stealing;
+  pthread_mutex_t steals_mutex;
+  std::string error;
+
+  /// The pool: the threads 1, ..., num_threads - 1 start a run when generation changes.
+  std::vector<pthread_t> threads;
+  std::vector<Worker> workers;
+  Task* task;
+  pthread_mutex_t pool_mutex;
+  pthread_cond_t start_condition;
+  pthread_cond_t done_condition;
+  int generation;
+  /// Threads of the pool still processing the current run.
+  int num_running;
+  bool shutdown;
+};
+
+#endif
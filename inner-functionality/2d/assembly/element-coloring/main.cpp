@@ -0,0 +1,133 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "element_coloring.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+// This test colors the active elements of two H1 spaces on one mesh (the one of reference-element-matrices)
+// by ElementColoring::update() and checks that
+//
+//   - every active element has a color and no two elements of one color share a DOF of either space,
+//   - the coloring is cached: another update() without a change of the spaces does not recompute it,
+//   - the coloring is recomputed after assign_dofs(), both after a refinement and after a change of the orders.
+
+const int INIT_REF_NUM = 2;                 // Number of initial uniform mesh refinements.
+const int P_INIT_1 = 2;                     // Polynomial degrees of the spaces.
+const int P_INIT_2 = 1;
+const int P_CHANGED = 4;                    // Polynomial degree of the first space after the change.
+
+// Checks the coloring against the assembly lists of the spaces.
+bool check(const char* stage, Mesh* mesh, const Hermes::vector<const Space<double>*>& spaces, const ElementColoring& coloring)
+{
+  bool success = true;
+
+  // The element of each color seen at each DOF of each space. The DOFs of the spaces are numbered
+  // independently here, so they are shifted by the numbers of DOFs of the preceding spaces.
+  std::vector<int> offsets(spaces.size(), 0);
+  for(unsigned int i = 1; i < spaces.size(); i++)
+    offsets[i] = offsets[i - 1] + spaces[i - 1]->get_num_dofs();
+  std::map<std::pair<int, int>, int> owners;
+  int num_elements = 0;
+  AsmList<double> al;
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    num_elements++;
+    int color = coloring.get_color(e->id);
+    if(color < 0)
+    {
+      printf("%s: the element %d has no color.\n", stage, e->id);
+      success = false;
+      continue;
+    }
+    for(unsigned int i = 0; i < spaces.size(); i++)
+    {
+      spaces[i]->get_element_assembly_list(e, &al);
+      for(int k = 0; k < al.cnt; k++)
+      {
+        if(al.dof[k] < 0)
+          continue;
+        std::pair<int, int> key(al.dof[k] + offsets[i], color);
+        std::map<std::pair<int, int>, int>::iterator it = owners.find(key);
+        if(it != owners.end() && it->second != e->id)
+        {
+          printf("%s: the elements %d and %d of the color %d share the DOF %d of the space %d.\n", stage,
+            it->second, e->id, color, al.dof[k], i);
+          success = false;
+        }
+        owners[key] = e->id;
+      }
+    }
+  }
+
+  // Every element is in exactly one list.
+  int num_colored = 0;
+  for(int color = 0; color < coloring.get_num_colors(); color++)
+    num_colored += coloring.get_elements(color).size();
+  if(num_colored != num_elements)
+  {
+    printf("%s: %d elements in the colors, %d active elements.\n", stage, num_colored, num_elements);
+    success = false;
+  }
+
+  printf("%s: %d elements, %d colors.\n", stage, num_elements, coloring.get_num_colors());
+  return success;
+}
+
+bool expect_update(const char* stage, ElementColoring& coloring, const Hermes::vector<const Space<double>*>& spaces, bool expected)
+{
+  if(coloring.update(spaces) != expected)
+  {
+    printf("%s: the coloring was %s.\n", stage, expected ? "not recomputed" : "recomputed");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  H1Space<double> space_1(&mesh, P_INIT_1);
+  H1Space<double> space_2(&mesh, P_INIT_2);
+  Hermes::vector<const Space<double>*> spaces(&space_1, &space_2);
+
+  bool success = true;
+  ElementColoring coloring;
+  success = expect_update("initial", coloring, spaces, true) && success;
+  success = check("initial", &mesh, spaces, coloring) && success;
+  success = expect_update("unchanged", coloring, spaces, false) && success;
+
+  // A refinement of one element.
+  mesh.refine_element_id(0);
+  space_1.assign_dofs();
+  space_2.assign_dofs();
+  success = expect_update("refinement", coloring, spaces, true) && success;
+  success = check("refinement", &mesh, spaces, coloring) && success;
+  success = expect_update("refinement, unchanged", coloring, spaces, false) && success;
+
+  // A change of the orders.
+  space_1.set_uniform_order(P_CHANGED);
+  space_1.assign_dofs();
+  success = expect_update("orders", coloring, spaces, true) && success;
+  success = check("orders", &mesh, spaces, coloring) && success;
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
@@ -0,0 +1,202 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "benchmark.h"
+#include "element_value_cache.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+// This test assembles the matrix of the form diffusion * grad u . grad v + mass * u v from the values
+// of ElementValueCache in NUM_ITERATIONS iterations (as in a Newton loop, where the mesh and the orders
+// stay the same) and compares it with the matrix assembled by Hermes, for polynomial degrees 1 ... P_MAX.
+//
+// The mesh (the one of reference-element-matrices) contains a triangle and a skewed parallelogram
+// (marker "Affine"), where the cached points integrate the form exactly, and a trapezoid (marker
+// "General"), where the sum of the cached weights is checked against the area of the elements.
+// The test also checks that the values are computed only in the first iteration, that a change
+// of the orders clears the cache, that a small memory cap evicts elements without changing
+// the matrix and that elements larger than the cap are not cached.
+
+const int INIT_REF_NUM = 2;                 // Number of initial uniform mesh refinements.
+const int P_MAX = 6;                        // Maximum polynomial degree.
+const int NUM_ITERATIONS = 4;               // Number of assemblies with the same space.
+const double DIFFUSION = 3.5;
+const double MASS = 0.25;
+const double TOLERANCE = 1e-10;             // Maximum difference relative to the largest entry.
+
+class CustomWeakForm : public WeakForm<double>
+{
+public:
+  CustomWeakForm(std::string area) : WeakForm<double>(1)
+  {
+    add_matrix_form(new WeakFormsH1::DefaultJacobianDiffusion<double>(0, 0, area, new Hermes1DFunction<double>(DIFFUSION), HERMES_SYM));
+    add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<double>(0, 0, area, new Hermes2DFunction<double>(MASS), HERMES_SYM));
+  }
+};
+
+// Assembles the form on the elements with the marker "Affine" from the cache into the dense matrix,
+// returns false if the weights of any element do not sum to its area.
+bool assemble(Mesh* mesh, H1Space<double>* space, ElementValueCache& cache, std::vector<double>& assembled)
+{
+  int ndof = space->get_num_dofs();
+  int affine_marker = mesh->get_element_markers_conversion().get_internal_marker("Affine").marker;
+  assembled.assign(ndof * ndof, 0.0);
+  bool areas = true;
+  AsmList<double> al;
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    space->get_element_assembly_list(e, &al);
+    const ElementValueCache::Values* values = cache.get(e, &al);
+
+    // Shoelace formula.
+    double area = 0.0, sum = 0.0;
+    for(int i = 0; i < e->get_nvert(); i++)
+      area += e->vn[i]->x * e->vn[(i + 1) % e->get_nvert()]->y - e->vn[(i + 1) % e->get_nvert()]->x * e->vn[i]->y;
+    for(int k = 0; k < values->num_points; k++)
+      sum += values->wt[k];
+    if(std::abs(sum - area / 2) > TOLERANCE * area)
+      areas = false;
+
+    if(e->marker != affine_marker)
+      continue;
+    int n = values->num_points;
+    for(unsigned int i = 0; i < al.cnt; i++)
+      for(unsigned int j = 0; j < al.cnt; j++)
+      {
+        if(al.dof[i] < 0 || al.dof[j] < 0)
+          continue;
+        double value = 0.0;
+        for(int k = 0; k < n; k++)
+          value += values->wt[k] * (DIFFUSION * (values->dx[j * n + k] * values->dx[i * n + k] + values->dy[j * n + k] * values->dy[i * n + k])
+            + MASS * values->fn[j * n + k] * values->fn[i * n + k]);
+        assembled[al.dof[i] * ndof + al.dof[j]] += value * al.coef[i] * al.coef[j];
+      }
+  }
+  return areas;
+}
+
+double max_difference(SparseMatrix<double>* matrix, const std::vector<double>& assembled, int ndof)
+{
+  double max_entry = 0.0, difference = 0.0;
+  for(int i = 0; i < ndof; i++)
+    for(int j = 0; j < ndof; j++)
+    {
+      double value = matrix->get(i, j);
+      max_entry = std::max(max_entry, std::abs(value));
+      difference = std::max(difference, std::abs(value - assembled[i * ndof + j]));
+    }
+  return difference / max_entry;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+  int num_elements = mesh.get_num_active_elements();
+
+  CustomWeakForm wf("Affine");
+  H1Space<double> space(&mesh, 1);
+  ElementValueCache cache(space.get_shapeset());
+
+  bool success = true;
+  for(int p = 1; p <= P_MAX; p++)
+  {
+    space.set_uniform_order(p);
+    space.assign_dofs();
+    int ndof = space.get_num_dofs();
+
+    DiscreteProblem<double> dp(&wf, &space);
+    SparseMatrix<double>* matrix = create_matrix<double>();
+    dp.assemble(matrix);
+
+    if(!cache.update(&space))
+    {
+      printf("p = %d: the cache was not cleared after the change of the orders.\n", p);
+      success = false;
+    }
+
+    Benchmark benchmark("element-value-cache");
+    std::vector<double> assembled;
+    int misses = cache.get_misses();
+    for(int iteration = 0; iteration < NUM_ITERATIONS; iteration++)
+    {
+      benchmark.begin_run();
+      cache.update(&space);
+      if(!assemble(&mesh, &space, cache, assembled))
+      {
+        printf("p = %d: the weights do not sum to the areas of the elements.\n", p);
+        success = false;
+      }
+      benchmark.tick(iteration == 0 ? "first iteration" : "next iterations");
+    }
+    double difference = max_difference(matrix, assembled, ndof);
+    if(difference > TOLERANCE)
+    {
+      printf("p = %d: the matrix differs by %g.\n", p, difference);
+      success = false;
+    }
+    if(cache.get_misses() - misses != num_elements)
+    {
+      printf("p = %d: %d elements computed instead of %d.\n", p, cache.get_misses() - misses, num_elements);
+      success = false;
+    }
+
+    printf("p = %d, ndof = %d, cached %d elements (%g kB), difference = %g, first iteration %g s, next iterations %g s.\n",
+      p, ndof, cache.get_num_cached(), cache.get_memory() / 1024.0, difference,
+      benchmark.get_statistics("first iteration").median, benchmark.get_statistics("next iterations").median);
+
+    // With the memory of half of the elements, some are evicted and computed again.
+    size_t memory = cache.get_memory();
+    int evictions = cache.get_evictions();
+    cache.set_memory_cap(memory / 2);
+    assemble(&mesh, &space, cache, assembled);
+    cache.set_memory_cap(ElementValueCache::DEFAULT_MEMORY_CAP);
+    if(cache.get_evictions() == evictions || cache.get_memory() > memory / 2)
+    {
+      printf("p = %d: the memory cap was not kept.\n", p);
+      success = false;
+    }
+    if(max_difference(matrix, assembled, ndof) > TOLERANCE)
+    {
+      printf("p = %d: the matrix with evictions differs.\n", p);
+      success = false;
+    }
+
+    // With a cap below the size of any element, nothing is cached and nothing is evicted.
+    cache.clear();
+    evictions = cache.get_evictions();
+    cache.set_memory_cap(1);
+    assemble(&mesh, &space, cache, assembled);
+    cache.set_memory_cap(ElementValueCache::DEFAULT_MEMORY_CAP);
+    if(cache.get_num_cached() != 0 || cache.get_evictions() != evictions)
+    {
+      printf("p = %d: elements larger than the cap were cached.\n", p);
+      success = false;
+    }
+    if(max_difference(matrix, assembled, ndof) > TOLERANCE)
+    {
+      printf("p = %d: the matrix without caching differs.\n", p);
+      success = false;
+    }
+
+    delete matrix;
+  }
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
@@ -0,0 +1,159 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "benchmark.h"
+#include "reference_element_matrices.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+// This test compares the matrix of the form diffusion * grad u . grad v + mass * u v assembled
+// from the cached reference matrices (ReferenceElementMatrices) with the one assembled by
+// the quadrature of Hermes, for polynomial degrees 1 ... P_MAX.
+//
+// The mesh contains a triangle and a skewed parallelogram (marker "Affine") and a trapezoid
+// (marker "General"), the elements which are not affine are assembled by Hermes as a fallback.
+//
+// The local matrices of the affine elements are computed a second time, from the cached blocks
+// only, which has to be faster than the quadrature of all elements.
+
+const int INIT_REF_NUM = 2;                 // Number of initial uniform mesh refinements.
+const int P_MAX = 6;                        // Maximum polynomial degree.
+const double DIFFUSION = 3.5;
+const double MASS = 0.25;
+const double TOLERANCE = 1e-10;             // Maximum difference relative to the largest entry.
+
+class CustomWeakForm : public WeakForm<double>
+{
+public:
+  CustomWeakForm(std::string area) : WeakForm<double>(1)
+  {
+    add_matrix_form(new WeakFormsH1::DefaultJacobianDiffusion<double>(0, 0, area, new Hermes1DFunction<double>(DIFFUSION), HERMES_SYM));
+    add_matrix_form(new WeakFormsH1::DefaultMatrixFormVol<double>(0, 0, area, new Hermes2DFunction<double>(MASS), HERMES_SYM));
+  }
+};
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  CustomWeakForm wf(HERMES_ANY);
+  CustomWeakForm wf_general("General");
+
+  bool success = true;
+  for(int p = 1; p <= P_MAX; p++)
+  {
+    H1Space<double> space(&mesh, p);
+    int ndof = space.get_num_dofs();
+    Benchmark benchmark("reference-element-matrices");
+    benchmark.begin_run();
+
+    // Reference: quadrature on all elements.
+    DiscreteProblem<double> dp(&wf, &space);
+    SparseMatrix<double>* matrix = create_matrix<double>();
+    dp.assemble(matrix);
+    benchmark.tick("quadrature");
+
+    // Quadrature on the elements which are not affine, the reference matrices on the rest.
+    DiscreteProblem<double> dp_general(&wf_general, &space);
+    SparseMatrix<double>* matrix_general = create_matrix<double>();
+    dp_general.assemble(matrix_general);
+
+    std::vector<double> assembled(ndof * ndof, 0.0);
+    ReferenceElementMatrices reference_matrices(space.get_shapeset());
+    AsmList<double> al;
+    std::vector<double> local;
+    int num_affine = 0, num_general = 0;
+    Element* e;
+    for_all_active_elements(e, &mesh)
+    {
+      space.get_element_assembly_list(e, &al);
+      local.resize(al.cnt * al.cnt);
+      if(!reference_matrices.get_local_matrix(e, &al, DIFFUSION, MASS, &local[0]))
+      {
+        num_general++;
+        continue;
+      }
+      num_affine++;
+      for(unsigned int i = 0; i < al.cnt; i++)
+        for(unsigned int j = 0; j < al.cnt; j++)
+          if(al.dof[i] >= 0 && al.dof[j] >= 0)
+            assembled[al.dof[i] * ndof + al.dof[j]] += local[i * al.cnt + j];
+    }
+    // Including the calculation of the cached reference integrals.
+    benchmark.tick("reference matrices");
+
+    // The same with all blocks cached.
+    std::vector<double> assembled_cached(ndof * ndof, 0.0);
+    benchmark.skip();
+    for_all_active_elements(e, &mesh)
+    {
+      space.get_element_assembly_list(e, &al);
+      local.resize(al.cnt * al.cnt);
+      if(!reference_matrices.get_local_matrix(e, &al, DIFFUSION, MASS, &local[0]))
+        continue;
+      for(unsigned int i = 0; i < al.cnt; i++)
+        for(unsigned int j = 0; j < al.cnt; j++)
+          if(al.dof[i] >= 0 && al.dof[j] >= 0)
+            assembled_cached[al.dof[i] * ndof + al.dof[j]] += local[i * al.cnt + j];
+    }
+    benchmark.tick("cached");
+    if(assembled_cached != assembled)
+    {
+      printf("p = %d: the matrix assembled from the cached blocks differs.\n", p);
+      success = false;
+    }
+    if(benchmark.get_current("cached") >= benchmark.get_current("quadrature"))
+    {
+      printf("p = %d: the cached reference matrices (%g s) are not faster than the quadrature (%g s).\n", p,
+        benchmark.get_current("cached"), benchmark.get_current("quadrature"));
+      success = false;
+    }
+
+    for(int i = 0; i < ndof; i++)
+      for(int j = 0; j < ndof; j++)
+        assembled[i * ndof + j] += matrix_general->get(i, j);
+
+    // The trapezoid and its sons are the only elements left to the quadrature.
+    if(num_general != (1 << (2 * INIT_REF_NUM)))
+    {
+      printf("p = %d: %d elements not affine instead of %d.\n", p, num_general, 1 << (2 * INIT_REF_NUM));
+      success = false;
+    }
+
+    double max_entry = 0.0, max_difference = 0.0;
+    for(int i = 0; i < ndof; i++)
+      for(int j = 0; j < ndof; j++)
+      {
+        double value = matrix->get(i, j);
+        max_entry = std::max(max_entry, std::abs(value));
+        max_difference = std::max(max_difference, std::abs(value - assembled[i * ndof + j]));
+      }
+
+    printf("p = %d, ndof = %d, affine elements = %d, cached pairs = %d, blocks = %d, difference = %g, quadrature %g s, reference matrices %g s, cached %g s.\n",
+      p, ndof, num_affine, reference_matrices.get_num_cached(), reference_matrices.get_num_blocks(), max_difference / max_entry,
+      benchmark.get_current("quadrature"), benchmark.get_current("reference matrices"), benchmark.get_current("cached"));
+    if(max_difference > TOLERANCE * max_entry)
+      success = false;
+
+    delete matrix;
+    delete matrix_general;
+  }
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
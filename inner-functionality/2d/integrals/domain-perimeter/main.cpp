@@ -3,6 +3,8 @@
 #define HERMES_REPORT_FILE "application.log"
 #define PI 4.0*atan(1.0)
 #include "hermes2d.h"
+#include "integration_kernels.h"
+#include "functional_evaluator.h"
 
 #include <iostream>
 
@@ -22,51 +24,76 @@ using std::endl;
 //  To add more domains to test, edit the CMakeLists.txt file. Note: The
 //  boundary markers must be 1, 2, 3, or 4, others will be skipped.
 
+//  The lengths of the boundaries are evaluated in one pass by FunctionalEvaluator
+//  (one perimeter functional per marker, with NUM_THREADS threads) and checked
+//  against the scan over all active elements, also after a further refinement
+//  (which has to rebuild the marker index of the evaluator).
+
 //******************************************************************************
 // Controls
 //
 //  The following parameters can be changed:
 
-const int P_INIT = 1;       // Initial polynomial degree of all mesh elements.
 const int INIT_REF_NUM = 2; // Number of initial uniform mesh refinements.
+const int NUM_THREADS = 4;  // Number of threads of FunctionalEvaluator.
 
 //******************************************************************************
 // Helper functions
 
 //------------------------------------------------------------------------------
-// Compute marked boundary length
+// Length of one boundary edge
+//
+double CalculateEdgeLength(RefMap& rm, Element* e, int edge)
+{
+  Quad2D * quad = rm.get_quad_2d();
+  rm.set_active_element(e);
+  int points_location = quad->get_edge_points(edge, quad->get_max_order(e->get_mode()), e->get_mode());
+  double3* points = quad->get_points(points_location, e->get_mode());
+  int np = quad->get_num_points(points_location, e->get_mode());
+  double3* tangents = rm.get_tangent(edge, points_location);
+  double length = 0;
+  for(int i = 0; i < np; i++) {
+    // Weights sum up to two on every edge, therefore the division by two must be present.
+    length +=  0.5 * points[i][2] * tangents[i][2];
+  }
+  return length;
+} // end of CalculateEdgeLength()
+
+//------------------------------------------------------------------------------
+// Length of the boundary edges with the marker (a functional without solutions)
 //
-double CalculateBoundaryLength(Mesh* mesh, int bdryMarker)
+class Perimeter : public Functional
+{
+public:
+  Perimeter(std::string bdryMarker) : Functional(Hermes::vector<std::string>(), Hermes::vector<std::string>(bdryMarker)) {}
+
+  double surface(const FunctionalValues& values) const
+  {
+    return values.kernels.u_v(values.n, values.wt, values.one, values.one);
+  }
+}; // end of Perimeter
+
+//------------------------------------------------------------------------------
+// Compute marked boundary length by the scan over all active elements
+//
+double CalculateBoundaryLengthScan(Mesh* mesh, int bdryMarker)
 {
   // Variables declaration.
   Element* e;
   double length = 0;
   RefMap rm;
   rm.set_quad_2d(&g_quad_2d_std);
-  Quad2D * quad = rm.get_quad_2d();
-  int points_location;
-  double3* points;
-  int np;
-  double3* tangents;
 
   // Loop through all boundary faces of all active elements.
   for_all_active_elements(e, mesh) {
     for(int edge = 0; edge < e->get_nvert(); ++edge) {
       if((e->en[edge]->bnd) && (e->en[edge]->marker == bdryMarker)) {
-        rm.set_active_element(e);
-        points_location = quad->get_edge_points(edge, quad->get_max_order(e->get_mode()), e->get_mode());
-        points = quad->get_points(points_location, e->get_mode());
-        np = quad->get_num_points(points_location, e->get_mode());
-        tangents = rm.get_tangent(edge, points_location);
-        for(int i = 0; i < np; i++) {
-          // Weights sum up to two on every edge, therefore the division by two must be present.
-          length +=  0.5 * points[i][2] * tangents[i][2];
-        }
+        length += CalculateEdgeLength(rm, e, edge);
       }
     }
   }
   return length;
-} // end of CalculateBoundaryLength()
+} // end of CalculateBoundaryLengthScan()
 
 //******************************************************************************
 // Main
@@ -99,29 +126,39 @@ int main(int argc, char* argv[])
   // Perform initial mesh refinements.
   for (int i = 0; i<INIT_REF_NUM; i++) mesh.refine_all_elements();
 
-  // Create H1 space with a default shapeset.
-  H1Space<double> space(&mesh, P_INIT);
-
-  // FIXME: This Solution is artificial here and it should be removed. The
-  // function CalculateBoundaryLength() should only take a pointer to Mesh and
-  // a boundary marker as parameters.
-  //Solution sln;
-  //sln.set_zero(&mesh);
-
-  // Calculate the length of the four boundaries segments.
-  double l1 = CalculateBoundaryLength(&mesh, 1);
-
-  double l2 = CalculateBoundaryLength(&mesh, 2);
+  // The perimeter functionals of the four boundary segments (those present in the mesh),
+  // evaluated at the highest order of the edge quadrature.
+  std::vector<int> markers;
+  std::vector<Perimeter*> perimeters;
+  FunctionalEvaluator evaluator(&mesh, Hermes::vector<MeshFunction<double>*>(), g_quad_2d_std.get_max_order(HERMES_MODE_QUAD));
+  for (int marker = 1; marker <= 4; marker++) {
+    Mesh::MarkersConversion::StringValid userMarker = mesh.get_boundary_markers_conversion().get_user_marker(marker);
+    if (!userMarker.valid) continue;
+    markers.push_back(marker);
+    perimeters.push_back(new Perimeter(userMarker.marker));
+    evaluator.add(perimeters.back());
+  }
 
-  double l3 = CalculateBoundaryLength(&mesh, 3);
+  bool success = true;
+  for (int refinement = 0; refinement < 2; refinement++) {
+    if (refinement > 0) mesh.refine_all_elements();
 
-  double l4 = CalculateBoundaryLength(&mesh, 4);
+    // Calculate the length of the four boundaries segments.
+    std::vector<double> lengths = evaluator.evaluate(NUM_THREADS);
+    double perimeter = 0;
+    for (unsigned int i = 0; i < markers.size(); i++) {
+      if (fabs(lengths[i] - CalculateBoundaryLengthScan(&mesh, markers[i])) > 1e-12) success = false;
+      perimeter += lengths[i];
+    }
 
-  double perimeter = l1 + l2 + l3 + l4;
+    // Set exact value from CMakeLists.txt file
+    if (fabs(perimeter - bdryLengthInput) >= 1e-6) success = false;
+  }
 
-  // Set exact value from CMakeLists.txt file
+  for (unsigned int i = 0; i < perimeters.size(); i++)
+    delete perimeters[i];
 
-  if(fabs(perimeter - bdryLengthInput) < 1e-6) {
+  if(success) {
     printf("Success!\n");
     return 0;
   }
@@ -0,0 +1,167 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "benchmark.h"
+#include "integration_kernels.h"
+#include "functional_evaluator.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+// This test evaluates several volume and surface functionals of u = x^2 + 3xy on the square (-1, 1)^2
+// (boundary markers 1 - 4, see domain.mesh) in one pass of FunctionalEvaluator, with 1 and NUM_THREADS
+// threads, for u given as an exact function and as its projection to the H1 space of degree 2:
+//
+//   - the area (4) and the integral of u (4 / 3),
+//   - the perimeter (8),
+//   - the flux of grad u through the whole boundary (the integral of the Laplacian, 8) and
+//     through the boundary 4 (x = 1, 4), also with the marker 4 given twice (still 4).
+
+const int INIT_REF_NUM = 4;                 // Number of initial uniform mesh refinements.
+const int NUM_THREADS = 4;
+const double TOLERANCE = 1e-10;
+
+class CustomExactSolution : public ExactSolutionScalar<double>
+{
+public:
+  CustomExactSolution(Mesh* mesh) : ExactSolutionScalar<double>(mesh) {};
+
+  virtual double value(double x, double y) const
+  {
+    return x * x + 3 * x * y;
+  }
+
+  virtual void derivatives(double x, double y, double& dx, double& dy) const
+  {
+    dx = 2 * x + 3 * y;
+    dy = 3 * x;
+  }
+
+  virtual Ord ord(Ord x, Ord y) const
+  {
+    return x * x + 3 * x * y;
+  }
+
+  // The clones share the mesh.
+  MeshFunction<double>* clone() const
+  {
+    return new CustomExactSolution(this->mesh);
+  }
+};
+
+class Area : public Functional
+{
+public:
+  Area() : Functional(Hermes::vector<std::string>(HERMES_ANY), Hermes::vector<std::string>()) {}
+
+  double volume(const FunctionalValues& values) const
+  {
+    return values.kernels.u_v(values.n, values.wt, values.one, values.one);
+  }
+};
+
+class Integral : public Functional
+{
+public:
+  Integral() : Functional(Hermes::vector<std::string>(HERMES_ANY), Hermes::vector<std::string>()) {}
+
+  double volume(const FunctionalValues& values) const
+  {
+    return values.kernels.u_v(values.n, values.wt, values.val[0], values.one);
+  }
+};
+
+class Perimeter : public Functional
+{
+public:
+  Perimeter() : Functional(Hermes::vector<std::string>(), Hermes::vector<std::string>(HERMES_ANY)) {}
+
+  double surface(const FunctionalValues& values) const
+  {
+    return values.kernels.u_v(values.n, values.wt, values.one, values.one);
+  }
+};
+
+class Flux : public Functional
+{
+public:
+  Flux(const Hermes::vector<std::string>& boundaries) : Functional(Hermes::vector<std::string>(), boundaries) {}
+
+  double surface(const FunctionalValues& values) const
+  {
+    return values.kernels.grad_u_grad_v(values.n, values.wt, values.dx[0], values.dy[0], values.nx, values.ny);
+  }
+};
+
+bool check(const char* name, FunctionalEvaluator& evaluator, const std::vector<double>& exact)
+{
+  bool success = true;
+  Benchmark benchmark("functionals");
+  benchmark.begin_run();
+  std::vector<double> results_serial = evaluator.evaluate(1);
+  benchmark.tick("1 thread");
+  std::vector<double> results_parallel = evaluator.evaluate(NUM_THREADS);
+  benchmark.tick("threads");
+
+  for(unsigned int f = 0; f < exact.size(); f++)
+    if(std::abs(results_serial[f] - exact[f]) > TOLERANCE || std::abs(results_parallel[f] - exact[f]) > TOLERANCE)
+    {
+      printf("%s, functional %d: %.12g (1 thread), %.12g (%d threads) instead of %g.\n", name, f, results_serial[f],
+        results_parallel[f], NUM_THREADS, exact[f]);
+      success = false;
+    }
+  printf("%s: %d functionals, 1 thread %g s, %d threads %g s.\n", name, (int)exact.size(), benchmark.get_current("1 thread"),
+    NUM_THREADS, benchmark.get_current("threads"));
+  return success;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  CustomExactSolution exact_solution(&mesh);
+  H1Space<double> space(&mesh, 2);
+  Solution<double> sln;
+  OGProjection<double> ogProjection; ogProjection.project_global(&space, &exact_solution, &sln);
+
+  Area area;
+  Integral integral;
+  Perimeter perimeter;
+  Flux flux(Hermes::vector<std::string>(HERMES_ANY)), flux_4(Hermes::vector<std::string>("4")),
+    flux_4_twice(Hermes::vector<std::string>("4", "4"));
+  double exact_values[] = { 4.0, 4.0 / 3.0, 8.0, 8.0, 4.0, 4.0 };
+  std::vector<double> exact(exact_values, exact_values + 6);
+
+  bool success = true;
+  FunctionalEvaluator evaluator_exact(&mesh, Hermes::vector<MeshFunction<double>*>(&exact_solution));
+  FunctionalEvaluator evaluator_sln(&mesh, Hermes::vector<MeshFunction<double>*>(&sln));
+  FunctionalEvaluator* evaluators[] = { &evaluator_exact, &evaluator_sln };
+  const char* names[] = { "exact", "projection" };
+  for(int i = 0; i < 2; i++)
+  {
+    evaluators[i]->add(&area);
+    evaluators[i]->add(&integral);
+    evaluators[i]->add(&perimeter);
+    evaluators[i]->add(&flux);
+    evaluators[i]->add(&flux_4);
+    evaluators[i]->add(&flux_4_twice);
+    success = check(names[i], *evaluators[i], exact) && success;
+  }
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
@@ -0,0 +1,118 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "benchmark.h"
+#include "marker_index.h"
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+// This test computes the area of every material of a mesh with NUM_MATERIALS materials (one unit
+// square each) by visiting all elements and checking the marker for every material (as the
+// traversal does for the forms restricted to an area) and from the element lists of MarkerIndex.
+// Both have to give the unit areas, the lists have to cover every active element exactly once
+// and they have to be rebuilt after a refinement.
+
+const int INIT_REF_NUM = 4;                 // Number of initial uniform mesh refinements.
+const int NUM_MATERIALS = 36;
+const double TOLERANCE = 1e-12;
+
+double get_area(Element* e)
+{
+  // Shoelace formula.
+  double area = 0.0;
+  for(int i = 0; i < e->get_nvert(); i++)
+    area += e->vn[i]->x * e->vn[(i + 1) % e->get_nvert()]->y - e->vn[(i + 1) % e->get_nvert()]->x * e->vn[i]->y;
+  return area / 2;
+}
+
+bool check(Mesh* mesh, MarkerIndex& index)
+{
+  bool success = true;
+  Benchmark benchmark("marker-index");
+  benchmark.begin_run();
+
+  // All elements for every material.
+  std::vector<double> areas_scan(NUM_MATERIALS, 0.0);
+  for(int m = 0; m < NUM_MATERIALS; m++)
+  {
+    std::stringstream material;
+    material << "Material_" << m;
+    int marker = mesh->get_element_markers_conversion().get_internal_marker(material.str()).marker;
+    Element* e;
+    for_all_active_elements(e, mesh)
+      if(e->marker == marker)
+        areas_scan[m] += get_area(e);
+  }
+  benchmark.tick("scan");
+
+  // The elements of every material.
+  std::vector<double> areas_index(NUM_MATERIALS, 0.0);
+  int num_listed = 0;
+  for(int m = 0; m < NUM_MATERIALS; m++)
+  {
+    std::stringstream material;
+    material << "Material_" << m;
+    const std::vector<Element*>& elements = index.get_elements(material.str());
+    for(unsigned int i = 0; i < elements.size(); i++)
+      areas_index[m] += get_area(elements[i]);
+    num_listed += elements.size();
+  }
+  benchmark.tick("index");
+
+  for(int m = 0; m < NUM_MATERIALS; m++)
+    if(std::abs(areas_scan[m] - 1.0) > TOLERANCE || std::abs(areas_index[m] - 1.0) > TOLERANCE)
+    {
+      printf("Material_%d: area %g by the scan, %g by the index.\n", m, areas_scan[m], areas_index[m]);
+      success = false;
+    }
+  if(num_listed != mesh->get_num_active_elements() || (int)index.get_elements(HERMES_ANY).size() != num_listed
+    || (int)index.get_area_markers().size() != NUM_MATERIALS)
+  {
+    printf("%d elements listed, %d active.\n", num_listed, mesh->get_num_active_elements());
+    success = false;
+  }
+
+  printf("%d elements, %d materials: scan %g s, index %g s.\n", mesh->get_num_active_elements(), NUM_MATERIALS,
+    benchmark.get_current("scan"), benchmark.get_current("index"));
+  return success;
+}
+
+int main(int argc, char* argv[])
+{
+  // Load the mesh.
+  Mesh mesh;
+  MeshReaderH2D mloader;
+  mloader.load("domain.mesh", &mesh);
+
+  // Perform initial mesh refinements.
+  for (int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+
+  MarkerIndex index;
+  bool success = index.update(&mesh);
+  if(index.update(&mesh))
+  {
+    printf("The index was rebuilt without a change of the mesh.\n");
+    success = false;
+  }
+  success = check(&mesh, index) && success;
+
+  mesh.refine_all_elements();
+  if(!index.update(&mesh))
+  {
+    printf("The index was not rebuilt after the refinement.\n");
+    success = false;
+  }
+  success = check(&mesh, index) && success;
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
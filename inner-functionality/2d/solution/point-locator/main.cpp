@@ -0,0 +1,161 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "benchmark.h"
+#include "point_locator.h"
+
+#include <limits>
+
+using namespace Hermes;
+using namespace Hermes::Hermes2D;
+
+// This test locates points with PointLocator on a straight mesh (a triangle, an affine and a general quad,
+// see domain.mesh) and on a curved one (an annulus, see annulus.mesh), and compares the values of the
+// projection of u = sin(x) * cos(2y) with those of Solution::get_pt_value().
+//
+// The probes are the quadrature points of all active elements, so every probe has to be found in its
+// own element. The same locator is used again after a further refinement, which has to rebuild it.
+
+const int INIT_REF_NUM = 3;                 // Number of initial uniform mesh refinements.
+const int P_INIT = 3;                       // Polynomial degree of the projection.
+const int PROBE_ORDER = 4;                  // Order of the quadrature points used as probes.
+const double TOLERANCE = 1e-8;
+
+class CustomExactSolution : public ExactSolutionScalar<double>
+{
+public:
+  CustomExactSolution(Mesh* mesh) : ExactSolutionScalar<double>(mesh) {};
+
+  virtual double value(double x, double y) const
+  {
+    return std::sin(x) * std::cos(2 * y);
+  }
+
+  virtual void derivatives(double x, double y, double& dx, double& dy) const
+  {
+    dx = std::cos(x) * std::cos(2 * y);
+    dy = -2 * std::sin(x) * std::sin(2 * y);
+  }
+
+  virtual Ord ord(Ord x, Ord y) const
+  {
+    return Ord(10);
+  }
+
+  MeshFunction<double>* clone() const
+  {
+    return new CustomExactSolution(this->mesh);
+  }
+};
+
+bool check(const char* name, Mesh* mesh, PointLocator& locator)
+{
+  bool success = true;
+
+  CustomExactSolution exact_solution(mesh);
+  H1Space<double> space(mesh, P_INIT);
+  Solution<double> sln;
+  OGProjection<double> ogProjection; ogProjection.project_global(&space, &exact_solution, &sln);
+
+  // The probes and their elements.
+  std::vector<double> x, y;
+  std::vector<Element*> probe_elements;
+  RefMap refmap;
+  refmap.set_quad_2d(&g_quad_2d_std);
+  Element* e;
+  for_all_active_elements(e, mesh)
+  {
+    refmap.set_active_element(e);
+    int np = g_quad_2d_std.get_num_points(PROBE_ORDER, e->get_mode());
+    double* phys_x = refmap.get_phys_x(PROBE_ORDER);
+    double* phys_y = refmap.get_phys_y(PROBE_ORDER);
+    for(int i = 0; i < np; i++)
+    {
+      x.push_back(phys_x[i]);
+      y.push_back(phys_y[i]);
+      probe_elements.push_back(e);
+    }
+  }
+
+  int n = x.size();
+  std::vector<double> values_locator(n), values_search(n);
+  std::vector<Element*> located(n);
+  long num_tested = 0;
+  Benchmark benchmark("point-locator");
+  benchmark.begin_run();
+  // The first locate() builds the quadtree.
+  locator.locate(x[0], y[0]);
+  benchmark.tick("build");
+  for(int i = 0; i < n; i++)
+  {
+    located[i] = locator.locate(x[i], y[i]);
+    num_tested += locator.get_num_tested();
+    if(!locator.get_value(&sln, x[i], y[i], values_locator[i]))
+      values_locator[i] = std::numeric_limits<double>::quiet_NaN();
+  }
+  benchmark.tick("locator");
+  for(int i = 0; i < n; i++)
+    values_search[i] = sln.get_pt_value(x[i], y[i])->val[0];
+  benchmark.tick("search");
+
+  for(int i = 0; i < n; i++)
+  {
+    if(located[i] != probe_elements[i])
+    {
+      printf("%s: the point (%g, %g) of the element %d found in %d.\n", name, x[i], y[i], probe_elements[i]->id,
+        located[i] == NULL ? -1 : located[i]->id);
+      success = false;
+    }
+    else if(!(std::abs(values_locator[i] - values_search[i]) <= TOLERANCE))
+    {
+      printf("%s: the value at (%g, %g) is %.12g instead of %.12g.\n", name, x[i], y[i], values_locator[i], values_search[i]);
+      success = false;
+    }
+  }
+
+  // A point outside of the mesh.
+  if(locator.locate(100.0, 100.0) != NULL)
+  {
+    printf("%s: a point outside of the mesh found.\n", name);
+    success = false;
+  }
+
+  printf("%s: %d elements, %d points, depth %d, %g elements tested per point, build %g s, locator %g s, get_pt_value %g s.\n",
+    name, mesh->get_num_active_elements(), n, locator.get_depth(), (double)num_tested / n, benchmark.get_current("build"),
+    benchmark.get_current("locator"), benchmark.get_current("search"));
+  return success;
+}
+
+int main(int argc, char* argv[])
+{
+  bool success = true;
+  const char* meshes[] = { "domain.mesh", "annulus.mesh" };
+  for(int m = 0; m < 2; m++)
+  {
+    // Load the mesh.
+    Mesh mesh;
+    MeshReaderH2D mloader;
+    mloader.load(meshes[m], &mesh);
+
+    // Perform initial mesh refinements.
+    for (int i = 0; i < INIT_REF_NUM; i++)
+      mesh.refine_all_elements();
+
+    PointLocator locator(&mesh);
+    success = check(meshes[m], &mesh, locator) && success;
+
+    // The locator has to follow the refinement.
+    mesh.refine_all_elements();
+    success = check(meshes[m], &mesh, locator) && success;
+  }
+
+  if(success)
+  {
+    printf("Success!\n");
+    return 0;
+  }
+  else
+  {
+    printf("Failure!\n");
+    return -1;
+  }
+}
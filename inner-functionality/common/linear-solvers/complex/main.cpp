@@ -2,6 +2,9 @@
 #define HERMES_REPORT_INFO
 
 #include "hermes_common.h"
+#include "benchmark.h"
+#include "allocation_counter.h"
+#include "real_equivalent_system.h"
 #include <iostream>
 
 using namespace Hermes::Algebra::DenseMatrixOperations;
@@ -9,50 +12,20 @@ using namespace Hermes::Solvers;
 
 // Test of linear solvers.
 // Read matrix and RHS from a file.
-
-// Max row length in input file.
-#define MAX_ROW_LEN  1024
-
-class MatrixEntry
-{
-public:
-  MatrixEntry() { }
-  MatrixEntry(int m, int n, std::complex<double> value) {
-    this->m = m;
-    this->n = n;
-    this->value = value;
-  }
-
-  int m, n;
-  std::complex<double>  value;
-};
-
-void show_mat(const char *msg, std::map<unsigned int, MatrixEntry> mp)
-{
-  std::map<unsigned int, MatrixEntry>::iterator itr;
-
-  std::cout << msg << std::endl;
-
-  for(itr = mp.begin(); itr != mp.end(); ++itr)
-    std::cout << " " << (int) itr->first << ": " <<
-    (int) itr->second.m << " " <<
-    (int) itr->second.n << " " <<
-    (std::complex<double>) itr->second.value <<
-    std::endl;
-
-  std::cout << std::endl;
-}
-
-void show_rhs(const char *msg, std::map<unsigned int, std::complex<double> > mp) {
-  std::map<unsigned int, std::complex<double> >::iterator itr;
-
-  std::cout << msg << std::endl;
-
-  for(itr = mp.begin(); itr != mp.end(); ++itr)
-    std::cout << " " << (int) itr->first << ": " << (std::complex<double>) itr->second << std::endl;
-
-  std::cout << std::endl;
-}
+//
+// Usage: test-solvers-complex SOLVER [complex-matrix-to-real]
+//        test-solvers-complex benchmark FILE [RUNS]
+//
+// With complex-matrix-to-real, the real-equivalent system (see RealEquivalentSystem) is solved
+// by the real version of the solver instead of the complex system. The solver "bicgstab" (only with
+// complex-matrix-to-real) is the matrix-free RealEquivalentSystem::solve(), which stores no matrix.
+//
+// The benchmark mode solves the complex system from FILE by every available solver, both natively
+// and in the real-equivalent form, and by the matrix-free BiCGStab, reports the setup (matrix assembly),
+// factorization and solve times, the memory and the relative residual, and saves them to
+// linear-solvers-complex-benchmark.csv. The real-equivalent solvers get the assembled 2n x 2n matrix
+// with four times the entries of the complex one, only the matrix-free BiCGStab works on the complex
+// arrays. It fails if any residual is over BENCHMARK_TOLERANCE.
 
 bool testPrint(bool value, const char *msg, bool correct) {
   if(value == correct) {
@@ -63,121 +36,28 @@ bool testPrint(bool value, const char *msg, bool correct) {
   }
 }
 
-bool read_n_nums(char *row, int n, double values[]) {
-  int i = 0;
-  char delims[] = " \t\n\r";
-  char *token = strtok(row, delims);
-  while (token != NULL && i < n) {
-    double entry_buffer;
-    sscanf(token, "%lf", &entry_buffer);
-    values[i++] = entry_buffer;
-
-    token = strtok(NULL, delims);
-  }
-
-  return (i == n);
-}
-
-int read_matrix_and_rhs(char *file_name, int &n, int &nnz,
-  std::map<unsigned int, MatrixEntry> &mat, std::map<unsigned int, std::complex<double> > &rhs, bool &cplx_2_real)
-{
-  FILE *file = fopen(file_name, "r");
-  if(file == NULL) return -1;
-
-  enum EState {
-    STATE_N,
-    STATE_MATRIX,
-    STATE_RHS,
-    STATE_NNZ
-  }
-  state = STATE_N;
-
-  // Variables needed to turn complex matrix into real.
-  int k = 0;
-  int l = 0;
-  double* rhs_buffer = NULL;
-
-  double buffer[4];
-  char row[MAX_ROW_LEN];
-  while (fgets(row, MAX_ROW_LEN, file) != NULL) {
-    switch (state) {
-    case STATE_N:
-      if(read_n_nums(row, 1, buffer)) {
-        if(cplx_2_real) {
-          n = 2*((int) buffer[0]);
-          rhs_buffer = new double[n];
-          for (int i = 0; i < n; i++) {
-            rhs_buffer[i] = 0.0;
-          }
-        }
-        else
-          n = (int) buffer[0];
-
-        state = STATE_NNZ;
-      }
-      break;
-
-    case STATE_NNZ:
-      if(read_n_nums(row, 1, buffer))
-        nnz = (int) buffer[0];
-
-      state = STATE_MATRIX;
-      break;
-
-    case STATE_MATRIX:
-      if(read_n_nums(row, 4, buffer)) {
-        std::complex<double> cmplx_buffer(buffer[2], buffer[3]);
-        mat[mat.size()] = (MatrixEntry((int) buffer[0], (int) buffer[1], (std::complex<double>) cmplx_buffer));
-      }
-      else
-        state = STATE_RHS;
-      break;
-
-    case STATE_RHS:
-      if(read_n_nums(row, 3, buffer)) {
-        std::complex<double> cmplx_buffer(buffer[1], buffer[2]);
-        rhs[(int) buffer[0]] = (std::complex<double>) cmplx_buffer;
-      }
-      break;
-    }
-  }
-
-  fclose(file);
-
-  // Free memory
-  delete [] rhs_buffer;
-
-  // Clear pointer.
-  rhs_buffer = NULL;
-
-  return 0;
-}
-
-void build_matrix(int n, std::map<unsigned int, MatrixEntry> &ar_mat, std::map<unsigned int, std::complex<double> > &ar_rhs,
-  SparseMatrix<std::complex<double> > *mat, Vector<std::complex<double> > *rhs)
+void build_matrix(CSRSystem<std::complex<double> > &system, SparseMatrix<std::complex<double> > *mat, Vector<std::complex<double> > *rhs)
 {
+    int n = system.get_size();
     mat->prealloc(n);
-    for (std::map<unsigned int, MatrixEntry>::iterator it = ar_mat.begin(); it != ar_mat.end(); it++) {
-      MatrixEntry &me = it->second;
-      mat->pre_add_ij(me.m, me.n);
-    }
+    for (int i = 0; i < n; i++)
+      for (int k = system.row_ptr[i]; k < system.row_ptr[i + 1]; k++)
+        mat->pre_add_ij(i, system.col_ind[k]);
 
     mat->alloc();
-    for (std::map<unsigned int, MatrixEntry>::iterator it = ar_mat.begin(); it != ar_mat.end(); it++) {
-      MatrixEntry &me = it->second;
-      mat->add(me.m, me.n, me.value);
-    }
+    for (int i = 0; i < n; i++)
+      for (int k = system.row_ptr[i]; k < system.row_ptr[i + 1]; k++)
+        mat->add(i, system.col_ind[k], system.values[k]);
     mat->finish();
 
     rhs->alloc(n);
-    for (std::map<unsigned int, std::complex<double> >::iterator it = ar_rhs.begin(); it != ar_rhs.end(); it++) {
-      rhs->add(it->first, it->second);
-    }
+    for (int i = 0; i < n; i++)
+      rhs->add(i, system.rhs[i]);
     rhs->finish();
 }
 
-void build_matrix_block(int n, std::map<unsigned int, MatrixEntry> &ar_mat, std::map<unsigned int, std::complex<double> > &ar_rhs,
-  SparseMatrix<std::complex<double> > *matrix, Vector<std::complex<double> > *rhs) {
+void build_matrix_block(CSRSystem<std::complex<double> > &system, SparseMatrix<std::complex<double> > *matrix, Vector<std::complex<double> > *rhs) {
+    int n = system.get_size();
     matrix->prealloc(n);
     for (int i = 0; i < n; i++)
       for (int j = 0; j < n; j++)
@@ -191,23 +71,65 @@ void build_matrix_block(int n, std::map<unsigned int, MatrixEntry> &ar_mat, std:
       cols[i] = i;
       rows[i] = i;
     }
-    for (std::map<unsigned int, MatrixEntry>::iterator it = ar_mat.begin(); it != ar_mat.end(); it++) {
-      MatrixEntry &me = it->second;
-      mat[me.m][me.n] = me.value;
-    }
+    for (int i = 0; i < n; i++)
+      for (int k = system.row_ptr[i]; k < system.row_ptr[i + 1]; k++)
+        mat[i][system.col_ind[k]] = system.values[k];
     matrix->add(n, n, mat, rows, cols);
     matrix->finish();
 
     rhs->alloc(n);
     std::complex<double>  *rs = new std::complex<double>[n];
-    for (std::map<unsigned int, std::complex<double> >::iterator it = ar_rhs.begin(); it != ar_rhs.end(); it++) {
-      rs[it->first] = it->second;
+    for (int i = 0; i < n; i++)
+      rs[i] = system.rhs[i];
+    unsigned int *u_rows = new unsigned int[n];
+    for (int i = 0; i < n; i++)
+      u_rows[i] = rows[i] >= 0 ? rows[i] : 0;
+    rhs->add(n, u_rows, rs);
+    rhs->finish();
+}
+
+
+void build_matrix(RealEquivalentSystem &system, SparseMatrix<double> *mat, Vector<double> *rhs)
+{
+    system.assemble(mat, rhs);
+}
+
+void build_matrix_block(RealEquivalentSystem &system, SparseMatrix<double> *matrix, Vector<double> *rhs) {
+    int n = system.get_size();
+    matrix->prealloc(n);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        matrix->pre_add_ij(i, j);
+
+    matrix->alloc();
+    double  **mat = new_matrix<double>(n, n);
+    int *cols = new int[n];
+    int *rows = new int[n];
+    for (int i = 0; i < n; i++) {
+      cols[i] = i;
+      rows[i] = i;
     }
+    int *row_cols = new int[system.get_max_row_length()];
+    double *row_values = new double[system.get_max_row_length()];
+    for (int i = 0; i < n; i++) {
+      int count = system.get_row(i, row_cols, row_values);
+      for (int k = 0; k < count; k++)
+        mat[i][row_cols[k]] = row_values[k];
+    }
+    matrix->add(n, n, mat, rows, cols);
+    matrix->finish();
+
+    rhs->alloc(n);
+    double  *rs = new double[n];
+    system.get_rhs(rs);
     unsigned int *u_rows = new unsigned int[n];
     for (int i = 0; i < n; i++)
       u_rows[i] = rows[i] >= 0 ? rows[i] : 0;
     rhs->add(n, u_rows, rs);
     rhs->finish();
+
+    delete [] row_cols;
+    delete [] row_values;
 }
 
 // Test code.
@@ -224,31 +146,281 @@ void solve(LinearMatrixSolver<std::complex<double> > &solver, int n) {
     printf("Unable to solve.\n");
 }
 
-int main(int argc, char *argv[]) {
-  int ret = 0;
 
-  int n;
-  int nnz;
-  bool cplx_2_real;
+// Solves the real-equivalent system, stores the complex solution to sln.
+template<typename MatrixType, typename VectorType>
+void solve_real_equivalent(LinearMatrixSolver<double>* (*create_solver)(MatrixType*, VectorType*), bool block,
+  RealEquivalentSystem &system, std::complex<double> *sln) {
+  MatrixType mat;
+  VectorType rhs;
+  if(block)
+    build_matrix_block(system, &mat, &rhs);
+  else
+    build_matrix(system, &mat, &rhs);
+
+  LinearMatrixSolver<double>* solver = create_solver(&mat, &rhs);
+  if(solver->solve())
+    RealEquivalentSystem::to_complex(system.get_size() / 2, solver->get_sln_vector(), sln);
+  else
+    printf("Unable to solve.\n");
+  delete solver;
+}
+
+// Maximum relative residual accepted in the benchmark mode.
+const double BENCHMARK_TOLERANCE = 1e-8;
 
-  std::map<unsigned int, MatrixEntry> ar_mat;
-  std::map<unsigned int, std::complex<double> > ar_rhs;
+// One run of the benchmark of a solver of the complex system (System = CSRSystem<std::complex<double> >)
+// or of its real-equivalent form (System = RealEquivalentSystem). For direct solvers, the system is solved
+// twice, the second time with the factorization reused, the difference of the times is reported as the factorization.
+template<typename Scalar, typename MatrixType, typename VectorType, typename System>
+void benchmark_solver(Benchmark &benchmark, LinearMatrixSolver<Scalar>* (*create_solver)(MatrixType*, VectorType*), bool direct,
+  System &system)
+{
+  benchmark.begin_run();
+  AllocationCounter counter(benchmark.get_name());
+  counter.begin();
+
+  MatrixType mat;
+  VectorType rhs;
+  build_matrix(system, &mat, &rhs);
+  LinearMatrixSolver<Scalar>* solver = create_solver(&mat, &rhs);
+  benchmark.tick("setup");
+  counter.tick("setup");
+
+  if(!solver->solve())
+    printf("Unable to solve.\n");
+  double first_solve = benchmark.tick("solve");
+  counter.tick("solve");
+
+  if(direct) {
+    solver->set_factorization_scheme(Hermes::HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    if(!solver->solve())
+      printf("Unable to solve.\n");
+    double second_solve = benchmark.tick("repeated solve");
+    benchmark.add("factorization", std::max(first_solve - second_solve, 0.0));
+  }
 
-  if(argc == 3 && strcasecmp(argv[2], "complex-matrix-to-real") == 0)
-    cplx_2_real = true;
+  // Values and row (or column) indices, pointers to the columns (or rows).
+  double nnz = mat.get_nnz();
+  benchmark.set_metric("matrix [B]", nnz * (sizeof(Scalar) + sizeof(int)) + (system.get_size() + 1) * sizeof(int));
+  benchmark.set_metric("residual", system.relative_residual(solver->get_sln_vector()));
+  benchmark.set_metric("RSS growth [kB]", counter.get_phase("solve").rss_growth);
+  if(AllocationCounter::is_enabled()) {
+    benchmark.set_metric("setup heap [B]", counter.get_phase("setup").bytes);
+    benchmark.set_metric("solve heap [B]", counter.get_phase("solve").peak_heap);
+  }
+
+  delete solver;
+}
+
+#ifdef WITH_UMFPACK
+LinearMatrixSolver<std::complex<double> >* create_umfpack_complex(UMFPackMatrix<std::complex<double> > *mat, UMFPackVector<std::complex<double> > *rhs) {
+  return new UMFPackLinearMatrixSolver<std::complex<double> >(mat, rhs);
+}
+LinearMatrixSolver<double>* create_umfpack(UMFPackMatrix<double> *mat, UMFPackVector<double> *rhs) {
+  return new UMFPackLinearMatrixSolver<double>(mat, rhs);
+}
+#endif
+#ifdef WITH_PETSC
+LinearMatrixSolver<std::complex<double> >* create_petsc_complex(PetscMatrix<std::complex<double> > *mat, PetscVector<std::complex<double> > *rhs) {
+  return new PetscLinearMatrixSolver<std::complex<double> >(mat, rhs);
+}
+LinearMatrixSolver<double>* create_petsc(PetscMatrix<double> *mat, PetscVector<double> *rhs) {
+  return new PetscLinearMatrixSolver<double>(mat, rhs);
+}
+#endif
+#ifdef WITH_TRILINOS
+LinearMatrixSolver<std::complex<double> >* create_aztecoo_complex(EpetraMatrix<std::complex<double> > *mat, EpetraVector<std::complex<double> > *rhs) {
+  return new AztecOOSolver<std::complex<double> >(mat, rhs);
+}
+LinearMatrixSolver<double>* create_aztecoo(EpetraMatrix<double> *mat, EpetraVector<double> *rhs) {
+  return new AztecOOSolver<double>(mat, rhs);
+}
+LinearMatrixSolver<std::complex<double> >* create_amesos_complex(EpetraMatrix<std::complex<double> > *mat, EpetraVector<std::complex<double> > *rhs) {
+  return new AmesosSolver<std::complex<double> >("Klu", mat, rhs);
+}
+LinearMatrixSolver<double>* create_amesos(EpetraMatrix<double> *mat, EpetraVector<double> *rhs) {
+  return new AmesosSolver<double>("Klu", mat, rhs);
+}
+#endif
+#ifdef WITH_MUMPS
+LinearMatrixSolver<std::complex<double> >* create_mumps_complex(MumpsMatrix<std::complex<double> > *mat, MumpsVector<std::complex<double> > *rhs) {
+  return new MumpsSolver<std::complex<double> >(mat, rhs);
+}
+LinearMatrixSolver<double>* create_mumps(MumpsMatrix<double> *mat, MumpsVector<double> *rhs) {
+  return new MumpsSolver<double>(mat, rhs);
+}
+#endif
+
+// One run of the benchmark of the matrix-free BiCGStab on the real-equivalent system. There is no setup,
+// the memory is the one of the complex CSR arrays the operator works on.
+void benchmark_matrix_free(Benchmark &benchmark, RealEquivalentSystem &system, const CSRSystem<std::complex<double> > &complex_system)
+{
+  benchmark.begin_run();
+  AllocationCounter counter(benchmark.get_name());
+  counter.begin();
+
+  std::vector<double> x(system.get_size(), 0.0);
+  int iterations = system.solve(&x[0], BENCHMARK_TOLERANCE / 10);
+  benchmark.tick("solve");
+  counter.tick("solve");
+
+  benchmark.set_metric("matrix [B]", complex_system.get_nnz() * (sizeof(std::complex<double>) + sizeof(int))
+    + (complex_system.get_size() + 1) * sizeof(int));
+  benchmark.set_metric("residual", system.relative_residual(&x[0]));
+  benchmark.set_metric("RSS growth [kB]", counter.get_phase("solve").rss_growth);
+  benchmark.set_metric("iterations", iterations);
+  if(AllocationCounter::is_enabled())
+    benchmark.set_metric("solve heap [B]", counter.get_phase("solve").peak_heap);
+}
+
+// Prints the results of one solver and saves them, returns false if the residual is too large.
+bool report_solver(Benchmark &benchmark, bool append) {
+  double residual = benchmark.get_metric_statistics("residual").max;
+  printf("%-24s", benchmark.get_name().c_str());
+  const char* columns[6] = { "setup", "factorization", "solve", "matrix [B]", "RSS growth [kB]", "residual" };
+  for (int i = 0; i < 6; i++)
+    printf(" %12g", i < 3 ? benchmark.get_statistics(columns[i]).median : benchmark.get_metric_statistics(columns[i]).median);
+  printf("\n");
+  benchmark.save_csv("linear-solvers-complex-benchmark.csv", append);
+
+  if(residual > BENCHMARK_TOLERANCE) {
+    printf("%s: residual %g over the tolerance %g.\n", benchmark.get_name().c_str(), residual, BENCHMARK_TOLERANCE);
+    return false;
+  }
+  return true;
+}
+
+// Benchmarks the complex and the real-equivalent solve by one solver.
+#define BENCHMARK_SOLVER(solver_name, create_complex_solver, create_real_solver, direct) \
+  { \
+    Benchmark complex_benchmark(solver_name " complex"); \
+    Benchmark real_benchmark(solver_name " real-equivalent"); \
+    for (int run = 0; run < runs; run++) { \
+      benchmark_solver(complex_benchmark, create_complex_solver, direct, system); \
+      benchmark_solver(real_benchmark, create_real_solver, direct, equivalent); \
+    } \
+    success = report_solver(complex_benchmark, solvers++ > 0) && success; \
+    success = report_solver(real_benchmark, true) && success; \
+  }
+
+int benchmark_solvers(const char *file_name, int runs) {
+  CSRSystem<std::complex<double> > system;
+
+  Hermes::Mixins::TimeMeasurable timer;
+  timer.tick();
+  LinearSystemReader::read(file_name, system);
+  timer.tick();
+  printf("%s: n = %d, %d nonzeros, read in %g s.\n", file_name, system.get_size(), system.get_nnz(), timer.last());
+  RealEquivalentSystem equivalent(system);
+
+  printf("%-24s %12s %12s %12s %12s %12s %12s\n", "solver", "setup[s]", "factor[s]", "solve[s]", "matrix[B]", "RSSgrow[kB]", "residual");
+  bool success = true;
+  int solvers = 0;
+
+#ifdef WITH_UMFPACK
+  BENCHMARK_SOLVER("umfpack", create_umfpack_complex, create_umfpack, true);
+#endif
+#ifdef WITH_PETSC
+  BENCHMARK_SOLVER("petsc", create_petsc_complex, create_petsc, false);
+#endif
+#ifdef WITH_TRILINOS
+  BENCHMARK_SOLVER("aztecoo", create_aztecoo_complex, create_aztecoo, false);
+  if(AmesosSolver<double>::is_available("Klu"))
+    BENCHMARK_SOLVER("amesos", create_amesos_complex, create_amesos, true);
+#endif
+#ifdef WITH_MUMPS
+  BENCHMARK_SOLVER("mumps", create_mumps_complex, create_mumps, true);
+#endif
+
+  {
+    Benchmark matrix_free_benchmark("bicgstab matrix-free");
+    for (int run = 0; run < runs; run++)
+      benchmark_matrix_free(matrix_free_benchmark, equivalent, system);
+    success = report_solver(matrix_free_benchmark, solvers++ > 0) && success;
+  }
+  printf("The real-equivalent matrices of the solvers hold %d entries (4x the %d of the complex one),\n"
+    "the matrix-free BiCGStab stores none of them.\n", equivalent.get_nnz(), system.get_nnz());
+
+  if(success)
+    printf("Success!\n");
   else
-    cplx_2_real = false;
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
+
+// Solves the real-equivalent system by the solver given by its name, returns false for an unknown or unavailable solver.
+bool solve_real_equivalent(const char *solver_name, RealEquivalentSystem &system, std::complex<double> *sln) {
+  std::string name = solver_name;
+  if(name == "bicgstab") {
+    std::vector<double> x(system.get_size(), 0.0);
+    system.solve(&x[0], 1e-12);
+    RealEquivalentSystem::to_complex(system.get_size() / 2, &x[0], sln);
+    return true;
+  }
+
+  bool block = name.size() > 6 && name.compare(name.size() - 6, 6, "-block") == 0;
+  if(block)
+    name = name.substr(0, name.size() - 6);
+
+#ifdef WITH_UMFPACK
+  if(name == "umfpack") {
+    solve_real_equivalent(create_umfpack, block, system, sln);
+    return true;
+  }
+#endif
+#ifdef WITH_PETSC
+  if(name == "petsc") {
+    solve_real_equivalent(create_petsc, block, system, sln);
+    return true;
+  }
+#endif
+#ifdef WITH_TRILINOS
+  if(name == "aztecoo") {
+    solve_real_equivalent(create_aztecoo, block, system, sln);
+    return true;
+  }
+  if(name == "amesos" && AmesosSolver<double>::is_available("Klu")) {
+    solve_real_equivalent(create_amesos, block, system, sln);
+    return true;
+  }
+#endif
+#ifdef WITH_MUMPS
+  if(name == "mumps") {
+    solve_real_equivalent(create_mumps, block, system, sln);
+    return true;
+  }
+#endif
+  return false;
+}
+
+int main(int argc, char *argv[]) {
+  if(argc > 2 && strcasecmp(argv[1], "benchmark") == 0)
+    return benchmark_solvers(argv[2], argc > 3 ? atoi(argv[3]) : 1);
+
+  int ret = 0;
+
+  CSRSystem<std::complex<double> > system;
+  bool cplx_2_real = argc == 3 && strcasecmp(argv[2], "complex-matrix-to-real") == 0;
 
   std::complex<double>* sln;
 
-  if(read_matrix_and_rhs((char*)"in/linsys-cplx-4", n, nnz, ar_mat, ar_rhs, cplx_2_real) != 0)
-    throw Hermes::Exceptions::Exception("Failed to read the matrix and rhs.");
+  LinearSystemReader::read("in/linsys-cplx-4", system);
+  int n = system.get_size();
 
-  if(strcasecmp(argv[1], "petsc") == 0) {
+  RealEquivalentSystem equivalent(system);
+  std::vector<std::complex<double> > equivalent_sln(n);
+
+  if(cplx_2_real) {
+    if(!solve_real_equivalent(argv[1], equivalent, &equivalent_sln[0]))
+      ret = -1;
+    sln = &equivalent_sln[0];
+  }
+  else if(strcasecmp(argv[1], "petsc") == 0) {
 #ifdef WITH_PETSC
     PetscMatrix<std::complex<double> > mat;
     PetscVector<std::complex<double> > rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     PetscLinearMatrixSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -259,7 +431,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_PETSC
     PetscMatrix<std::complex<double> > mat;
     PetscVector<std::complex<double> > rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     PetscLinearMatrixSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -270,7 +442,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_UMFPACK
     UMFPackMatrix<std::complex<double> > mat;
     UMFPackVector<std::complex<double> > rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     UMFPackLinearMatrixSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -281,7 +453,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_UMFPACK
     UMFPackMatrix<std::complex<double> > mat;
     UMFPackVector<std::complex<double> > rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     UMFPackLinearMatrixSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -292,7 +464,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_TRILINOS
     EpetraMatrix<std::complex<double> > mat;
     EpetraVector<std::complex<double> > rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     AztecOOSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -303,7 +475,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_TRILINOS
     EpetraMatrix<std::complex<double> > mat;
     EpetraVector<std::complex<double> > rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     AztecOOSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -314,7 +486,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_TRILINOS
     EpetraMatrix<std::complex<double> > mat;
     EpetraVector<std::complex<double> > rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     if(AmesosSolver<std::complex<double> >::is_available("Klu")) {
       AmesosSolver<std::complex<double> > solver("Klu", &mat, &rhs);
@@ -327,7 +499,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_TRILINOS
     EpetraMatrix<std::complex<double> > mat;
     EpetraVector<std::complex<double> > rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     if(AmesosSolver<std::complex<double> >::is_available("Klu")) {
       AmesosSolver<std::complex<double> > solver("Klu", &mat, &rhs);
@@ -340,7 +512,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_MUMPS
     MumpsMatrix<std::complex<double> > mat;
     MumpsVector<std::complex<double> > rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     MumpsSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -351,7 +523,7 @@ sln = solver.get_sln_vector();
 #ifdef WITH_MUMPS
     MumpsMatrix<std::complex<double> > mat;
     MumpsVector<std::complex<double> > rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     MumpsSolver<std::complex<double> > solver(&mat, &rhs);
     solve(solver, n);
@@ -2,6 +2,9 @@
 #define HERMES_REPORT_INFO
 
 #include "hermes_common.h"
+#include "benchmark.h"
+#include "allocation_counter.h"
+#include "linear_system_reader.h"
 #include <iostream>
 
 using namespace Hermes::Algebra::DenseMatrixOperations;
@@ -9,50 +12,16 @@ using namespace Hermes::Solvers;
 
 // Test of linear solvers.
 // Read matrix and RHS from a file.
-
-// Max row length in input file.
-#define MAX_ROW_LEN  1024
-
-class MatrixEntry
-{
-public:
-  MatrixEntry() { }
-  MatrixEntry(int m, int n, double value) {
-    this->m = m;
-    this->n = n;
-    this->value = value;
-  }
-
-  int m, n;
-  double  value;
-};
-
-void show_mat(const char *msg, std::map<unsigned int, MatrixEntry> mp)
-{
-  std::map<unsigned int, MatrixEntry>::iterator itr;
-
-  std::cout << msg << std::endl;
-
-  for(itr = mp.begin(); itr != mp.end(); ++itr)
-    std::cout << " " << (int) itr->first << ": " <<
-    (int) itr->second.m << " " <<
-    (int) itr->second.n << " " <<
-    (double) itr->second.value <<
-    std::endl;
-
-  std::cout << std::endl;
-}
-
-void show_rhs(const char *msg, std::map<unsigned int, double > mp) {
-  std::map<unsigned int, double >::iterator itr;
-
-  std::cout << msg << std::endl;
-
-  for(itr = mp.begin(); itr != mp.end(); ++itr)
-    std::cout << " " << (int) itr->first << ": " << (double) itr->second << std::endl;
-
-  std::cout << std::endl;
-}
+//
+// Usage: test-solvers-real SOLVER TEST_NUMBER
+//        test-solvers-real benchmark FILE [RUNS [cache]]
+//
+// The benchmark mode solves the system from FILE (the linsys format of the files in 'in/',
+// or Matrix Market coordinate format, with the right-hand side A * (1, ..., 1)) by every
+// available solver, reports the setup (matrix assembly), factorization and solve times,
+// the memory and the relative residual, and saves them to linear-solvers-benchmark.csv.
+// It fails if any residual is over BENCHMARK_TOLERANCE or if no solver is available.
+// With 'cache', the parsed system is kept in FILE.csr-cache for the next runs (see LinearSystemReader).
 
 bool testPrint(bool value, const char *msg, bool correct) {
   if(value == correct) {
@@ -63,158 +32,28 @@ bool testPrint(bool value, const char *msg, bool correct) {
   }
 }
 
-bool read_n_nums(char *row, int n, double values[]) {
-  int i = 0;
-  char delims[] = " \t\n\r";
-  char *token = strtok(row, delims);
-  while (token != NULL && i < n) {
-    double entry_buffer;
-    sscanf(token, "%lf", &entry_buffer);
-    values[i++] = entry_buffer;
-
-    token = strtok(NULL, delims);
-  }
-
-  return (i == n);
-}
-
-int read_matrix_and_rhs(char *file_name, int &n, int &nnz,
-  std::map<unsigned int, MatrixEntry> &mat, std::map<unsigned int, double> &rhs, bool &cplx_2_real)
-{
-  FILE *file = fopen(file_name, "r");
-  if(file == NULL)
-    return -1;
-
-  enum EState {
-    STATE_N,
-    STATE_MATRIX,
-    STATE_RHS,
-    STATE_NNZ
-  }
-  state = STATE_N;
-
-  // Variables needed to turn complex matrix into real.
-  int k = 0;
-  int l = 0;
-  double* rhs_buffer = NULL;
-
-  double buffer[4];
-  char row[MAX_ROW_LEN];
-  while (fgets(row, MAX_ROW_LEN, file) != NULL) {
-    switch (state) {
-    case STATE_N:
-      if(read_n_nums(row, 1, buffer)) {
-        if(cplx_2_real) {
-          n = 2*((int) buffer[0]);
-          rhs_buffer = new double[n];
-          for (int i = 0; i < n; i++) {
-            rhs_buffer[i] = 0.0;
-          }
-        }
-        else
-          n = (int) buffer[0];
-
-        state = STATE_NNZ;
-      }
-      break;
-
-    case STATE_NNZ:
-      if(read_n_nums(row, 1, buffer))
-        nnz = (int) buffer[0];
-
-      state = STATE_MATRIX;
-      break;
-
-    case STATE_MATRIX:
-      if(cplx_2_real) {
-        if(read_n_nums(row, 4, buffer)) {
-          mat.insert(std::pair<unsigned int, MatrixEntry>(k,   MatrixEntry ((int) buffer[0],     (int) buffer[1],     buffer[2])));
-          mat.insert(std::pair<unsigned int, MatrixEntry>(k + 1, MatrixEntry ((int) buffer[0] + n/2, (int) buffer[1],     buffer[3])));
-          mat.insert(std::pair<unsigned int, MatrixEntry>(k + 2*nnz, MatrixEntry ((int) buffer[0],     (int) buffer[1] + n/2, (-1)*buffer[3])));
-          mat.insert(std::pair<unsigned int, MatrixEntry>(k + 2*nnz + 1, MatrixEntry ((int) buffer[0] + n/2, (int) buffer[1] + n/2, buffer[2])));
-          k = k + 2;
-        }
-        else
-          state = STATE_RHS;
-      }
-      else { // if cplx_2_real is false.
-        if(read_n_nums(row, 3, buffer))
-          mat[mat.size()] = (MatrixEntry ((int) buffer[0], (int) buffer[1], buffer[2]));
-
-        else
-          state = STATE_RHS;
-      }
-      break; //case STATE_MATRIX break.
-
-    case STATE_RHS:
-      if(cplx_2_real) {
-        if(read_n_nums(row, 3, buffer)) {
-          if(buffer[0] != (int) n/2-1) // Then this is not the last line in the input file
-          {
-            rhs[((int) buffer[0])] = (double) buffer[1];
-            rhs_buffer[l] = (double) buffer[2];
-            l = l + 1;
-          }
-
-          else // This is last line in the file.
-          {
-            // First read last line entry
-            rhs[((int) buffer[0])] = (double) buffer[1];
-            rhs_buffer[l] = (double) buffer[2];
-            l = l + 1;
-            // Take imaginary parts you saved,
-            // and fill the rest of the rhs vector.
-            for (int i = 0; i < l; i++)
-            {
-              rhs[rhs.size()] = rhs_buffer[i];
-            }
-          }
-        }
-      }
-      else { // if cplx_2_real is false.
-        if(read_n_nums(row, 2, buffer))
-          rhs[(int) buffer[0]] = (double) buffer[1];
-      }
-      break;
-    }
-  }
-
-  fclose(file);
-
-  // Free memory
-  delete [] rhs_buffer;
-
-  // Clear pointer.
-  rhs_buffer = NULL;
-
-  return 0;
-}
-
-void build_matrix(int n, std::map<unsigned int, MatrixEntry> &ar_mat, std::map<unsigned int, double > &ar_rhs,
-  SparseMatrix<double> *mat, Vector<double> *rhs)
+void build_matrix(CSRSystem<double> &system, SparseMatrix<double> *mat, Vector<double> *rhs)
 {
+    int n = system.get_size();
     mat->prealloc(n);
-    for (std::map<unsigned int, MatrixEntry>::iterator it = ar_mat.begin(); it != ar_mat.end(); it++) {
-      MatrixEntry &me = it->second;
-      mat->pre_add_ij(me.m, me.n);
-    }
+    for (int i = 0; i < n; i++)
+      for (int k = system.row_ptr[i]; k < system.row_ptr[i + 1]; k++)
+        mat->pre_add_ij(i, system.col_ind[k]);
 
     mat->alloc();
-    for (std::map<unsigned int, MatrixEntry>::iterator it = ar_mat.begin(); it != ar_mat.end(); it++) {
-      MatrixEntry &me = it->second;
-      mat->add(me.m, me.n, me.value);
-    }
+    for (int i = 0; i < n; i++)
+      for (int k = system.row_ptr[i]; k < system.row_ptr[i + 1]; k++)
+        mat->add(i, system.col_ind[k], system.values[k]);
     mat->finish();
 
     rhs->alloc(n);
-    for (std::map<unsigned int, double >::iterator it = ar_rhs.begin(); it != ar_rhs.end(); it++) {
-      rhs->add(it->first, it->second);
-    }
+    for (int i = 0; i < n; i++)
+      rhs->add(i, system.rhs[i]);
     rhs->finish();
 }
 
-void build_matrix_block(int n, std::map<unsigned int, MatrixEntry> &ar_mat, std::map<unsigned int, double > &ar_rhs,
-  SparseMatrix<double> *matrix, Vector<double> *rhs) {
+void build_matrix_block(CSRSystem<double> &system, SparseMatrix<double> *matrix, Vector<double> *rhs) {
+    int n = system.get_size();
     matrix->prealloc(n);
     for (int i = 0; i < n; i++)
       for (int j = 0; j < n; j++)
@@ -228,18 +67,16 @@ void build_matrix_block(int n, std::map<unsigned int, MatrixEntry> &ar_mat, std:
       cols[i] = i;
       rows[i] = i;
     }
-    for (std::map<unsigned int, MatrixEntry>::iterator it = ar_mat.begin(); it != ar_mat.end(); it++) {
-      MatrixEntry &me = it->second;
-      mat[me.m][me.n] = me.value;
-    }
+    for (int i = 0; i < n; i++)
+      for (int k = system.row_ptr[i]; k < system.row_ptr[i + 1]; k++)
+        mat[i][system.col_ind[k]] = system.values[k];
     matrix->add(n, n, mat, rows, cols);
     matrix->finish();
 
     rhs->alloc(n);
     double  *rs = new double[n];
-    for (std::map<unsigned int, double >::iterator it = ar_rhs.begin(); it != ar_rhs.end(); it++) {
-      rs[it->first] = it->second;
-    }
+    for (int i = 0; i < n; i++)
+      rs[i] = system.rhs[i];
     unsigned int *u_rows = new unsigned int[n];
     for (int i = 0; i < n; i++)
       u_rows[i] = rows[i] >= 0 ? rows[i] : 0;
@@ -253,43 +90,180 @@ void solve(LinearMatrixSolver<double> &solver, int n) {
     printf("Unable to solve.\n");
 }
 
-int main(int argc, char *argv[]) {
-  int ret = 0;
+// Maximum relative residual accepted in the benchmark mode.
+const double BENCHMARK_TOLERANCE = 1e-8;
 
-  int n;
-  int nnz;
-  bool cplx_2_real;
+// One run of the benchmark of a solver. For direct solvers, the system is solved twice, the second
+// time with the factorization reused, the difference of the times is reported as the factorization.
+template<typename MatrixType, typename VectorType>
+void benchmark_solver(Benchmark &benchmark, LinearMatrixSolver<double>* (*create_solver)(MatrixType*, VectorType*), bool direct,
+  CSRSystem<double> &system)
+{
+  benchmark.begin_run();
+  AllocationCounter counter(benchmark.get_name());
+  counter.begin();
+
+  MatrixType mat;
+  VectorType rhs;
+  build_matrix(system, &mat, &rhs);
+  LinearMatrixSolver<double>* solver = create_solver(&mat, &rhs);
+  benchmark.tick("setup");
+  counter.tick("setup");
+
+  solve(*solver, system.get_size());
+  double first_solve = benchmark.tick("solve");
+  counter.tick("solve");
+
+  if(direct) {
+    solver->set_factorization_scheme(Hermes::HERMES_REUSE_FACTORIZATION_COMPLETELY);
+    solve(*solver, system.get_size());
+    double second_solve = benchmark.tick("repeated solve");
+    benchmark.add("factorization", std::max(first_solve - second_solve, 0.0));
+  }
+
+  benchmark.set_metric("residual", system.relative_residual(solver->get_sln_vector()));
+  benchmark.set_metric("RSS growth [kB]", counter.get_phase("solve").rss_growth);
+  if(AllocationCounter::is_enabled()) {
+    benchmark.set_metric("setup heap [B]", counter.get_phase("setup").bytes);
+    benchmark.set_metric("solve heap [B]", counter.get_phase("solve").peak_heap);
+  }
 
-  std::map<unsigned int, MatrixEntry> ar_mat;
-  std::map<unsigned int, double > ar_rhs;
+  delete solver;
+}
 
-  if(argc == 4 && strcasecmp(argv[3], "complex-matrix-to-real") == 0)
-    cplx_2_real = true;
+#ifdef WITH_UMFPACK
+LinearMatrixSolver<double>* create_umfpack(UMFPackMatrix<double> *mat, UMFPackVector<double> *rhs) {
+  return new UMFPackLinearMatrixSolver<double>(mat, rhs);
+}
+#endif
+#ifdef WITH_PETSC
+LinearMatrixSolver<double>* create_petsc(PetscMatrix<double> *mat, PetscVector<double> *rhs) {
+  return new PetscLinearMatrixSolver<double>(mat, rhs);
+}
+#endif
+#ifdef WITH_TRILINOS
+LinearMatrixSolver<double>* create_aztecoo(EpetraMatrix<double> *mat, EpetraVector<double> *rhs) {
+  return new AztecOOSolver<double>(mat, rhs);
+}
+LinearMatrixSolver<double>* create_amesos(EpetraMatrix<double> *mat, EpetraVector<double> *rhs) {
+  return new AmesosSolver<double>("Klu", mat, rhs);
+}
+#endif
+#ifdef WITH_MUMPS
+LinearMatrixSolver<double>* create_mumps(MumpsMatrix<double> *mat, MumpsVector<double> *rhs) {
+  return new MumpsSolver<double>(mat, rhs);
+}
+#endif
+
+// Prints the results of one solver and saves them, returns false if the residual is too large.
+bool report_solver(Benchmark &benchmark, bool append) {
+  double residual = benchmark.get_metric_statistics("residual").max;
+  printf("%-10s", benchmark.get_name().c_str());
+  const char* columns[6] = { "setup", "factorization", "solve", "repeated solve", "RSS growth [kB]", "residual" };
+  for (int i = 0; i < 6; i++)
+    printf(" %14g", i < 4 ? benchmark.get_statistics(columns[i]).median : benchmark.get_metric_statistics(columns[i]).median);
+  printf("\n");
+  benchmark.save_csv("linear-solvers-benchmark.csv", append);
+
+  if(residual > BENCHMARK_TOLERANCE) {
+    printf("%s: residual %g over the tolerance %g.\n", benchmark.get_name().c_str(), residual, BENCHMARK_TOLERANCE);
+    return false;
+  }
+  return true;
+}
+
+int benchmark_solvers(const char *file_name, int runs, bool use_cache) {
+  CSRSystem<double> system;
+
+  Hermes::Mixins::TimeMeasurable timer;
+  timer.tick();
+  LinearSystemReader::read(file_name, system, use_cache);
+  timer.tick();
+  printf("%s: n = %d, %d nonzeros, read in %g s.\n", file_name, system.get_size(), system.get_nnz(), timer.last());
+
+  printf("%-10s %14s %14s %14s %14s %14s %14s\n", "solver", "setup[s]", "factor[s]", "solve[s]", "resolve[s]", "RSSgrow[kB]", "residual");
+  bool success = true;
+  int solvers = 0;
+
+#ifdef WITH_UMFPACK
+  {
+    Benchmark benchmark("umfpack");
+    for (int run = 0; run < runs; run++)
+      benchmark_solver(benchmark, create_umfpack, true, system);
+    success = report_solver(benchmark, solvers++ > 0) && success;
+  }
+#endif
+#ifdef WITH_PETSC
+  {
+    Benchmark benchmark("petsc");
+    for (int run = 0; run < runs; run++)
+      benchmark_solver(benchmark, create_petsc, false, system);
+    success = report_solver(benchmark, solvers++ > 0) && success;
+  }
+#endif
+#ifdef WITH_TRILINOS
+  {
+    Benchmark benchmark("aztecoo");
+    for (int run = 0; run < runs; run++)
+      benchmark_solver(benchmark, create_aztecoo, false, system);
+    success = report_solver(benchmark, solvers++ > 0) && success;
+  }
+  if(AmesosSolver<double>::is_available("Klu")) {
+    Benchmark benchmark("amesos");
+    for (int run = 0; run < runs; run++)
+      benchmark_solver(benchmark, create_amesos, true, system);
+    success = report_solver(benchmark, solvers++ > 0) && success;
+  }
+#endif
+#ifdef WITH_MUMPS
+  {
+    Benchmark benchmark("mumps");
+    for (int run = 0; run < runs; run++)
+      benchmark_solver(benchmark, create_mumps, true, system);
+    success = report_solver(benchmark, solvers++ > 0) && success;
+  }
+#endif
+
+  if(solvers == 0) {
+    printf("No solver available.\n");
+    success = false;
+  }
+
+  if(success)
+    printf("Success!\n");
   else
-    cplx_2_real = false;
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+  if(argc > 2 && strcasecmp(argv[1], "benchmark") == 0)
+    return benchmark_solvers(argv[2], argc > 3 ? atoi(argv[3]) : 1, argc > 4 && strcasecmp(argv[4], "cache") == 0);
+
+  int ret = 0;
+
+  CSRSystem<double> system;
 
 double* sln;
   switch(atoi(argv[2]))
   {
   case 1:
-    if(read_matrix_and_rhs((char*)"in/linsys-1", n, nnz, ar_mat, ar_rhs, cplx_2_real) != 0)
-      throw Hermes::Exceptions::Exception("Failed to read the matrix and rhs.");
+    LinearSystemReader::read("in/linsys-1", system);
     break;
   case 2:
-    if(read_matrix_and_rhs((char*)"in/linsys-2", n, nnz, ar_mat, ar_rhs, cplx_2_real) != 0)
-      throw Hermes::Exceptions::Exception("Failed to read the matrix and rhs.");
+    LinearSystemReader::read("in/linsys-2", system);
     break;
   case 3:
-    if(read_matrix_and_rhs((char*)"in/linsys-3", n, nnz, ar_mat, ar_rhs, cplx_2_real) != 0)
-      throw Hermes::Exceptions::Exception("Failed to read the matrix and rhs.");
+    LinearSystemReader::read("in/linsys-3", system);
     break;
   }
+  int n = system.get_size();
 
   if(strcasecmp(argv[1], "petsc") == 0) {
 #ifdef WITH_PETSC
     PetscMatrix<double> mat;
     PetscVector<double> rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     PetscLinearMatrixSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -300,7 +274,7 @@ double* sln;
 #ifdef WITH_PETSC
     PetscMatrix<double> mat;
     PetscVector<double> rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     PetscLinearMatrixSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -311,7 +285,7 @@ double* sln;
 #ifdef WITH_UMFPACK
     UMFPackMatrix<double> mat;
     UMFPackVector<double> rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     UMFPackLinearMatrixSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -322,7 +296,7 @@ double* sln;
 #ifdef WITH_UMFPACK
     UMFPackMatrix<double> mat;
     UMFPackVector<double> rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     UMFPackLinearMatrixSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -333,7 +307,7 @@ double* sln;
 #ifdef WITH_TRILINOS
     EpetraMatrix<double> mat;
     EpetraVector<double> rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     AztecOOSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -344,7 +318,7 @@ double* sln;
 #ifdef WITH_TRILINOS
     EpetraMatrix<double> mat;
     EpetraVector<double> rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     AztecOOSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -355,7 +329,7 @@ double* sln;
 #ifdef WITH_TRILINOS
     EpetraMatrix<double> mat;
     EpetraVector<double> rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     if(AmesosSolver<double>::is_available("Klu")) {
       AmesosSolver<double> solver("Klu", &mat, &rhs);
@@ -368,7 +342,7 @@ double* sln;
 #ifdef WITH_TRILINOS
     EpetraMatrix<double> mat;
     EpetraVector<double> rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     if(AmesosSolver<double>::is_available("Klu")) {
       AmesosSolver<double> solver("Klu", &mat, &rhs);
@@ -381,7 +355,7 @@ double* sln;
 #ifdef WITH_MUMPS
     MumpsMatrix<double> mat;
     MumpsVector<double> rhs;
-    build_matrix(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix(system, &mat, &rhs);
 
     MumpsSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -392,7 +366,7 @@ double* sln;
 #ifdef WITH_MUMPS
     MumpsMatrix<double> mat;
     MumpsVector<double> rhs;
-    build_matrix_block(n, ar_mat, ar_rhs, &mat, &rhs);
+    build_matrix_block(system, &mat, &rhs);
 
     MumpsSolver<double> solver(&mat, &rhs);
     solve(solver, n);
@@ -1,5 +1,6 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "allocation_counter.h"
 
 // This example shows how to solve a simple PDE that describes stationary
 // heat transfer in an object consisting of two materials (aluminum and
@@ -23,6 +24,12 @@
 //
 // Geometry: L-Shape domain (see file domain.mesh).
 //
+// Usage:
+//   01-memory-simple [P_INIT INIT_REF_NUM [BASELINE]] [record]
+// When built with WITH_ALLOCATION_COUNTER, the allocations of the individual phases are checked
+// against BASELINE ('allocation-baseline.txt' by default, the test passes the one in the source
+// directory), "record" overwrites the baseline with the current values.
+//
 // The following parameters can be changed:
 
 const bool HERMES_VISUALIZATION = true;           // Set to "false" to suppress Hermes OpenGL visualization.
@@ -38,12 +45,19 @@ const double FIXED_BDY_TEMP = 20.0;        // Fixed temperature on the boundary.
 
 int main(int argc, char* argv[])
 {
+  bool record = argc > 1 && strcmp(argv[argc - 1], "record") == 0;
+  if(record)
+    argc--;
+
+  const char* baseline = "allocation-baseline.txt";
   if(argc > 1)
     {
-      if(argc > 2)
+      if(argc == 3 || argc == 4)
       {
         P_INIT = atoi(argv[1]);
         INIT_REF_NUM = atoi(argv[2]);
+        if(argc == 4)
+          baseline = argv[3];
       }
       else
       {
@@ -52,6 +66,9 @@ int main(int argc, char* argv[])
       }
     }
 
+  AllocationCounter counter("01-memory-simple");
+  counter.begin();
+
   Hermes::Hermes2D::H1Space<double>* space = NULL;
   Hermes::Hermes2D::Mesh* mesh = new Mesh();
 
@@ -86,6 +103,7 @@ wf.set_verbose_output(false);
     // Create an H1 space with default shapeset.
     space = new Hermes::Hermes2D::H1Space<double>(mesh, &bcs, P_INIT);
   }
+  counter.tick("space creation");
 
   Mesh* new_mesh = new Mesh();
   H1Space<double>* new_space = new H1Space<double>();
@@ -93,6 +111,7 @@ wf.set_verbose_output(false);
 
   delete space;
   delete mesh;
+  counter.tick("space copy");
 
   Hermes::Hermes2D::Element* e;
   int i = 1;
@@ -100,6 +119,7 @@ wf.set_verbose_output(false);
   {
     new_space->set_element_order(e->id, i++ % 4 + 1);
   }
+  counter.tick("element orders");
 
   // Initialize the solution.
   Hermes::Hermes2D::Solution<double>* sln = new Hermes::Hermes2D::Solution<double>();
@@ -123,16 +143,25 @@ linear_solver.set_verbose_output(false);
   {
     std::cout << e.what();
   }
+  counter.tick("solve");
 
   Views::Linearizer* lin = new Views::Linearizer();
   lin->process_solution(sln);
   lin->free();
   lin->process_solution(sln);
   lin->free();
+  counter.tick("linearization");
 
   delete sln;
   delete new_space;
   delete new_mesh;
+  counter.tick("cleanup");
 
-  return 0;
+  counter.print_summary();
+  if(record)
+  {
+    counter.save(baseline);
+    return 0;
+  }
+  return counter.check(baseline) ? 0 : -1;
 }
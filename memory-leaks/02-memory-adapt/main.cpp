@@ -1,5 +1,6 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "allocation_counter.h"
 
 using namespace RefinementSelectors;
 
@@ -79,8 +80,21 @@ const double VOLTAGE = 50.0;
 const double EPS_MOTOR = 10.0 * EPS0;
 const double EPS_AIR = 1.0 * EPS0;
 
+// Usage:
+//   02-memory-adapt [BASELINE] [record]
+// When built with WITH_ALLOCATION_COUNTER, the allocations of the individual phases are checked
+// against BASELINE ('allocation-baseline.txt' by default, the test passes the one in the source
+// directory), "record" overwrites the baseline with the current values.
 int main(int argc, char* argv[])
 {
+  bool record = argc > 1 && strcmp(argv[argc - 1], "record") == 0;
+  if(record)
+    argc--;
+  const char* baseline = argc > 1 ? argv[1] : "allocation-baseline.txt";
+
+  AllocationCounter counter("02-memory-adapt");
+  counter.begin();
+
 	Hermes2DApi.set_integral_param_value(numThreads, 1);
 
   // Load the mesh.
@@ -121,6 +135,7 @@ int main(int argc, char* argv[])
   DiscreteProblem<double> dp(&wf, &space);
   NewtonSolver<double> newton(&dp);
   newton.set_verbose_output(false);
+  counter.tick("initialization");
 
   // Adaptivity loop:
   int as = 1; bool done = false;
@@ -133,9 +148,11 @@ int main(int argc, char* argv[])
     // Construct globally refined mesh and setup fine mesh space.
     Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
     Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
+    counter.tick("reference mesh");
     Space<double>::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
     Space<double>* ref_space = ref_space_creator.create_ref_space();
     int ndof_ref = ref_space->get_num_dofs();
+    counter.tick("reference space");
 
     newton.set_space(ref_space);
 
@@ -150,12 +167,15 @@ int main(int argc, char* argv[])
       std::cout << e.what();
       
     }
+    counter.tick("solve");
 
     // Translate the resulting coefficient vector into the instance of Solution.
     Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+    counter.tick("solution");
     
     // Project the fine mesh solution onto the coarse mesh.
     OGProjection<double> ogProjection; ogProjection.project_global(&space, &ref_sln, &sln);
+    counter.tick("projection");
 
     // Time measurement.
     cpu_time.tick();
@@ -169,6 +189,7 @@ int main(int argc, char* argv[])
 
     // Skip visualization time.
     cpu_time.tick();
+    counter.skip();
 
     // Calculate element errors and total error estimate.
     Adapt<double> adaptivity(&space);
@@ -182,6 +203,7 @@ int main(int argc, char* argv[])
     // their default values, and thus they will not be present in the code explicitly.
     double err_est_rel = adaptivity.calc_err_est(&sln, &ref_sln, solutions_for_adapt,
                          HERMES_TOTAL_ERROR_REL | HERMES_ELEMENT_ERROR_REL) * 100;
+    counter.tick("error estimation");
 
     // Add entry to DOF and CPU convergence graphs.
     cpu_time.tick();    
@@ -192,6 +214,7 @@ int main(int argc, char* argv[])
     
     // Skip the time spent to save the convergence graphs.
     cpu_time.tick();
+    counter.skip();
 
     // If err_est too large, adapt the mesh.
     if (err_est_rel < ERR_STOP) 
@@ -206,11 +229,13 @@ int main(int argc, char* argv[])
     }
     if (space.get_num_dofs() >= NDOF_STOP) 
       done = true;
+    counter.tick("adapt");
 
     // Keep the mesh from final step to allow further work with the final fine mesh solution.
     if(done == false) 
       delete ref_space->get_mesh(); 
     delete ref_space;
+    counter.tick("cleanup");
   }
   while (done == false);
 
@@ -227,7 +252,17 @@ int main(int argc, char* argv[])
 if(HERMES_VISUALIZATION)
   Views::View::wait();
 
+  counter.skip();
+
   delete ref_sln.get_mesh();
-  return 0;
+  counter.tick("cleanup");
+
+  counter.print_summary();
+  if(record)
+  {
+    counter.save(baseline);
+    return 0;
+  }
+  return counter.check(baseline) ? 0 : -1;
 }
 
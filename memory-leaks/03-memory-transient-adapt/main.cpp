@@ -1,6 +1,7 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "allocation_counter.h"
 
 using namespace RefinementSelectors;
 using namespace Views;
@@ -105,8 +106,21 @@ ButcherTableType butcher_table_type = Implicit_RK_1;
 const double alpha = 4.0;                         
 const double heat_src = 1.0;
 
+// Usage:
+//   03-memory-transient-adapt [BASELINE] [record]
+// When built with WITH_ALLOCATION_COUNTER, the allocations of the individual phases are checked
+// against BASELINE ('allocation-baseline.txt' by default, the test passes the one in the source
+// directory), "record" overwrites the baseline with the current values.
 int main(int argc, char* argv[])
 {
+  bool record = argc > 1 && strcmp(argv[argc - 1], "record") == 0;
+  if(record)
+    argc--;
+  const char* baseline = argc > 1 ? argv[1] : "allocation-baseline.txt";
+
+  AllocationCounter counter("03-memory-transient-adapt");
+  counter.begin();
+
   Hermes2DApi.set_integral_param_value(numThreads, 1);
 
   // Choose a Butcher's table or define your own.
@@ -148,6 +162,7 @@ int main(int argc, char* argv[])
   
   // Initialize Runge-Kutta time stepping.
   RungeKutta<double> runge_kutta(&wf, &space, &bt);
+  counter.tick("initialization");
       
   // Time stepping loop.
   double current_time = 0; int ts = 1;
@@ -171,6 +186,7 @@ int main(int argc, char* argv[])
 
       space.assign_dofs();
       ndof_coarse = Space<double>::get_num_dofs(&space);
+      counter.tick("derefinement");
     }
 
     // Spatial adaptivity loop. Note: sln_time_prev must not be changed 
@@ -183,9 +199,11 @@ int main(int argc, char* argv[])
       // Construct globally refined reference mesh and setup reference space.
       Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
 		  Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
+      counter.tick("reference mesh");
 		  Space<double>::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
 		  Space<double>* ref_space = ref_space_creator.create_ref_space();
       int ndof_ref = Space<double>::get_num_dofs(ref_space);
+      counter.tick("reference space");
 
       // Perform one Runge-Kutta time step according to the selected Butcher's table.
       try
@@ -200,16 +218,19 @@ int main(int argc, char* argv[])
       {
         std::cout << e.what();
       }
+      counter.tick("time step");
 
       // Project the fine mesh solution onto the coarse mesh.
       Solution<double> sln_coarse;
       Hermes::Mixins::Loggable::Static::info("Projecting fine mesh solution on coarse mesh for error estimation.");
       OGProjection<double> ogProjection; ogProjection.project_global(&space, &sln_time_new, &sln_coarse); 
+      counter.tick("projection");
 
       // Calculate element errors and total error estimate.
       Hermes::Mixins::Loggable::Static::info("Calculating error estimate.");
       Adapt<double>* adaptivity = new Adapt<double>(&space);
       double err_est_rel_total = adaptivity->calc_err_est(&sln_coarse, &sln_time_new) * 100;
+      counter.tick("error estimation");
 
       // Report results.
       Hermes::Mixins::Loggable::Static::info("ndof_coarse: %d, ndof_ref: %d, err_est_rel: %g%%", 
@@ -228,18 +249,21 @@ int main(int argc, char* argv[])
           // Increase the counter of performed adaptivity steps.
           as++;
       }
+      counter.tick("adapt");
       
       // Clean up.
       delete adaptivity;
       if(!done)
         delete sln_time_new.get_mesh();
       delete ref_space;
+      counter.tick("cleanup");
     }
     while (done == false);
 
     if(ts > 1)
       delete sln_time_prev.get_mesh();
     sln_time_prev.copy(&sln_time_new);
+    counter.tick("solution copy");
 
     // Increase current time and counter of time steps.
     current_time += time_step;
@@ -247,5 +271,11 @@ int main(int argc, char* argv[])
   }
   while (current_time < T_FINAL);
 
-  return 0;
+  counter.print_summary();
+  if(record)
+  {
+    counter.save(baseline);
+    return 0;
+  }
+  return counter.check(baseline) ? 0 : -1;
 }
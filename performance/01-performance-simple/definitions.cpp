@@ -2,16 +2,64 @@
 
 /* Weak forms */
 
-CustomWeakFormPoisson::CustomWeakFormPoisson(std::string mat_al, Hermes1DFunction<double>* lambda_al,
-                                             std::string mat_cu, Hermes1DFunction<double>* lambda_cu,
+CustomWeakFormPoisson::CustomWeakFormPoisson(const MarkerIndex& index, std::string mat_al, double lambda_al,
+                                             std::string mat_cu, double lambda_cu,
                                              Hermes2DFunction<double>* src_term) : WeakForm<double>(1)
 {
+  std::map<std::string, double> conductivities;
+  conductivities[mat_al] = lambda_al;
+  conductivities[mat_cu] = lambda_cu;
+  std::vector<double> lambda = index.get_area_values(conductivities, 0.0);
+
   // Jacobian forms.
-  add_matrix_form(new DefaultJacobianDiffusion<double>(0, 0, mat_al, lambda_al));
-  add_matrix_form(new DefaultJacobianDiffusion<double>(0, 0, mat_cu, lambda_cu));
+  add_matrix_form(new CustomJacobianDiffusion(lambda));
 
   // Residual forms.
-  add_vector_form(new DefaultResidualDiffusion<double>(0, mat_al, lambda_al));
-  add_vector_form(new DefaultResidualDiffusion<double>(0, mat_cu, lambda_cu));
+  add_vector_form(new CustomResidualDiffusion(lambda));
   add_vector_form(new DefaultVectorFormVol<double>(0, HERMES_ANY, src_term));
 };
+
+CustomWeakFormPoisson::CustomJacobianDiffusion::CustomJacobianDiffusion(const std::vector<double>& lambda)
+  : MatrixFormVol<double>(0, 0), lambda(lambda)
+{
+  this->sym = HERMES_SYM;
+}
+
+double CustomWeakFormPoisson::CustomJacobianDiffusion::value(int n, double *wt, Func<double> *u_ext[], Func<double> *u,
+                                                             Func<double> *v, Geom<double> *e, Func<double> **ext) const
+{
+  return lambda[e->elem_marker] * int_grad_u_grad_v<double, double>(n, wt, u, v);
+}
+
+Ord CustomWeakFormPoisson::CustomJacobianDiffusion::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u,
+                                                        Func<Ord> *v, Geom<Ord> *e, Func<Ord> **ext) const
+{
+  return int_grad_u_grad_v<Ord, Ord>(n, wt, u, v);
+}
+
+MatrixFormVol<double>* CustomWeakFormPoisson::CustomJacobianDiffusion::clone() const
+{
+  return new CustomJacobianDiffusion(this->lambda);
+}
+
+CustomWeakFormPoisson::CustomResidualDiffusion::CustomResidualDiffusion(const std::vector<double>& lambda)
+  : VectorFormVol<double>(0), lambda(lambda)
+{
+}
+
+double CustomWeakFormPoisson::CustomResidualDiffusion::value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                                                             Geom<double> *e, Func<double> **ext) const
+{
+  return lambda[e->elem_marker] * int_grad_u_grad_v<double, double>(n, wt, u_ext[0], v);
+}
+
+Ord CustomWeakFormPoisson::CustomResidualDiffusion::ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                                                        Geom<Ord> *e, Func<Ord> **ext) const
+{
+  return int_grad_u_grad_v<Ord, Ord>(n, wt, u_ext[0], v);
+}
+
+VectorFormVol<double>* CustomWeakFormPoisson::CustomResidualDiffusion::clone() const
+{
+  return new CustomResidualDiffusion(this->lambda);
+}
@@ -1,4 +1,5 @@
 #include "hermes2d.h"
+#include "marker_index.h"
 
 using namespace Hermes;
 using namespace Hermes::Hermes2D;
@@ -7,10 +8,47 @@ using namespace Hermes::Hermes2D::Views;
 
 /* Weak forms */
 
+// The conductivities of both materials are in one Jacobian and one residual form over HERMES_ANY,
+// looked up by the area marker of the element (see MarkerIndex::get_area_values()), instead of
+// a pair of forms restricted to each material.
 class CustomWeakFormPoisson : public WeakForm<double>
 {
 public:
-  CustomWeakFormPoisson(std::string mat_al, Hermes1DFunction<double>* lambda_al,
-                        std::string mat_cu, Hermes1DFunction<double>* lambda_cu,
-                        Hermes2DFunction<double>* src_term);
+  CustomWeakFormPoisson(const MarkerIndex& index, std::string mat_al, double lambda_al,
+                        std::string mat_cu, double lambda_cu, Hermes2DFunction<double>* src_term);
+
+private:
+  class CustomJacobianDiffusion : public MatrixFormVol<double>
+  {
+  public:
+    CustomJacobianDiffusion(const std::vector<double>& lambda);
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *u, Func<double> *v,
+                         Geom<double> *e, Func<double> **ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *u, Func<Ord> *v,
+                    Geom<Ord> *e, Func<Ord> **ext) const;
+
+    virtual MatrixFormVol<double>* clone() const;
+
+    // Conductivity per internal area marker.
+    std::vector<double> lambda;
+  };
+
+  class CustomResidualDiffusion : public VectorFormVol<double>
+  {
+  public:
+    CustomResidualDiffusion(const std::vector<double>& lambda);
+
+    virtual double value(int n, double *wt, Func<double> *u_ext[], Func<double> *v,
+                         Geom<double> *e, Func<double> **ext) const;
+
+    virtual Ord ord(int n, double *wt, Func<Ord> *u_ext[], Func<Ord> *v,
+                    Geom<Ord> *e, Func<Ord> **ext) const;
+
+    virtual VectorFormVol<double>* clone() const;
+
+    // Conductivity per internal area marker.
+    std::vector<double> lambda;
+  };
 };
@@ -1,5 +1,7 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "benchmark.h"
+#include "thread_scaling.h"
 
 // This example shows how to solve a simple PDE that describes stationary
 // heat transfer in an object consisting of two materials (aluminum and
@@ -23,12 +25,32 @@
 //
 // Geometry: L-Shape domain (see file domain.mesh).
 //
+// Usage: 01-performance-simple [P_INIT INIT_REF_NUM [benchmark RUNS]]
+//        01-performance-simple P_INIT INIT_REF_NUM threads RUNS
+//        01-performance-simple sweep P_MAX REF_MAX [RUNS]
+//
+// In the benchmark mode, the computation is repeated RUNS times and the wall-clock
+// times of its phases are saved to 01-performance-simple-benchmark.json and .csv.
+//
+// The threads mode runs the benchmark with 1, 2, 4, ... threads up to the number
+// of cores and saves the speedups and parallel efficiencies of the phases to
+// 01-performance-simple-threads.csv.
+//
+// The sweep mode runs the benchmark for all P_INIT = 1, ..., P_MAX and
+// INIT_REF_NUM = 0, ..., REF_MAX with uniform polynomial degrees, reports the
+// assembly and solve throughputs in DOFs/s and nonzeros/s and points out where
+// the times grow faster than the number of nonzeros. The results are saved to
+// 01-performance-simple-sweep.dat and .csv.
+//
 // The following parameters can be changed:
 
 const bool HERMES_VISUALIZATION = true;           // Set to "false" to suppress Hermes OpenGL visualization.
 const bool VTK_VISUALIZATION = false;              // Set to "true" to enable VTK output.
 int P_INIT = 2;                             // Uniform polynomial degree of mesh elements.
 int INIT_REF_NUM = 1;                       // Number of initial uniform mesh refinements.
+int NUM_THREADS = 8;                        // Number of threads used in Hermes.
+bool VARIABLE_ORDERS = true;                // Set to "false" to keep the uniform degree P_INIT (done in the sweep mode).
+const double SUPERLINEAR_EXPONENT = 1.2;   // Scaling exponent (w.r.t. nonzeros) reported as superlinear in the sweep mode.
 
 // Problem parameters.
 const double LAMBDA_AL = 236.0;            // Thermal cond. of Al for temperatures around 20 deg Celsius.
@@ -36,21 +58,9 @@ const double LAMBDA_CU = 386.0;            // Thermal cond. of Cu for temperatur
 const double VOLUME_HEAT_SRC = 5e2;        // Volume heat sources generated (for example) by electric current.
 const double FIXED_BDY_TEMP = 20.0;        // Fixed temperature on the boundary.
 
-int main(int argc, char* argv[])
+void solve_problem(Benchmark& benchmark)
 {
-  if(argc > 1)
-    {
-      if(argc > 2)
-      {
-        P_INIT = atoi(argv[1]);
-        INIT_REF_NUM = atoi(argv[2]);
-      }
-      else
-      {
-        std::cout << (std::string)"Wrong number of parameters.";
-        return -1;
-      }
-    }
+  benchmark.begin_run();
 
   Hermes::Hermes2D::H1Space<double>* space = NULL;
   Hermes::Hermes2D::Mesh* mesh = new Mesh();
@@ -60,31 +70,29 @@ int main(int argc, char* argv[])
     FIXED_BDY_TEMP);
   Hermes::Hermes2D::EssentialBCs<double> bcs(&bc_essential);
 
-  // Initialize the weak formulation.
-  CustomWeakFormPoisson wf("Aluminum", new Hermes::Hermes1DFunction<double>(LAMBDA_AL), "Copper",
-    new Hermes::Hermes1DFunction<double>(LAMBDA_CU), new Hermes::Hermes2DFunction<double>(-VOLUME_HEAT_SRC));
-
-wf.set_verbose_output(false);
-  
 	Hermes2DApi.set_text_param_value(xmlSchemasDirPath, "asfd");
 
   // This is in a block to test that the instances mesh and space can be deleted after being copied with no harm.
   {
     // Set the number of threads used in Hermes.
     Hermes::HermesCommonApi.set_integral_param_value(Hermes::exceptionsPrintCallstack, 0);
-    Hermes::Hermes2D::Hermes2DApi.set_integral_param_value(Hermes::Hermes2D::numThreads, 8);
+    Hermes::Hermes2D::Hermes2DApi.set_integral_param_value(Hermes::Hermes2D::numThreads, NUM_THREADS);
+    benchmark.skip();
 
     // Load the mesh.
     Hermes::Hermes2D::MeshReaderH2DXML mloader;
     mloader.set_validation(false);
     mloader.load("domain.xml", mesh);
+    benchmark.tick("mesh load");
 
     // Perform initial mesh refinements (optional).
     mesh->refine_in_areas(Hermes::vector<std::string>("Aluminum", "Copper"), INIT_REF_NUM);
     mesh->refine_in_area("Aluminum");
+    benchmark.tick("refinement");
 
     // Create an H1 space with default shapeset.
     space = new Hermes::Hermes2D::H1Space<double>(mesh, &bcs, P_INIT);
+    benchmark.tick("space creation");
   }
 
   Mesh* new_mesh = new Mesh();
@@ -93,46 +101,221 @@ wf.set_verbose_output(false);
 
   delete space;
   delete mesh;
+  benchmark.tick("space copy");
 
   Hermes::Hermes2D::Element* e;
   int i = 1;
-  for_all_active_elements(e, new_mesh)
+  if(VARIABLE_ORDERS)
   {
-    new_space->set_element_order(e->id, i++ % 4 + 1);
+    for_all_active_elements(e, new_mesh)
+    {
+      new_space->set_element_order(e->id, i++ % 4 + 1);
+    }
   }
+  new_space->assign_dofs();
+  benchmark.tick("assign dofs");
 
   // Initialize the solution.
   Hermes::Hermes2D::Solution<double>* sln = new Hermes::Hermes2D::Solution<double>();
 
-  // Initialize linear solver.
-  Hermes::Hermes2D::LinearSolver<double> linear_solver(&wf, new_space);
-linear_solver.set_verbose_output(false);
+  // Initialize the weak formulation, with the conductivities per area marker of the mesh.
+  MarkerIndex index;
+  index.update(new_mesh);
+  CustomWeakFormPoisson wf(index, "Aluminum", LAMBDA_AL, "Copper", LAMBDA_CU,
+    new Hermes::Hermes2DFunction<double>(-VOLUME_HEAT_SRC));
+  wf.set_verbose_output(false);
+
+  // Initialize the discrete problem, the matrix and the linear solver;
+  // assembling and solving are done separately to measure them separately.
+  Hermes::Hermes2D::DiscreteProblemLinear<double> dp(&wf, new_space);
+  Hermes::Algebra::UMFPackMatrix<double> matrix;
+  Hermes::Algebra::UMFPackVector<double> rhs;
+  Hermes::Solvers::UMFPackLinearMatrixSolver<double> matrix_solver(&matrix, &rhs);
+  benchmark.skip();
 
   // Solve the linear problem.
   try
   {
-    linear_solver.solve();
+    dp.assemble(&matrix, &rhs);
+    benchmark.tick("assembly");
+
+    matrix_solver.solve();
+    benchmark.tick("solve");
 
     // Get the solution vector.
-    double* sln_vector = linear_solver.get_sln_vector();
+    double* sln_vector = matrix_solver.get_sln_vector();
 
     // Translate the solution vector into the previously initialized Solution.
     Hermes::Hermes2D::Solution<double>::vector_to_solution(sln_vector, new_space, sln);
+    benchmark.tick("solution");
   }
   catch(std::exception& e)
   {
     std::cout << e.what();
   }
 
+  benchmark.set_metric("ndof", new_space->get_num_dofs());
+  benchmark.set_metric("nnz", matrix.get_nnz());
+  benchmark.set_metric("elements", new_mesh->get_num_active_elements());
+  benchmark.skip();
+
   Views::Linearizer* lin = new Views::Linearizer();
   lin->process_solution(sln);
   lin->free();
   lin->process_solution(sln);
   lin->free();
+  benchmark.tick("linearization");
 
   delete sln;
   delete new_space;
   delete new_mesh;
+}
+
+// Exponent q in t ~ nnz^q between two points of the sweep, zero if it cannot be determined.
+double scaling_exponent(double time_1, double time_2, double nnz_1, double nnz_2)
+{
+  if(time_1 <= 0.0 || time_2 <= 0.0 || nnz_2 <= nnz_1)
+    return 0.0;
+  return std::log(time_2 / time_1) / std::log(nnz_2 / nnz_1);
+}
+
+// Reports and records the scaling between two neighbouring points of the sweep.
+void check_scaling(BenchmarkTable& table, const char* phase, const char* direction, double exponent, int p, int ref)
+{
+  std::string column = std::string(phase) + " exponent " + direction;
+  table.set(column, exponent);
+  if(exponent > SUPERLINEAR_EXPONENT)
+    printf("Superlinear %s scaling in %s at p = %d, ref = %d: time ~ nnz^%.2f.\n", phase, direction, p, ref, exponent);
+}
+
+void sweep(int p_max, int ref_max, int runs)
+{
+  VARIABLE_ORDERS = false;
+  BenchmarkTable table;
+
+  // Results of the previous refinement level, per polynomial degree.
+  std::vector<double> prev_ref_assembly(p_max + 1, 0.0), prev_ref_solve(p_max + 1, 0.0), prev_ref_nnz(p_max + 1, 0.0);
+
+  printf("%4s %4s %10s %12s %12s %12s %14s %14s %14s %14s\n", "p", "ref", "ndof", "nnz", "assembly[s]", "solve[s]",
+    "asm[DOFs/s]", "asm[nnz/s]", "solve[DOFs/s]", "solve[nnz/s]");
+  for(int ref = 0; ref <= ref_max; ref++)
+  {
+    double prev_p_assembly = 0.0, prev_p_solve = 0.0, prev_p_nnz = 0.0;
+    for(int p = 1; p <= p_max; p++)
+    {
+      P_INIT = p;
+      INIT_REF_NUM = ref;
+      Benchmark benchmark("01-performance-simple");
+      for(int run = 0; run < runs; run++)
+        solve_problem(benchmark);
+
+      double assembly = benchmark.get_statistics("assembly").median;
+      double solve = benchmark.get_statistics("solve").median;
+      double ndof = benchmark.get_metric_statistics("ndof").median;
+      double nnz = benchmark.get_metric_statistics("nnz").median;
+
+      table.begin_row();
+      table.set("p", p);
+      table.set("ref", ref);
+      table.set("ndof", ndof);
+      table.set("nnz", nnz);
+      table.set("assembly", assembly);
+      table.set("solve", solve);
+      table.set("assembly DOFs/s", assembly > 0.0 ? ndof / assembly : 0.0);
+      table.set("assembly nnz/s", assembly > 0.0 ? nnz / assembly : 0.0);
+      table.set("solve DOFs/s", solve > 0.0 ? ndof / solve : 0.0);
+      table.set("solve nnz/s", solve > 0.0 ? nnz / solve : 0.0);
+      printf("%4d %4d %10g %12g %12.6f %12.6f %14g %14g %14g %14g\n", p, ref, ndof, nnz, assembly, solve,
+        table.get(table.get_num_rows() - 1, "assembly DOFs/s"), table.get(table.get_num_rows() - 1, "assembly nnz/s"),
+        table.get(table.get_num_rows() - 1, "solve DOFs/s"), table.get(table.get_num_rows() - 1, "solve nnz/s"));
+
+      if(p > 1)
+      {
+        check_scaling(table, "assembly", "p", scaling_exponent(prev_p_assembly, assembly, prev_p_nnz, nnz), p, ref);
+        check_scaling(table, "solve", "p", scaling_exponent(prev_p_solve, solve, prev_p_nnz, nnz), p, ref);
+      }
+      if(ref > 0)
+      {
+        check_scaling(table, "assembly", "ref", scaling_exponent(prev_ref_assembly[p], assembly, prev_ref_nnz[p], nnz), p, ref);
+        check_scaling(table, "solve", "ref", scaling_exponent(prev_ref_solve[p], solve, prev_ref_nnz[p], nnz), p, ref);
+      }
+
+      prev_p_assembly = prev_ref_assembly[p] = assembly;
+      prev_p_solve = prev_ref_solve[p] = solve;
+      prev_p_nnz = prev_ref_nnz[p] = nnz;
+
+      table.save("01-performance-simple-sweep.dat");
+      table.save_csv("01-performance-simple-sweep.csv");
+    }
+  }
+}
+
+void thread_scaling(int runs)
+{
+  ThreadScaling thread_scaling("01-performance-simple");
+  std::vector<int> thread_counts = ThreadScaling::get_thread_counts();
+  for(unsigned int i = 0; i < thread_counts.size(); i++)
+  {
+    NUM_THREADS = thread_counts[i];
+    Benchmark benchmark("01-performance-simple");
+    for(int run = 0; run < runs; run++)
+      solve_problem(benchmark);
+    thread_scaling.add(NUM_THREADS, benchmark);
+  }
+
+  thread_scaling.print_summary();
+  thread_scaling.save_csv("01-performance-simple-threads.csv");
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1 && strcmp(argv[1], "sweep") == 0)
+  {
+    if(argc != 4 && argc != 5)
+    {
+      std::cout << (std::string)"Wrong parameters.";
+      return -1;
+    }
+    sweep(atoi(argv[2]), atoi(argv[3]), argc > 4 ? atoi(argv[4]) : 1);
+    return 0;
+  }
+
+  bool benchmark_mode = false;
+  int runs = 1;
+  if(argc > 1)
+    {
+      if(argc > 2)
+      {
+        P_INIT = atoi(argv[1]);
+        INIT_REF_NUM = atoi(argv[2]);
+      }
+      if(argc == 5 && strcmp(argv[3], "benchmark") == 0)
+      {
+        benchmark_mode = true;
+        runs = atoi(argv[4]);
+      }
+      else if(argc == 5 && strcmp(argv[3], "threads") == 0)
+      {
+        thread_scaling(atoi(argv[4]));
+        return 0;
+      }
+      else if(argc != 3)
+      {
+        std::cout << (std::string)"Wrong number of parameters.";
+        return -1;
+      }
+    }
+
+  Benchmark benchmark("01-performance-simple");
+  for(int run = 0; run < runs; run++)
+    solve_problem(benchmark);
+
+  if(benchmark_mode)
+  {
+    benchmark.print_summary();
+    benchmark.save_json("01-performance-simple-benchmark.json");
+    benchmark.save_csv("01-performance-simple-benchmark.csv");
+  }
 
   return 0;
 }
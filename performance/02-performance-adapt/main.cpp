@@ -1,5 +1,7 @@
 #define HERMES_REPORT_ALL
 #include "definitions.h"
+#include "benchmark.h"
+#include "thread_scaling.h"
 
 using namespace RefinementSelectors;
 
@@ -31,6 +33,17 @@ using namespace RefinementSelectors;
 // BC: phi = 0 V on Gamma_1 (left edge and also the rest of the outer boundary
 //     phi = VOLTAGE on Gamma_2 (boundary of stator)
 //
+// Usage: 02-performance-adapt [benchmark RUNS | threads RUNS]
+//
+// In the benchmark mode, the computation is repeated RUNS times and the wall-clock
+// times of its phases are saved to 02-performance-adapt-benchmark.json and .csv.
+//
+// The threads mode runs the benchmark with 1, 2, 4, ... threads up to the number
+// of cores and saves the speedups and parallel efficiencies of the phases to
+// 02-performance-adapt-threads.csv.
+// In both modes, the times of the phases in every adaptivity step, together with
+// the numbers of DOFs and elements, are saved as a table to adapt_steps.dat.
+//
 // The following parameters can be changed:
 
 // Set to "false" to suppress Hermes OpenGL visualization. 
@@ -79,14 +92,22 @@ const double VOLTAGE = 50.0;
 const double EPS_MOTOR = 10.0 * EPS0;
 const double EPS_AIR = 1.0 * EPS0;
 
-int main(int argc, char* argv[])
+// Number of threads used in Hermes.
+int NUM_THREADS = 1;
+
+// With benchmark_mode, the factorization and the triangular solves are measured separately
+// (by a repeated solve) and the times of the adaptivity steps are saved in adapt_steps.dat.
+void solve_problem(Benchmark& benchmark, bool benchmark_mode)
 {
-	Hermes2DApi.set_integral_param_value(numThreads, 1);
+  benchmark.begin_run();
+
+	Hermes2DApi.set_integral_param_value(numThreads, NUM_THREADS);
 
   // Load the mesh.
   Mesh mesh;
   MeshReaderH2D mloader;
   mloader.load("domain.mesh", &mesh);
+  benchmark.tick("mesh load");
 
   // Initialize the weak formulation.
   CustomWeakFormPoisson wf("Motor", EPS_MOTOR, "Air", EPS_AIR);
@@ -99,6 +120,7 @@ int main(int argc, char* argv[])
 
   // Create an H1 space with default shapeset.
   H1Space<double> space(&mesh, &bcs, P_INIT);
+  benchmark.tick("space creation");
 
   // Initialize coarse and fine mesh solution.
   Solution<double> sln, ref_sln;
@@ -118,9 +140,20 @@ int main(int argc, char* argv[])
   // Time measurement.
   Hermes::Mixins::TimeMeasurable cpu_time;
 
+  // Per-step table of phase times.
+  BenchmarkTable step_table;
+
+  // The Newton's method is performed by hand here, so that the assembling and
+  // the factorization can be measured separately. The problem is linear, one
+  // step from the zero initial vector gives the solution. In the benchmark mode,
+  // the system is solved a second time with the factorization reused, which gives
+  // the time of the triangular solves ("solve"); the factorization is the rest
+  // of the first solve.
   DiscreteProblem<double> dp(&wf, &space);
-  NewtonSolver<double> newton(&dp);
-  newton.set_verbose_output(false);
+  Hermes::Algebra::UMFPackMatrix<double> jacobian;
+  Hermes::Algebra::UMFPackVector<double> residual;
+  Hermes::Solvers::UMFPackLinearMatrixSolver<double> matrix_solver(&jacobian, &residual);
+  benchmark.skip();
 
   // Adaptivity loop:
   int as = 1; bool done = false;
@@ -132,16 +165,55 @@ int main(int argc, char* argv[])
     // Construct globally refined mesh and setup fine mesh space.
     Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
     Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
+    step_table.begin_row();
+    step_table.set("step", as);
+    step_table.set("reference mesh", benchmark.tick("reference mesh"));
     Space<double>::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
     Space<double>* ref_space = ref_space_creator.create_ref_space();
     int ndof_ref = ref_space->get_num_dofs();
+    step_table.set("reference space", benchmark.tick("reference space"));
 
-    newton.set_space(ref_space);
+    dp.set_space(ref_space);
+    double* coeff_vec = new double[ndof_ref];
+    memset(coeff_vec, 0, ndof_ref * sizeof(double));
+    benchmark.skip();
 
-    // Perform Newton's iteration.
+    // Perform the Newton's step.
     try
     {
-      newton.solve();
+      dp.assemble(coeff_vec, &jacobian, &residual);
+      step_table.set("assembly", benchmark.tick("assembly"));
+
+      residual.change_sign();
+      Hermes::Mixins::TimeMeasurable solve_time;
+      matrix_solver.set_factorization_scheme(Hermes::HERMES_FACTORIZE_FROM_SCRATCH);
+      solve_time.tick();
+      matrix_solver.solve();
+      solve_time.tick();
+      double factorization_and_solve = solve_time.last();
+
+      if(benchmark_mode)
+      {
+        // The repeated solve is not part of the computation (nor of the CPU time graph),
+        // the times of the phases sum up to the first solve.
+        cpu_time.tick();
+        matrix_solver.set_factorization_scheme(Hermes::HERMES_REUSE_FACTORIZATION_COMPLETELY);
+        solve_time.tick();
+        matrix_solver.solve();
+        solve_time.tick();
+        double solve = std::min(solve_time.last(), factorization_and_solve);
+        cpu_time.tick(Hermes::Mixins::HERMES_SKIP);
+        benchmark.skip();
+        benchmark.add("factorization", factorization_and_solve - solve);
+        benchmark.add("solve", solve);
+        step_table.set("factorization", factorization_and_solve - solve);
+        step_table.set("solve", solve);
+      }
+      else
+        step_table.set("factorization and solve", benchmark.tick("factorization and solve"));
+
+      for (int i = 0; i < ndof_ref; i++)
+        coeff_vec[i] += matrix_solver.get_sln_vector()[i];
     }
     catch(std::exception& e)
     {
@@ -149,10 +221,13 @@ int main(int argc, char* argv[])
     }
 
     // Translate the resulting coefficient vector into the instance of Solution.
-    Solution<double>::vector_to_solution(newton.get_sln_vector(), ref_space, &ref_sln);
+    Solution<double>::vector_to_solution(coeff_vec, ref_space, &ref_sln);
+    delete [] coeff_vec;
+    step_table.set("solution", benchmark.tick("solution"));
     
     // Project the fine mesh solution onto the coarse mesh.
     OGProjection<double> ogProjection; ogProjection.project_global(&space, &ref_sln, &sln);
+    step_table.set("projection", benchmark.tick("projection"));
 
     // Time measurement.
     cpu_time.tick();
@@ -166,6 +241,7 @@ int main(int argc, char* argv[])
 
     // Skip visualization time.
     cpu_time.tick();
+    benchmark.skip();
 
     // Calculate element errors and total error estimate.
     Adapt<double> adaptivity(&space);
@@ -179,6 +255,7 @@ int main(int argc, char* argv[])
     // their default values, and thus they will not be present in the code explicitly.
     double err_est_rel = adaptivity.calc_err_est(&sln, &ref_sln, solutions_for_adapt,
                          HERMES_TOTAL_ERROR_REL | HERMES_ELEMENT_ERROR_REL) * 100;
+    step_table.set("error estimation", benchmark.tick("error estimation"));
 
     // Add entry to DOF and CPU convergence graphs.
     cpu_time.tick();    
@@ -189,6 +266,15 @@ int main(int argc, char* argv[])
     
     // Skip the time spent to save the convergence graphs.
     cpu_time.tick();
+    benchmark.skip();
+
+    // Sizes of the problem in this step (before adapting).
+    step_table.set("ndof", space.get_num_dofs());
+    step_table.set("ndof reference", ndof_ref);
+    step_table.set("elements", mesh.get_num_active_elements());
+    step_table.set("elements reference", ref_mesh->get_num_active_elements());
+    step_table.set("error estimate", err_est_rel);
+    benchmark.skip();
 
     // If err_est too large, adapt the mesh.
     if (err_est_rel < ERR_STOP) 
@@ -196,6 +282,7 @@ int main(int argc, char* argv[])
     else
     {
       done = adaptivity.adapt(&selector, THRESHOLD, STRATEGY, MESH_REGULARITY);
+      step_table.set("adapt", benchmark.tick("adapt"));
 
       // Increase the counter of performed adaptivity steps.
       if (done == false)  
@@ -204,13 +291,22 @@ int main(int argc, char* argv[])
     if (space.get_num_dofs() >= NDOF_STOP) 
       done = true;
 
+    benchmark.set_metric("adaptivity steps", as);
+    benchmark.set_metric("ndof", space.get_num_dofs());
+    benchmark.set_metric("ndof reference", ndof_ref);
+    benchmark.skip();
+
     // Keep the mesh from final step to allow further work with the final fine mesh solution.
     if(done == false) 
       delete ref_space->get_mesh(); 
     delete ref_space;
+    step_table.set("cleanup", benchmark.tick("cleanup"));
   }
   while (done == false);
 
+  if(benchmark_mode)
+    step_table.save("adapt_steps.dat");
+
 
   // Show the fine mesh solution - final result.
 	if(HERMES_VISUALIZATION)
@@ -223,8 +319,60 @@ int main(int argc, char* argv[])
   // Wait for all views to be closed.
 if(HERMES_VISUALIZATION)
   Views::View::wait();
+  benchmark.skip();
 
   delete ref_sln.get_mesh();
+  benchmark.tick("cleanup");
+}
+
+void thread_scaling(int runs)
+{
+  ThreadScaling thread_scaling("02-performance-adapt");
+  std::vector<int> thread_counts = ThreadScaling::get_thread_counts();
+  for(unsigned int i = 0; i < thread_counts.size(); i++)
+  {
+    NUM_THREADS = thread_counts[i];
+    Benchmark benchmark("02-performance-adapt");
+    for(int run = 0; run < runs; run++)
+      solve_problem(benchmark, true);
+    thread_scaling.add(NUM_THREADS, benchmark);
+  }
+
+  thread_scaling.print_summary();
+  thread_scaling.save_csv("02-performance-adapt-threads.csv");
+}
+
+int main(int argc, char* argv[])
+{
+  bool benchmark_mode = false;
+  int runs = 1;
+  if(argc == 3 && strcmp(argv[1], "benchmark") == 0)
+  {
+    benchmark_mode = true;
+    runs = atoi(argv[2]);
+  }
+  else if(argc == 3 && strcmp(argv[1], "threads") == 0)
+  {
+    thread_scaling(atoi(argv[2]));
+    return 0;
+  }
+  else if(argc != 1)
+  {
+    std::cout << (std::string)"Wrong number of parameters.";
+    return -1;
+  }
+
+  Benchmark benchmark("02-performance-adapt");
+  for(int run = 0; run < runs; run++)
+    solve_problem(benchmark, benchmark_mode);
+
+  if(benchmark_mode)
+  {
+    benchmark.print_summary();
+    benchmark.save_json("02-performance-adapt-benchmark.json");
+    benchmark.save_csv("02-performance-adapt-benchmark.csv");
+  }
+
   return 0;
 }
 
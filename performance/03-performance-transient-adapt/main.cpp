@@ -1,6 +1,8 @@
 #define HERMES_REPORT_ALL
 #define HERMES_REPORT_FILE "application.log"
 #include "definitions.h"
+#include "benchmark.h"
+#include "thread_scaling.h"
 
 using namespace RefinementSelectors;
 using namespace Views;
@@ -23,6 +25,15 @@ using namespace Views;
 //
 //  IC: Custom initial condition matching the BC.
 //
+//  Usage: 03-performance-transient-adapt [benchmark RUNS | threads RUNS]
+//
+//  In the benchmark mode, the computation is repeated RUNS times and the wall-clock
+//  times of its phases are saved to 03-performance-transient-adapt-benchmark.json and .csv.
+//
+//  The threads mode runs the benchmark with 1, 2, 4, ... threads up to the number
+//  of cores and saves the speedups and parallel efficiencies of the phases to
+//  03-performance-transient-adapt-threads.csv.
+//
 //  The following parameters can be changed:
 
 // Number of initial uniform mesh refinements.
@@ -105,9 +116,14 @@ ButcherTableType butcher_table_type = Implicit_RK_1;
 const double alpha = 4.0;                         
 const double heat_src = 1.0;
 
-int main(int argc, char* argv[])
+// Number of threads used in Hermes.
+int NUM_THREADS = 1;
+
+void solve_problem(Benchmark& benchmark)
 {
-  Hermes2DApi.set_integral_param_value(numThreads, 1);
+  benchmark.begin_run();
+
+  Hermes2DApi.set_integral_param_value(numThreads, NUM_THREADS);
 
   // Choose a Butcher's table or define your own.
   ButcherTable bt(butcher_table_type);
@@ -115,14 +131,18 @@ int main(int argc, char* argv[])
   if (bt.is_diagonally_implicit()) Hermes::Mixins::Loggable::Static::info("Using a %d-stage diagonally implicit R-K method.", bt.get_size());
   if (bt.is_fully_implicit()) Hermes::Mixins::Loggable::Static::info("Using a %d-stage fully implicit R-K method.", bt.get_size());
 
+  benchmark.skip();
+
   // Load the mesh.
   Mesh mesh, basemesh;
   MeshReaderH2D mloader;
   mloader.load("square.mesh", &basemesh);
+  benchmark.tick("mesh load");
 
   // Perform initial mesh refinements.
   for(int i = 0; i < INIT_REF_NUM; i++) basemesh.refine_all_elements(0, true);
   mesh.copy(&basemesh);
+  benchmark.tick("refinement");
   
   // Initialize boundary conditions.
   EssentialBCNonConst bc_essential("Bdy");
@@ -131,6 +151,7 @@ int main(int argc, char* argv[])
   // Create an H1 space with default shapeset.
   H1Space<double> space(&mesh, &bcs, P_INIT);
   int ndof_coarse = space.get_num_dofs();
+  benchmark.tick("space creation");
 
   // Previous time level solution (initialized by initial condition).
   CustomInitialCondition sln_time_prev(&mesh);
@@ -148,6 +169,7 @@ int main(int argc, char* argv[])
   
   // Initialize Runge-Kutta time stepping.
   RungeKutta<double> runge_kutta(&wf, &space, &bt);
+  benchmark.skip();
       
   // Time stepping loop.
   double current_time = 0; int ts = 1;
@@ -168,9 +190,11 @@ int main(int argc, char* argv[])
                 space.adjust_element_order(-1, -1, P_INIT, P_INIT);
                 break;
       }
+      benchmark.tick("refinement");
 
       space.assign_dofs();
       ndof_coarse = Space<double>::get_num_dofs(&space);
+      benchmark.tick("assign dofs");
     }
 
     // Spatial adaptivity loop. Note: sln_time_prev must not be changed 
@@ -183,9 +207,11 @@ int main(int argc, char* argv[])
       // Construct globally refined reference mesh and setup reference space.
       Mesh::ReferenceMeshCreator ref_mesh_creator(&mesh);
 		  Mesh* ref_mesh = ref_mesh_creator.create_ref_mesh();
+      benchmark.tick("reference mesh");
 		  Space<double>::ReferenceSpaceCreator ref_space_creator(&space, ref_mesh);
 		  Space<double>* ref_space = ref_space_creator.create_ref_space();
       int ndof_ref = Space<double>::get_num_dofs(ref_space);
+      benchmark.tick("reference space");
 
       // Perform one Runge-Kutta time step according to the selected Butcher's table.
       try
@@ -200,20 +226,24 @@ int main(int argc, char* argv[])
       {
         std::cout << e.what();
       }
+      benchmark.tick("time step");
 
       // Project the fine mesh solution onto the coarse mesh.
       Solution<double> sln_coarse;
       Hermes::Mixins::Loggable::Static::info("Projecting fine mesh solution on coarse mesh for error estimation.");
       OGProjection<double> ogProjection; ogProjection.project_global(&space, &sln_time_new, &sln_coarse); 
+      benchmark.tick("projection");
 
       // Calculate element errors and total error estimate.
       Hermes::Mixins::Loggable::Static::info("Calculating error estimate.");
       Adapt<double>* adaptivity = new Adapt<double>(&space);
       double err_est_rel_total = adaptivity->calc_err_est(&sln_coarse, &sln_time_new) * 100;
+      benchmark.tick("error estimation");
 
       // Report results.
       Hermes::Mixins::Loggable::Static::info("ndof_coarse: %d, ndof_ref: %d, err_est_rel: %g%%", 
            Space<double>::get_num_dofs(&space), Space<double>::get_num_dofs(ref_space), err_est_rel_total);
+      benchmark.skip();
 
       // If err_est too large, adapt the mesh.
       if (err_est_rel_total < ERR_STOP) done = true;
@@ -221,6 +251,7 @@ int main(int argc, char* argv[])
       {
         Hermes::Mixins::Loggable::Static::info("Adapting the coarse mesh.");
         done = adaptivity->adapt(&selector, THRESHOLD, STRATEGY, MESH_REGULARITY);
+        benchmark.tick("adapt");
 
         if (Space<double>::get_num_dofs(&space) >= NDOF_STOP) 
           done = true;
@@ -240,6 +271,7 @@ int main(int argc, char* argv[])
     if(ts > 1)
       delete sln_time_prev.get_mesh();
     sln_time_prev.copy(&sln_time_new);
+    benchmark.tick("solution copy");
 
     // Increase current time and counter of time steps.
     current_time += time_step;
@@ -247,5 +279,57 @@ int main(int argc, char* argv[])
   }
   while (current_time < T_FINAL);
 
+  benchmark.set_metric("time steps", ts - 1);
+  benchmark.set_metric("ndof", Space<double>::get_num_dofs(&space));
+}
+
+void thread_scaling(int runs)
+{
+  ThreadScaling thread_scaling("03-performance-transient-adapt");
+  std::vector<int> thread_counts = ThreadScaling::get_thread_counts();
+  for(unsigned int i = 0; i < thread_counts.size(); i++)
+  {
+    NUM_THREADS = thread_counts[i];
+    Benchmark benchmark("03-performance-transient-adapt");
+    for(int run = 0; run < runs; run++)
+      solve_problem(benchmark);
+    thread_scaling.add(NUM_THREADS, benchmark);
+  }
+
+  thread_scaling.print_summary();
+  thread_scaling.save_csv("03-performance-transient-adapt-threads.csv");
+}
+
+int main(int argc, char* argv[])
+{
+  bool benchmark_mode = false;
+  int runs = 1;
+  if(argc == 3 && strcmp(argv[1], "benchmark") == 0)
+  {
+    benchmark_mode = true;
+    runs = atoi(argv[2]);
+  }
+  else if(argc == 3 && strcmp(argv[1], "threads") == 0)
+  {
+    thread_scaling(atoi(argv[2]));
+    return 0;
+  }
+  else if(argc != 1)
+  {
+    std::cout << (std::string)"Wrong number of parameters.";
+    return -1;
+  }
+
+  Benchmark benchmark("03-performance-transient-adapt");
+  for(int run = 0; run < runs; run++)
+    solve_problem(benchmark);
+
+  if(benchmark_mode)
+  {
+    benchmark.print_summary();
+    benchmark.save_json("03-performance-transient-adapt-benchmark.json");
+    benchmark.save_csv("03-performance-transient-adapt-benchmark.csv");
+  }
+
   return 0;
 }
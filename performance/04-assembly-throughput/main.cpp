@@ -0,0 +1,483 @@
+#define HERMES_REPORT_ALL
+#include "hermes2d.h"
+#include "benchmark.h"
+#include "allocation_counter.h"
+#include "element_coloring.h"
+#include "thread_scaling.h"
+
+using namespace Hermes::Algebra::DenseMatrixOperations;
+using namespace Hermes::Solvers;
+using namespace Hermes::Hermes2D;
+
+// This test measures the cost of inserting element contributions into a sparse
+// matrix, separately from the evaluation of the weak forms.
+//
+// The assembly lists of the element contributions are those of the spaces of
+//
+//   - simple: 01-performance-simple (one H1 space on domain.xml, Dirichlet
+//     conditions on all boundaries, the refinements of the example),
+//   - navier-stokes: 03-navier-stokes (two H1 velocities of degree p and an L2
+//     pressure of degree p - 1 on domain.mesh, Dirichlet velocities except on
+//     the outlet, the refinements towards the obstacle and the walls of the
+//     example, the coupling of the Navier-Stokes equations, i.e. no
+//     pressure-pressure block),
+//
+// with INIT_REF_NUM further uniform refinements and the uniform polynomial
+// degrees 1, ..., P_MAX. In the streams with hanging nodes a fraction of the
+// elements is refined once more. The DOFs of the spaces are numbered one after
+// another, the Dirichlet DOFs are negative and skipped as in DiscreteProblem.
+// Each (element, block) contribution is added by SparseMatrix::add(m, n, mat, rows, cols).
+//
+// For every stream, the wall-clock times of the sparsity pattern preallocation
+// (prealloc + pre_add_ij), of alloc(), of the insertion and of finish() are
+// reported, together with the insertion throughput and the memory per nonzero
+// (the CSC storage, and the heap allocated in the pattern and alloc phases when
+// built with WITH_ALLOCATION_COUNTER). The results are saved to
+// 04-assembly-throughput.dat and .csv.
+//
+// The threads mode compares two ways of inserting the contributions by several threads, for
+// both problems with 1, 2, 4, ... MAX_THREADS threads:
+//
+//   - locked: the elements are split among the threads, every insertion is done in a critical
+//     section (the threading of DiscreteProblem),
+//   - colored: the elements are colored so that no two elements of one color share a DOF
+//     (ElementColoring), the colors are inserted one after another, the elements of one color
+//     in parallel without locks.
+//
+// Only the insertion is measured (the local matrices are precomputed), which is the part
+// serialized by the lock. The matrices are compared with the one inserted by one thread and
+// the results are saved to 04-assembly-throughput-threads.dat and .csv.
+//
+// Usage: 04-assembly-throughput [RUNS [INIT_REF_NUM]]
+//        04-assembly-throughput threads [RUNS [INIT_REF_NUM [MAX_THREADS]]]
+//
+// The following parameters can be changed:
+
+int RUNS = 3;                               // Number of runs of each stream, medians are reported.
+int INIT_REF_NUM = 2;                       // Number of uniform mesh refinements after those of the examples.
+const int P_MAX = 8;                        // Maximum polynomial degree.
+const double HANGING_FRACTION = 0.25;       // Fraction of elements refined once more in the streams with hanging nodes.
+int MAX_THREADS = 32;                       // Maximum number of threads in the threads mode.
+
+const int NUM_PROBLEMS = 2;
+const char* PROBLEM_NAMES[NUM_PROBLEMS] = { "simple", "navier-stokes" };
+
+// Stream of element contributions.
+struct ElementStream
+{
+  int ndof;
+  // Assembly lists of the components of the elements, lists[element][component].
+  std::vector<std::vector<std::vector<int> > > lists;
+  // Coupled components (blocks with nonzero forms).
+  std::vector<std::pair<int, int> > blocks;
+};
+
+// True for the elements refined once more, pseudo-randomly spread.
+bool is_hanging(int element, double fraction)
+{
+  return ((unsigned int)element * 2654435761u) % 1000 < fraction * 1000;
+}
+
+// Appends the assembly lists of the active elements of the spaces (on one mesh), the DOFs of every space
+// shifted by the numbers of DOFs of the preceding ones.
+void add_lists(const Hermes::vector<const Space<double>*>& spaces, ElementStream& stream)
+{
+  std::vector<int> offsets(spaces.size(), 0);
+  for(unsigned int i = 1; i < spaces.size(); i++)
+    offsets[i] = offsets[i - 1] + spaces[i - 1]->get_num_dofs();
+  stream.ndof = offsets.back() + spaces.back()->get_num_dofs();
+
+  AsmList<double> al;
+  Element* e;
+  for_all_active_elements(e, spaces[0]->get_mesh())
+  {
+    stream.lists.push_back(std::vector<std::vector<int> >(spaces.size()));
+    for(unsigned int i = 0; i < spaces.size(); i++)
+    {
+      spaces[i]->get_element_assembly_list(e, &al);
+      for(int k = 0; k < al.cnt; k++)
+        stream.lists.back()[i].push_back(al.dof[k] < 0 ? -1 : al.dof[k] + offsets[i]);
+    }
+  }
+}
+
+// Refines the elements selected by is_hanging() once more.
+void refine_hanging(Mesh& mesh, double hanging_fraction)
+{
+  std::vector<int> ids;
+  Element* e;
+  for_all_active_elements(e, &mesh)
+    if(is_hanging(e->id, hanging_fraction))
+      ids.push_back(e->id);
+  for(unsigned int i = 0; i < ids.size(); i++)
+    mesh.refine_element_id(ids[i]);
+}
+
+// Stream of 01-performance-simple (problem 0) or of 03-navier-stokes (problem 1).
+ElementStream create_stream(int problem, int p, double hanging_fraction)
+{
+  ElementStream stream;
+  Mesh mesh;
+  if(problem == 0)
+  {
+    MeshReaderH2DXML mloader;
+    mloader.set_validation(false);
+    mloader.load("domain.xml", &mesh);
+    mesh.refine_in_areas(Hermes::vector<std::string>("Aluminum", "Copper"), 1);
+    mesh.refine_in_area("Aluminum");
+  }
+  else
+  {
+    MeshReaderH2D mloader;
+    mloader.load("domain.mesh", &mesh);
+    mesh.refine_towards_boundary("5", 4, false);
+    mesh.refine_towards_boundary("3", 4, true);
+    mesh.refine_towards_boundary("1", 4, true);
+  }
+  for(int i = 0; i < INIT_REF_NUM; i++)
+    mesh.refine_all_elements();
+  refine_hanging(mesh, hanging_fraction);
+
+  if(problem == 0)
+  {
+    DefaultEssentialBCConst<double> bc(Hermes::vector<std::string>("Bottom", "Inner", "Outer", "Left"), 0.0);
+    EssentialBCs<double> bcs(&bc);
+    H1Space<double> space(&mesh, &bcs, p);
+    add_lists(Hermes::vector<const Space<double>*>(&space), stream);
+    stream.blocks.push_back(std::pair<int, int>(0, 0));
+  }
+  else
+  {
+    // The inlet (4) is a Dirichlet boundary of both velocities, the outlet (2) of none.
+    DefaultEssentialBCConst<double> bc_vel(Hermes::vector<std::string>("4", "1", "3", "5"), 0.0);
+    EssentialBCs<double> bcs_vel(&bc_vel);
+    H1Space<double> xvel_space(&mesh, &bcs_vel, p);
+    H1Space<double> yvel_space(&mesh, &bcs_vel, p);
+    L2Space<double> p_space(&mesh, p - 1);
+    add_lists(Hermes::vector<const Space<double>*>(&xvel_space, &yvel_space, &p_space), stream);
+    for(int i = 0; i < 3; i++)
+      for(int j = 0; j < 3; j++)
+        if(i < 2 || j < 2)
+          stream.blocks.push_back(std::pair<int, int>(i, j));
+  }
+  return stream;
+}
+
+// Local matrix of the given size, reused for all contributions (the values do not matter).
+double** get_local_matrix(std::map<std::pair<int, int>, double**>& local_matrices, int m, int n)
+{
+  std::pair<int, int> size(m, n);
+  std::map<std::pair<int, int>, double**>::iterator it = local_matrices.find(size);
+  if(it != local_matrices.end())
+    return it->second;
+
+  double** local = new_matrix<double>(m, n);
+  for(int i = 0; i < m; i++)
+    for(int j = 0; j < n; j++)
+      local[i][j] = 1.0 / (1.0 + i + j);
+  local_matrices[size] = local;
+  return local;
+}
+
+// Preallocates the sparsity pattern of the stream, returns the number of inserted entries.
+double preallocate(ElementStream& stream, Hermes::Algebra::UMFPackMatrix<double>& matrix)
+{
+  double entries = 0.0;
+  matrix.prealloc(stream.ndof);
+  for(unsigned int e = 0; e < stream.lists.size(); e++)
+    for(unsigned int b = 0; b < stream.blocks.size(); b++)
+    {
+      std::vector<int>& rows = stream.lists[e][stream.blocks[b].first];
+      std::vector<int>& cols = stream.lists[e][stream.blocks[b].second];
+      for(unsigned int i = 0; i < rows.size(); i++)
+      {
+        if(rows[i] < 0)
+          continue;
+        for(unsigned int j = 0; j < cols.size(); j++)
+        {
+          if(cols[j] < 0)
+            continue;
+          matrix.pre_add_ij(rows[i], cols[j]);
+          entries++;
+        }
+      }
+    }
+  return entries;
+}
+
+// Adds all blocks of one element. Only looks up the local matrices if they were created before,
+// so it can be called by several threads.
+void insert_element(ElementStream& stream, int e, std::map<std::pair<int, int>, double**>& local_matrices,
+  Hermes::Algebra::UMFPackMatrix<double>& matrix)
+{
+  for(unsigned int b = 0; b < stream.blocks.size(); b++)
+  {
+    std::vector<int>& rows = stream.lists[e][stream.blocks[b].first];
+    std::vector<int>& cols = stream.lists[e][stream.blocks[b].second];
+    matrix.add(rows.size(), cols.size(), get_local_matrix(local_matrices, rows.size(), cols.size()), &rows[0], &cols[0]);
+  }
+}
+
+void assemble(ElementStream& stream, std::map<std::pair<int, int>, double**>& local_matrices, Benchmark& benchmark)
+{
+  benchmark.begin_run();
+  AllocationCounter counter(benchmark.get_name());
+  counter.begin();
+
+  Hermes::Algebra::UMFPackMatrix<double> matrix;
+
+  // Sparsity pattern.
+  double entries = preallocate(stream, matrix);
+  benchmark.tick("pattern");
+  counter.tick("pattern");
+
+  matrix.alloc();
+  benchmark.tick("alloc");
+  counter.tick("alloc");
+
+  // Insertion of the contributions.
+  for(unsigned int e = 0; e < stream.lists.size(); e++)
+    insert_element(stream, e, local_matrices, matrix);
+  benchmark.tick("insertion");
+
+  matrix.finish();
+  benchmark.tick("finish");
+
+  double nnz = matrix.get_nnz();
+  benchmark.set_metric("ndof", stream.ndof);
+  benchmark.set_metric("nnz", nnz);
+  benchmark.set_metric("entries", entries);
+  benchmark.set_metric("CSC bytes/nnz", ((stream.ndof + 1) * sizeof(int) + nnz * (sizeof(int) + sizeof(double))) / nnz);
+  if(AllocationCounter::is_enabled())
+  {
+    benchmark.set_metric("pattern bytes/nnz", counter.get_phase("pattern").bytes / nnz);
+    benchmark.set_metric("alloc bytes/nnz", counter.get_phase("alloc").bytes / nnz);
+  }
+}
+
+// All DOFs of the elements, for the coloring.
+std::vector<std::vector<int> > get_element_dofs(ElementStream& stream)
+{
+  std::vector<std::vector<int> > element_dofs(stream.lists.size());
+  for(unsigned int e = 0; e < stream.lists.size(); e++)
+    for(unsigned int c = 0; c < stream.lists[e].size(); c++)
+      element_dofs[e].insert(element_dofs[e].end(), stream.lists[e][c].begin(), stream.lists[e][c].end());
+  return element_dofs;
+}
+
+// Inserts the stream by num_threads threads, color by color if coloring is given, with a lock otherwise.
+void insert_threads(ElementStream& stream, std::map<std::pair<int, int>, double**>& local_matrices,
+  const ElementColoring* coloring, int num_threads, Hermes::Algebra::UMFPackMatrix<double>& matrix)
+{
+  if(coloring)
+  {
+    for(int color = 0; color < coloring->get_num_colors(); color++)
+    {
+      const std::vector<int>& elements = coloring->get_elements(color);
+      int count = elements.size();
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+      for(int i = 0; i < count; i++)
+        insert_element(stream, elements[i], local_matrices, matrix);
+    }
+  }
+  else
+  {
+    int count = stream.lists.size();
+#pragma omp parallel for num_threads(num_threads) schedule(static)
+    for(int e = 0; e < count; e++)
+    {
+#pragma omp critical (matrix)
+      insert_element(stream, e, local_matrices, matrix);
+    }
+  }
+}
+
+// Largest difference of the values of two matrices with the same pattern, relative to the largest value.
+double max_difference(Hermes::Algebra::UMFPackMatrix<double>& matrix, Hermes::Algebra::UMFPackMatrix<double>& reference)
+{
+  double difference = 0.0, scale = 0.0;
+  for(unsigned int i = 0; i < reference.get_nnz(); i++)
+  {
+    difference = std::max(difference, std::abs(matrix.get_Ax()[i] - reference.get_Ax()[i]));
+    scale = std::max(scale, std::abs(reference.get_Ax()[i]));
+  }
+  return scale > 0.0 ? difference / scale : difference;
+}
+
+int threads(int runs)
+{
+#ifndef _OPENMP
+  printf("Built without OpenMP, all thread counts run serially.\n");
+#endif
+  std::map<std::pair<int, int>, double**> local_matrices;
+  std::vector<int> thread_counts = ThreadScaling::get_thread_counts(MAX_THREADS);
+  BenchmarkTable table;
+  bool success = true;
+
+  printf("%4s %14s %8s %7s %7s %12s %12s %10s %10s\n", "p", "problem", "hanging", "colors", "threads",
+    "locked[s]", "colored[s]", "speedup", "vs locked");
+  for(int problem = 0; problem < NUM_PROBLEMS; problem++)
+    for(int hanging = 0; hanging < 2; hanging++)
+      for(int p = 2; p <= P_MAX; p += 2)
+      {
+        ElementStream stream = create_stream(problem, p, hanging ? HANGING_FRACTION : 0.0);
+
+        // The local matrices are created before the threads only look them up.
+        for(unsigned int b = 0; b < stream.blocks.size(); b++)
+          for(unsigned int e = 0; e < stream.lists.size(); e++)
+            get_local_matrix(local_matrices, stream.lists[e][stream.blocks[b].first].size(), stream.lists[e][stream.blocks[b].second].size());
+
+        Benchmark coloring_benchmark("04-assembly-throughput");
+        coloring_benchmark.begin_run();
+        std::vector<std::vector<int> > element_dofs = get_element_dofs(stream);
+        ElementColoring coloring;
+        coloring.compute(element_dofs);
+        coloring_benchmark.tick("coloring");
+        if(!ElementColoring::is_valid(element_dofs, coloring))
+        {
+          printf("p = %d, %s: invalid coloring.\n", p, PROBLEM_NAMES[problem]);
+          success = false;
+        }
+
+        Hermes::Algebra::UMFPackMatrix<double> reference;
+        preallocate(stream, reference);
+        reference.alloc();
+        insert_threads(stream, local_matrices, NULL, 1, reference);
+
+        double colored_1 = 0.0;
+        for(unsigned int t = 0; t < thread_counts.size(); t++)
+        {
+          Benchmark benchmark("04-assembly-throughput");
+          for(int run = 0; run < runs; run++)
+          {
+            Hermes::Algebra::UMFPackMatrix<double> locked, colored;
+            preallocate(stream, locked);
+            locked.alloc();
+            preallocate(stream, colored);
+            colored.alloc();
+
+            // Alternately first, so that neither profits from the caches warmed up by the other.
+            benchmark.begin_run();
+            for(int k = 0; k < 2; k++)
+              if((k + run) % 2 == 0)
+              {
+                insert_threads(stream, local_matrices, NULL, thread_counts[t], locked);
+                benchmark.tick("locked");
+              }
+              else
+              {
+                insert_threads(stream, local_matrices, &coloring, thread_counts[t], colored);
+                benchmark.tick("colored");
+              }
+
+            if(max_difference(locked, reference) > 1e-12 || max_difference(colored, reference) > 1e-12)
+            {
+              printf("p = %d, %s, %d threads: the matrices differ.\n", p, PROBLEM_NAMES[problem], thread_counts[t]);
+              success = false;
+            }
+          }
+
+          double locked = benchmark.get_statistics("locked").median;
+          double colored = benchmark.get_statistics("colored").median;
+          if(t == 0)
+            colored_1 = colored;
+
+          table.begin_row();
+          table.set("p", p);
+          table.set("problem", problem);
+          table.set("hanging fraction", hanging ? HANGING_FRACTION : 0.0);
+          table.set("colors", coloring.get_num_colors());
+          table.set("coloring", coloring_benchmark.get_current("coloring"));
+          table.set("threads", thread_counts[t]);
+          table.set("locked", locked);
+          table.set("colored", colored);
+          table.set("colored speedup", colored > 0.0 ? colored_1 / colored : 0.0);
+          table.set("colored vs locked", colored > 0.0 ? locked / colored : 0.0);
+          printf("%4d %14s %8g %7d %7d %12.6f %12.6f %10.2f %10.2f\n", p, PROBLEM_NAMES[problem], hanging ? HANGING_FRACTION : 0.0,
+            coloring.get_num_colors(), thread_counts[t], locked, colored, colored > 0.0 ? colored_1 / colored : 0.0,
+            colored > 0.0 ? locked / colored : 0.0);
+
+          table.save("04-assembly-throughput-threads.dat");
+          table.save_csv("04-assembly-throughput-threads.csv");
+        }
+      }
+
+  for(std::map<std::pair<int, int>, double**>::iterator it = local_matrices.begin(); it != local_matrices.end(); it++)
+    delete [] it->second;
+
+  if(success)
+    printf("Success!\n");
+  else
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1 && strcmp(argv[1], "threads") == 0)
+  {
+    if(argc > 2)
+      RUNS = atoi(argv[2]);
+    if(argc > 3)
+      INIT_REF_NUM = atoi(argv[3]);
+    if(argc > 4)
+      MAX_THREADS = atoi(argv[4]);
+    if(argc > 5 || RUNS < 1 || INIT_REF_NUM < 0 || MAX_THREADS < 1)
+    {
+      std::cout << (std::string)"Wrong parameters.";
+      return -1;
+    }
+    return threads(RUNS);
+  }
+
+  if(argc > 1)
+    RUNS = atoi(argv[1]);
+  if(argc > 2)
+    INIT_REF_NUM = atoi(argv[2]);
+  if(argc > 3 || RUNS < 1 || INIT_REF_NUM < 0)
+  {
+    std::cout << (std::string)"Wrong parameters.";
+    return -1;
+  }
+
+  std::map<std::pair<int, int>, double**> local_matrices;
+  BenchmarkTable table;
+
+  printf("%4s %14s %8s %10s %12s %12s %12s %12s %12s %14s %10s\n", "p", "problem", "hanging", "ndof", "nnz",
+    "pattern[s]", "alloc[s]", "insert[s]", "finish[s]", "entries/s", "B/nnz");
+  for(int problem = 0; problem < NUM_PROBLEMS; problem++)
+    for(int hanging = 0; hanging < 2; hanging++)
+      for(int p = 1; p <= P_MAX; p++)
+      {
+        ElementStream stream = create_stream(problem, p, hanging ? HANGING_FRACTION : 0.0);
+        Benchmark benchmark("04-assembly-throughput");
+        for(int run = 0; run < RUNS; run++)
+          assemble(stream, local_matrices, benchmark);
+
+        double insertion = benchmark.get_statistics("insertion").median;
+        double entries = benchmark.get_metric_statistics("entries").median;
+
+        table.begin_row();
+        table.set("p", p);
+        table.set("problem", problem);
+        table.set("hanging fraction", hanging ? HANGING_FRACTION : 0.0);
+        for(unsigned int i = 0; i < benchmark.get_metrics().size(); i++)
+          table.set(benchmark.get_metrics()[i], benchmark.get_metric_statistics(benchmark.get_metrics()[i]).median);
+        for(unsigned int i = 0; i < benchmark.get_phases().size(); i++)
+          table.set(benchmark.get_phases()[i], benchmark.get_statistics(benchmark.get_phases()[i]).median);
+        table.set("entries/s", insertion > 0.0 ? entries / insertion : 0.0);
+
+        int row = table.get_num_rows() - 1;
+        printf("%4d %14s %8g %10g %12g %12.6f %12.6f %12.6f %12.6f %14g %10.2f\n", p, PROBLEM_NAMES[problem], table.get(row, "hanging fraction"),
+          table.get(row, "ndof"), table.get(row, "nnz"), table.get(row, "pattern"), table.get(row, "alloc"),
+          table.get(row, "insertion"), table.get(row, "finish"), table.get(row, "entries/s"), table.get(row, "CSC bytes/nnz"));
+
+        table.save("04-assembly-throughput.dat");
+        table.save_csv("04-assembly-throughput.csv");
+      }
+
+  for(std::map<std::pair<int, int>, double**>::iterator it = local_matrices.begin(); it != local_matrices.end(); it++)
+    delete [] it->second;
+
+  return 0;
+}
@@ -0,0 +1,176 @@
+#define HERMES_REPORT_ALL
+#include "hermes_common.h"
+#include "benchmark.h"
+#include "integration_kernels.h"
+
+// This test compares the vectorized integration kernels (see IntegrationKernels)
+// with the scalar loops of the int_* helpers, for the numbers of quadrature points
+// of the tensor-product Gauss rules on quadrilaterals of the orders used in assembly.
+//
+// For every number of points and every instruction set supported by the CPU,
+// the time of one call of each kernel (the median over the runs) and the speedup
+// with respect to the scalar loop are reported and saved to 05-integration-kernels.dat
+// and .csv. The results of all instruction sets are checked against the scalar ones.
+// The kernels are called as the forms call them, resolved once by IntegrationKernels::get_kernels(),
+// so below IntegrationKernels::SCALAR_THRESHOLD points all instruction sets run the scalar loops.
+//
+// Usage: 05-integration-kernels [RUNS]
+//
+// The following parameters can be changed:
+
+int RUNS = 5;                               // Number of runs of each measurement, medians are reported.
+const double POINTS_PER_RUN = 2e7;          // Number of quadrature points processed by one kernel in one run.
+const double TOLERANCE = 1e-12;             // Maximum relative difference from the scalar results.
+
+const int NUM_KERNELS = 3;
+const char* KERNEL_NAMES[NUM_KERNELS] = { "u_v", "grad_u_grad_v", "w_nabla_u_v" };
+
+// Values at the quadrature points.
+struct QuadratureData
+{
+  int n;
+  double* wt;
+  double* u;
+  double* u_dx;
+  double* u_dy;
+  double* v;
+  double* v_dx;
+  double* v_dy;
+  double* w1;
+  double* w2;
+};
+
+double* random_array(int n, unsigned int& seed)
+{
+  double* data = IntegrationKernels::allocate(n);
+  for(int i = 0; i < n; i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    data[i] = (seed >> 8) / (double)(1 << 24) - 0.5;
+  }
+  return data;
+}
+
+QuadratureData create_data(int n)
+{
+  unsigned int seed = n;
+  QuadratureData data;
+  data.n = n;
+  data.wt = random_array(n, seed);
+  data.u = random_array(n, seed);
+  data.u_dx = random_array(n, seed);
+  data.u_dy = random_array(n, seed);
+  data.v = random_array(n, seed);
+  data.v_dx = random_array(n, seed);
+  data.v_dy = random_array(n, seed);
+  data.w1 = random_array(n, seed);
+  data.w2 = random_array(n, seed);
+  return data;
+}
+
+void free_data(QuadratureData& data)
+{
+  double* arrays[9] = { data.wt, data.u, data.u_dx, data.u_dy, data.v, data.v_dx, data.v_dy, data.w1, data.w2 };
+  for(int i = 0; i < 9; i++)
+    IntegrationKernels::free(arrays[i]);
+}
+
+double call_kernel(int kernel, const IntegrationKernels::Kernels& kernels, QuadratureData& data)
+{
+  switch(kernel)
+  {
+  case 0:
+    return kernels.u_v(data.n, data.wt, data.u, data.v);
+  case 1:
+    return kernels.grad_u_grad_v(data.n, data.wt, data.u_dx, data.u_dy, data.v_dx, data.v_dy);
+  default:
+    return kernels.w_nabla_u_v(data.n, data.wt, data.w1, data.w2, data.u_dx, data.u_dy, data.v);
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1)
+    RUNS = atoi(argv[1]);
+  if(argc > 2 || RUNS < 1)
+  {
+    std::cout << (std::string)"Wrong parameters.";
+    return -1;
+  }
+
+  IntegrationKernels::InstructionSet best = IntegrationKernels::get_best_instruction_set();
+  printf("Best instruction set: %s.\n", IntegrationKernels::get_name(best));
+
+  BenchmarkTable table;
+  bool success = true;
+  // Prevents the calls from being optimized out.
+  volatile double sink = 0.0;
+
+  printf("%6s %8s", "n", "isa");
+  for(int kernel = 0; kernel < NUM_KERNELS; kernel++)
+    printf(" %16s %8s", (std::string(KERNEL_NAMES[kernel]) + "[ns]").c_str(), "speedup");
+  printf("\n");
+
+  for(int order = 1; order <= 12; order++)
+  {
+    QuadratureData data = create_data(order * order);
+    int calls = (int)(POINTS_PER_RUN / data.n);
+
+    double scalar_results[NUM_KERNELS];
+    double scalar_times[NUM_KERNELS];
+    for(int instruction_set = IntegrationKernels::Scalar; instruction_set <= best; instruction_set++)
+    {
+      IntegrationKernels::set_instruction_set((IntegrationKernels::InstructionSet)instruction_set);
+      IntegrationKernels::Kernels kernels = IntegrationKernels::get_kernels();
+      Benchmark benchmark("05-integration-kernels");
+      for(int run = 0; run < RUNS; run++)
+      {
+        benchmark.begin_run();
+        for(int kernel = 0; kernel < NUM_KERNELS; kernel++)
+        {
+          double sum = 0.0;
+          for(int call = 0; call < calls; call++)
+            sum += call_kernel(kernel, kernels, data);
+          benchmark.tick(KERNEL_NAMES[kernel]);
+          sink = sink + sum;
+        }
+      }
+
+      table.begin_row();
+      table.set("n", data.n);
+      table.set("instruction set", instruction_set);
+      printf("%6d %8s", data.n, IntegrationKernels::get_name((IntegrationKernels::InstructionSet)instruction_set));
+      for(int kernel = 0; kernel < NUM_KERNELS; kernel++)
+      {
+        double time = 1e9 * benchmark.get_statistics(KERNEL_NAMES[kernel]).median / calls;
+        double result = call_kernel(kernel, kernels, data);
+        if(instruction_set == IntegrationKernels::Scalar)
+        {
+          scalar_results[kernel] = result;
+          scalar_times[kernel] = time;
+        }
+        else if(std::abs(result - scalar_results[kernel]) > TOLERANCE * std::max(std::abs(scalar_results[kernel]), 1.0))
+        {
+          printf("\n%s (%s, n = %d): %.17g instead of %.17g.\n", KERNEL_NAMES[kernel],
+            IntegrationKernels::get_name((IntegrationKernels::InstructionSet)instruction_set), data.n, result, scalar_results[kernel]);
+          success = false;
+        }
+        table.set(std::string(KERNEL_NAMES[kernel]) + " [ns]", time);
+        table.set(std::string(KERNEL_NAMES[kernel]) + " speedup", scalar_times[kernel] / time);
+        printf(" %16.2f %8.2f", time, scalar_times[kernel] / time);
+      }
+      printf("\n");
+    }
+
+    table.save("05-integration-kernels.dat");
+    table.save_csv("05-integration-kernels.csv");
+    free_data(data);
+  }
+  IntegrationKernels::set_instruction_set(best);
+
+  if(success)
+    printf("Success!\n");
+  else
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
@@ -0,0 +1,133 @@
+#define HERMES_REPORT_ALL
+#include "hermes_common.h"
+#include "benchmark.h"
+#include "sum_factorization.h"
+
+// This test compares the sum-factorized evaluation and integration on quads (see SumFactorization)
+// with the point-by-point loops, for the polynomial degrees 1 ... P_MAX used in the tests
+// (02-poisson-newton, visualization/views) and degree + 1 Gauss points in each direction.
+//
+// "evaluate" computes the values and both derivatives of a function at all points (solution
+// evaluation), "integrate" the integrals of a function and its gradient against all basis
+// functions (assembly of the element residual). For every degree the time of one element
+// (the median over the runs) and the speedup are reported and saved to 06-sum-factorization.dat
+// and .csv. The results of both versions are compared.
+//
+// Usage: 06-sum-factorization [RUNS]
+//
+// The following parameters can be changed:
+
+int RUNS = 5;                               // Number of runs of each measurement, medians are reported.
+const int P_MAX = 10;                       // Maximum polynomial degree.
+const double OPERATIONS_PER_RUN = 1e8;      // Approximate number of multiplications of the point-by-point loops in one run.
+const double TOLERANCE = 1e-12;             // Maximum difference relative to the largest value.
+
+void fill_random(std::vector<double>& data, unsigned int& seed)
+{
+  for(unsigned int i = 0; i < data.size(); i++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    data[i] = (seed >> 8) / (double)(1 << 24) - 0.5;
+  }
+}
+
+double max_difference(const std::vector<double>& a, const std::vector<double>& b)
+{
+  double difference = 0.0, scale = 1e-300;
+  for(unsigned int i = 0; i < a.size(); i++)
+  {
+    difference = std::max(difference, std::abs(a[i] - b[i]));
+    scale = std::max(scale, std::abs(b[i]));
+  }
+  return difference / scale;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1)
+    RUNS = atoi(argv[1]);
+  if(argc > 2 || RUNS < 1)
+  {
+    std::cout << (std::string)"Wrong parameters.";
+    return -1;
+  }
+
+  BenchmarkTable table;
+  bool success = true;
+  // Prevents the calls from being optimized out.
+  volatile double sink = 0.0;
+
+  printf("%3s %5s %16s %16s %8s %16s %16s %8s\n", "p", "q", "evaluate[us]", "direct[us]", "speedup",
+    "integrate[us]", "direct[us]", "speedup");
+
+  for(int p = 1; p <= P_MAX; p++)
+  {
+    SumFactorization sum_factorization(p, p + 1);
+    int num_functions = sum_factorization.get_num_functions();
+    int num_points = sum_factorization.get_num_points();
+    int calls = (int)(OPERATIONS_PER_RUN / ((double)num_functions * num_points)) + 1;
+
+    unsigned int seed = p;
+    std::vector<double> coefs(num_functions), f(num_points), f_dx(num_points), f_dy(num_points);
+    fill_random(coefs, seed);
+    fill_random(f, seed);
+    fill_random(f_dx, seed);
+    fill_random(f_dy, seed);
+
+    std::vector<double> values(num_points), dx(num_points), dy(num_points);
+    std::vector<double> values_direct(num_points), dx_direct(num_points), dy_direct(num_points);
+    std::vector<double> result(num_functions), result_direct(num_functions);
+
+    Benchmark benchmark("06-sum-factorization");
+    for(int run = 0; run < RUNS; run++)
+    {
+      benchmark.begin_run();
+      for(int call = 0; call < calls; call++)
+        sum_factorization.evaluate(&coefs[0], &values[0], &dx[0], &dy[0]);
+      benchmark.tick("evaluate");
+      for(int call = 0; call < calls; call++)
+        sum_factorization.evaluate_direct(&coefs[0], &values_direct[0], &dx_direct[0], &dy_direct[0]);
+      benchmark.tick("evaluate direct");
+      for(int call = 0; call < calls; call++)
+        sum_factorization.integrate(&f[0], &f_dx[0], &f_dy[0], &result[0]);
+      benchmark.tick("integrate");
+      for(int call = 0; call < calls; call++)
+        sum_factorization.integrate_direct(&f[0], &f_dx[0], &f_dy[0], &result_direct[0]);
+      benchmark.tick("integrate direct");
+      sink = sink + values[0] + values_direct[0] + result[0] + result_direct[0];
+    }
+
+    double difference = std::max(std::max(max_difference(values, values_direct), max_difference(dx, dx_direct)),
+      std::max(max_difference(dy, dy_direct), max_difference(result, result_direct)));
+    if(difference > TOLERANCE)
+    {
+      printf("p = %d: the sum-factorized results differ by %g.\n", p, difference);
+      success = false;
+    }
+
+    double evaluate = 1e6 * benchmark.get_statistics("evaluate").median / calls;
+    double evaluate_direct = 1e6 * benchmark.get_statistics("evaluate direct").median / calls;
+    double integrate = 1e6 * benchmark.get_statistics("integrate").median / calls;
+    double integrate_direct = 1e6 * benchmark.get_statistics("integrate direct").median / calls;
+    printf("%3d %5d %16.3f %16.3f %8.2f %16.3f %16.3f %8.2f\n", p, p + 1, evaluate, evaluate_direct,
+      evaluate_direct / evaluate, integrate, integrate_direct, integrate_direct / integrate);
+
+    table.begin_row();
+    table.set("p", p);
+    table.set("points", num_points);
+    table.set("evaluate [us]", evaluate);
+    table.set("evaluate direct [us]", evaluate_direct);
+    table.set("evaluate speedup", evaluate_direct / evaluate);
+    table.set("integrate [us]", integrate);
+    table.set("integrate direct [us]", integrate_direct);
+    table.set("integrate speedup", integrate_direct / integrate);
+    table.save("06-sum-factorization.dat");
+    table.save_csv("06-sum-factorization.csv");
+  }
+
+  if(success)
+    printf("Success!\n");
+  else
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
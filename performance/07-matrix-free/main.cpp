@@ -0,0 +1,169 @@
+#define HERMES_REPORT_ALL
+#include "hermes_common.h"
+#include "benchmark.h"
+#include "matrix_free_operator.h"
+
+// This test compares the matrix-free application of the operator M + K of an H1 space
+// (see MatrixFreeOperator) with the product by the assembled sparse matrix, on an N x N grid
+// of squares for the polynomial degrees 1 ... P_MAX.
+//
+// For every degree the memory of the sparse matrix, the time of its assembly and the times
+// of one application of both operators (the median over the runs) are reported and saved to
+// 07-matrix-free.dat and .csv, and the results of both are compared. Then the matrix-free
+// operator is used
+//   - in the conjugate gradients for -Laplace u = 2 pi^2 sin(pi x) sin(pi y),
+//   - in the explicit Runge-Kutta method BUTCHER_TABLE for u_t = Laplace u,
+//     u(0) = sin(pi x) sin(pi y) on an N_HEAT x N_HEAT grid until T_FINAL,
+// and the L2 errors against the exact solutions are checked.
+//
+// Usage: 07-matrix-free [RUNS [N]]
+//
+// The following parameters can be changed:
+
+int RUNS = 5;                               // Number of runs of each measurement, medians are reported.
+int N = 16;                                 // Number of elements along each side of the grid.
+const int P_MAX = 8;                        // Maximum polynomial degree.
+const int N_HEAT = 4;                       // Number of elements along each side of the grid of the heat equation.
+const double T_FINAL = 1e-3;                // Final time of the heat equation.
+const double TAU_FACTOR = 0.05;             // Time step as a multiple of h^2 / p^4.
+Hermes::ButcherTableType BUTCHER_TABLE = Hermes::Explicit_RK_4;
+const double TOLERANCE = 1e-12;             // Maximum difference of the operators relative to the largest value.
+const double CG_TOLERANCE = 1e-12;          // Relative residual of the conjugate gradients.
+
+const double PI = 3.14159265358979323846;
+
+double sine(double x, double y)
+{
+  return std::sin(PI * x) * std::sin(PI * y);
+}
+
+double poisson_rhs(double x, double y)
+{
+  return 2 * PI * PI * sine(x, y);
+}
+
+double heat_time;
+double heat_exact(double x, double y)
+{
+  return std::exp(-2 * PI * PI * heat_time) * sine(x, y);
+}
+
+// Error of the best approximation, the errors of the solutions are compared with it.
+double projection_error(MatrixFreeOperator& op, double (*f)(double, double))
+{
+  std::vector<double> projection(op.get_size());
+  op.project(f, &projection[0]);
+  return op.l2_error(&projection[0], f);
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1)
+    RUNS = atoi(argv[1]);
+  if(argc > 2)
+    N = atoi(argv[2]);
+  if(argc > 3 || RUNS < 1 || N < 1)
+  {
+    std::cout << (std::string)"Wrong parameters.";
+    return -1;
+  }
+
+  BenchmarkTable table;
+  bool success = true;
+
+  printf("%3s %8s %10s %14s %14s %14s %8s %6s %12s %6s %12s\n", "p", "ndof", "nnz", "matrix[MB]", "spmv[ms]",
+    "matrix-free[ms]", "ratio", "cg", "poisson err", "steps", "heat err");
+
+  for(int p = 1; p <= P_MAX; p++)
+  {
+    MatrixFreeOperator op(N, N, 1.0, 1.0, p);
+    int size = op.get_size();
+    std::vector<double> x(size), y(size), y_matrix(size);
+    unsigned int seed = p;
+    for(int i = 0; i < size; i++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      x[i] = (seed >> 8) / (double)(1 << 24) - 0.5;
+    }
+
+    // The operators.
+    CSRSystem<double> system;
+    Benchmark benchmark("07-matrix-free");
+    for(int run = 0; run < RUNS; run++)
+    {
+      benchmark.begin_run();
+      op.assemble(1.0, 1.0, system);
+      benchmark.tick("assembly");
+      system.multiply(&x[0], &y_matrix[0]);
+      benchmark.tick("sparse matrix");
+      op.apply(1.0, 1.0, &x[0], &y[0]);
+      benchmark.tick("matrix-free");
+    }
+    double matrix_memory = (system.get_nnz() * (sizeof(double) + sizeof(int)) + (size + 1) * sizeof(int)) / 1048576.0;
+    double difference = 0.0, scale = 0.0;
+    for(int i = 0; i < size; i++)
+    {
+      difference = std::max(difference, std::abs(y[i] - y_matrix[i]));
+      scale = std::max(scale, std::abs(y_matrix[i]));
+    }
+    if(difference > TOLERANCE * scale)
+    {
+      printf("p = %d: the matrix-free operator differs from the matrix by %g.\n", p, difference / scale);
+      success = false;
+    }
+
+    // Poisson: the error of the solution is close to the error of the best approximation.
+    std::vector<double> rhs(size), u(size, 0.0);
+    op.integrate(poisson_rhs, &rhs[0]);
+    int iterations = op.solve(0.0, 1.0, &rhs[0], &u[0], CG_TOLERANCE);
+    double poisson_error = op.l2_error(&u[0], sine);
+    if(poisson_error > 2 * projection_error(op, sine) + 1e-10)
+    {
+      printf("p = %d: the error of the Poisson solution %g.\n", p, poisson_error);
+      success = false;
+    }
+
+    // Heat equation.
+    MatrixFreeOperator op_heat(N_HEAT, N_HEAT, 1.0, 1.0, p);
+    Hermes::ButcherTable bt(BUTCHER_TABLE);
+    double h = 1.0 / N_HEAT;
+    int steps = (int)std::ceil(T_FINAL / (TAU_FACTOR * h * h / std::pow(p, 4.0)));
+    double tau = T_FINAL / steps;
+    std::vector<double> u_heat(op_heat.get_size());
+    op_heat.project(sine, &u_heat[0]);
+    for(int step = 0; step < steps; step++)
+      op_heat.explicit_rk_step(&bt, 1.0, tau, &u_heat[0], CG_TOLERANCE);
+    heat_time = T_FINAL;
+    double heat_error = op_heat.l2_error(&u_heat[0], heat_exact);
+    if(heat_error > 2 * projection_error(op_heat, heat_exact) + 1e-10)
+    {
+      printf("p = %d: the error of the heat equation %g.\n", p, heat_error);
+      success = false;
+    }
+
+    double time_matrix = 1e3 * benchmark.get_statistics("sparse matrix").median;
+    double time_matrix_free = 1e3 * benchmark.get_statistics("matrix-free").median;
+    printf("%3d %8d %10d %14.2f %14.3f %14.3f %8.2f %6d %12.3e %6d %12.3e\n", p, size, system.get_nnz(), matrix_memory,
+      time_matrix, time_matrix_free, time_matrix_free / time_matrix, iterations, poisson_error, steps, heat_error);
+
+    table.begin_row();
+    table.set("p", p);
+    table.set("ndof", size);
+    table.set("nnz", system.get_nnz());
+    table.set("matrix [MB]", matrix_memory);
+    table.set("assembly [ms]", 1e3 * benchmark.get_statistics("assembly").median);
+    table.set("sparse matrix [ms]", time_matrix);
+    table.set("matrix-free [ms]", time_matrix_free);
+    table.set("cg iterations", iterations);
+    table.set("poisson error", poisson_error);
+    table.set("heat error", heat_error);
+    table.save("07-matrix-free.dat");
+    table.save_csv("07-matrix-free.csv");
+  }
+
+  if(success)
+    printf("Success!\n");
+  else
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
@@ -0,0 +1,277 @@
+#define HERMES_REPORT_ALL
+#include "hermes_common.h"
+#include "benchmark.h"
+#include "thread_scaling.h"
+#include "sum_factorization.h"
+#include "work_stealing_scheduler.h"
+
+// This test compares the static partition of the elements among the threads (equal numbers of
+// elements per thread) with the cost-aware work-stealing scheduler (see WorkStealingScheduler)
+// on meshes with variable polynomial orders, for three element computations:
+//
+//   - assembly: the local stiffness and mass matrices (point by point, as the assembly of Hermes),
+//   - projection: the local L2 projection of a function (mass matrix and its Cholesky factorization),
+//   - error: the L2 norm of the difference of the element solution and a function.
+//
+// The orders of the elements are those of
+//
+//   - simple: i % 4 + 1 (01-performance-simple),
+//   - views: i % 9 + 1 (visualization/views),
+//   - graded: growing with the element index from 1 to P_MAX, as on the meshes from hp-adaptivity
+//     where the high orders are clustered around the singularities.
+//
+// With 1, 2, 4, ... MAX_THREADS threads the times (medians over the runs), the speedups
+// with respect to one thread and the numbers of stolen chunks are reported and saved to
+// 08-work-stealing.dat and .csv. The results of every element are compared with a serial run.
+//
+// Usage: 08-work-stealing [RUNS [NUM_ELEMENTS [MAX_THREADS]]]
+//
+// The following parameters can be changed:
+
+int RUNS = 3;                               // Number of runs of each measurement, medians are reported.
+int NUM_ELEMENTS = 1024;                    // Number of elements.
+int MAX_THREADS = -1;                       // Maximum number of threads (the number of cores by default).
+const int P_MAX = 9;                        // Maximum polynomial degree.
+
+const int NUM_COMPUTATIONS = 3;
+const char* COMPUTATION_NAMES[NUM_COMPUTATIONS] = { "assembly", "projection", "error" };
+const int NUM_DISTRIBUTIONS = 3;
+const char* DISTRIBUTION_NAMES[NUM_DISTRIBUTIONS] = { "simple", "views", "graded" };
+
+int get_order(int distribution, int element)
+{
+  switch(distribution)
+  {
+  case 0:
+    return element % 4 + 1;
+  case 1:
+    return element % 9 + 1;
+  default:
+    return 1 + (int)((double)P_MAX * element / NUM_ELEMENTS * element / NUM_ELEMENTS);
+  }
+}
+
+double function(double x, double y)
+{
+  return std::sin(3.0 * x) * std::exp(y);
+}
+
+// The element computations, every thread has its own tables and work arrays.
+class ElementTask : public WorkStealingScheduler::Task
+{
+public:
+  ElementTask(int computation, const std::vector<int>& orders, int num_threads) : computation(computation), orders(orders),
+    results(orders.size()), tables(num_threads)
+  {
+    for(int t = 0; t < num_threads; t++)
+      for(int p = 0; p <= P_MAX; p++)
+        this->tables[t].push_back(new SumFactorization(p, p + 1));
+  }
+
+  ~ElementTask()
+  {
+    for(unsigned int t = 0; t < this->tables.size(); t++)
+      for(unsigned int p = 0; p < this->tables[t].size(); p++)
+        delete this->tables[t][p];
+  }
+
+  void execute(int item, int thread)
+  {
+    SumFactorization* table = this->tables[thread][this->orders[item]];
+    int n = table->get_num_functions(), q = table->get_num_points();
+    std::vector<double> unit(n, 0.0), values(q), dx(q), dy(q), column(n), matrix(n * n), f(q);
+
+    if(this->computation == 2)
+    {
+      // The element solution is the projection of a perturbed function.
+      for(int i = 0; i < n; i++)
+        unit[i] = 1.0 / (1 + i + item % 7);
+      table->evaluate_direct(&unit[0], &values[0]);
+      const double* wt = table->get_weights();
+      double error = 0.0;
+      for(int k = 0; k < q; k++)
+      {
+        double x, y;
+        table->get_point(k, x, y);
+        error += wt[k] * (values[k] - function(x, y)) * (values[k] - function(x, y));
+      }
+      this->results[item] = std::sqrt(error);
+      return;
+    }
+
+    // Columns of the local matrix.
+    for(int j = 0; j < n; j++)
+    {
+      unit[j] = 1.0;
+      table->evaluate_direct(&unit[0], &values[0], &dx[0], &dy[0]);
+      unit[j] = 0.0;
+      if(this->computation == 0)
+        table->integrate_direct(&values[0], &dx[0], &dy[0], &column[0]);
+      else
+        table->integrate_direct(&values[0], NULL, NULL, &column[0]);
+      for(int i = 0; i < n; i++)
+        matrix[i * n + j] = column[i];
+    }
+
+    if(this->computation == 0)
+    {
+      double sum = 0.0;
+      for(int i = 0; i < n * n; i++)
+        sum += matrix[i];
+      this->results[item] = sum;
+      return;
+    }
+
+    // Projection: Cholesky factorization of the mass matrix and the solution.
+    for(int k = 0; k < q; k++)
+    {
+      double x, y;
+      table->get_point(k, x, y);
+      f[k] = function(x, y);
+    }
+    std::vector<double> rhs(n);
+    table->integrate_direct(&f[0], NULL, NULL, &rhs[0]);
+    for(int j = 0; j < n; j++)
+    {
+      for(int k = 0; k < j; k++)
+        matrix[j * n + j] -= matrix[j * n + k] * matrix[j * n + k];
+      matrix[j * n + j] = std::sqrt(matrix[j * n + j]);
+      for(int i = j + 1; i < n; i++)
+      {
+        for(int k = 0; k < j; k++)
+          matrix[i * n + j] -= matrix[i * n + k] * matrix[j * n + k];
+        matrix[i * n + j] /= matrix[j * n + j];
+      }
+    }
+    for(int i = 0; i < n; i++)
+    {
+      for(int k = 0; k < i; k++)
+        rhs[i] -= matrix[i * n + k] * rhs[k];
+      rhs[i] /= matrix[i * n + i];
+    }
+    for(int i = n - 1; i >= 0; i--)
+    {
+      for(int k = i + 1; k < n; k++)
+        rhs[i] -= matrix[k * n + i] * rhs[k];
+      rhs[i] /= matrix[i * n + i];
+    }
+    double sum = 0.0;
+    for(int i = 0; i < n; i++)
+      sum += rhs[i];
+    this->results[item] = sum;
+  }
+
+  int computation;
+  const std::vector<int>& orders;
+  std::vector<double> results;
+  std::vector<std::vector<SumFactorization*> > tables;
+};
+
+double get_cost(int computation, int order)
+{
+  switch(computation)
+  {
+  case 0:
+    // Stiffness and mass.
+    return WorkStealingScheduler::estimate_element_cost(order, 2);
+  case 1:
+    // Mass and the factorization, (p + 1)^6 / 3.
+    return WorkStealingScheduler::estimate_element_cost(order, 1) + std::pow(order + 1.0, 6.0) / 3.0;
+  default:
+    // Only the values at the points.
+    return std::pow(order + 1.0, 4.0) + 100.0;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1)
+    RUNS = atoi(argv[1]);
+  if(argc > 2)
+    NUM_ELEMENTS = atoi(argv[2]);
+  if(argc > 3)
+    MAX_THREADS = atoi(argv[3]);
+  if(argc > 4 || RUNS < 1 || NUM_ELEMENTS < 1 || MAX_THREADS == 0 || MAX_THREADS < -1)
+  {
+    std::cout << (std::string)"Wrong parameters.";
+    return -1;
+  }
+
+  std::vector<int> thread_counts = ThreadScaling::get_thread_counts(MAX_THREADS);
+  BenchmarkTable table;
+  bool success = true;
+
+  printf("%12s %8s %7s %12s %12s %10s %10s %8s\n", "computation", "orders", "threads", "static[s]", "stealing[s]",
+    "static x", "stealing x", "steals");
+  for(int distribution = 0; distribution < NUM_DISTRIBUTIONS; distribution++)
+  {
+    std::vector<int> orders(NUM_ELEMENTS);
+    for(int e = 0; e < NUM_ELEMENTS; e++)
+      orders[e] = get_order(distribution, e);
+
+    for(int computation = 0; computation < NUM_COMPUTATIONS; computation++)
+    {
+      std::vector<double> costs(NUM_ELEMENTS);
+      for(int e = 0; e < NUM_ELEMENTS; e++)
+        costs[e] = get_cost(computation, orders[e]);
+
+      ElementTask reference(computation, orders, 1);
+      WorkStealingScheduler(1).run_static(NUM_ELEMENTS, reference);
+
+      double static_1 = 0.0, stealing_1 = 0.0;
+      for(unsigned int t = 0; t < thread_counts.size(); t++)
+      {
+        WorkStealingScheduler scheduler(thread_counts[t]);
+        Benchmark benchmark("08-work-stealing");
+        int steals = 0;
+        for(int run = 0; run < RUNS; run++)
+        {
+          ElementTask task_static(computation, orders, thread_counts[t]), task_stealing(computation, orders, thread_counts[t]);
+          benchmark.begin_run();
+          scheduler.run_static(NUM_ELEMENTS, task_static);
+          benchmark.tick("static");
+          scheduler.run(costs, task_stealing);
+          benchmark.tick("stealing");
+          steals = scheduler.get_num_steals();
+
+          if(task_static.results != reference.results || task_stealing.results != reference.results)
+          {
+            printf("%s, %s orders, %d threads: the results differ.\n", COMPUTATION_NAMES[computation],
+              DISTRIBUTION_NAMES[distribution], thread_counts[t]);
+            success = false;
+          }
+        }
+
+        double time_static = benchmark.get_statistics("static").median;
+        double time_stealing = benchmark.get_statistics("stealing").median;
+        if(t == 0)
+        {
+          static_1 = time_static;
+          stealing_1 = time_stealing;
+        }
+        double speedup_static = time_static > 0.0 ? static_1 / time_static : 0.0;
+        double speedup_stealing = time_stealing > 0.0 ? stealing_1 / time_stealing : 0.0;
+        printf("%12s %8s %7d %12.6f %12.6f %10.2f %10.2f %8d\n", COMPUTATION_NAMES[computation], DISTRIBUTION_NAMES[distribution],
+          thread_counts[t], time_static, time_stealing, speedup_static, speedup_stealing, steals);
+
+        table.begin_row();
+        table.set("computation", computation);
+        table.set("orders", distribution);
+        table.set("threads", thread_counts[t]);
+        table.set("static", time_static);
+        table.set("stealing", time_stealing);
+        table.set("static speedup", speedup_static);
+        table.set("stealing speedup", speedup_stealing);
+        table.set("steals", steals);
+        table.save("08-work-stealing.dat");
+        table.save_csv("08-work-stealing.csv");
+      }
+    }
+  }
+
+  if(success)
+    printf("Success!\n");
+  else
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
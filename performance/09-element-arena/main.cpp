@@ -0,0 +1,273 @@
+#define HERMES_REPORT_ALL
+#include "hermes_common.h"
+#include "benchmark.h"
+#include "allocation_counter.h"
+#include "thread_scaling.h"
+#include "element_arena.h"
+#include "work_stealing_scheduler.h"
+
+// This test compares two ways of providing the temporaries of the form calls during assembly:
+//
+//   - heap: every form call gets freshly allocated values of the shape functions (Func), the geometry
+//     (Geom) and the u_ext / ext arrays, which are deleted after the call (as in DiscreteProblem),
+//   - arena: the same buffers come from the arena of the thread (see ElementArena), which is reset
+//     per element.
+//
+// The elements have the orders i % 4 + 1 (01-performance-simple) and the forms are those of the
+// Poisson problem (one component, a matrix and a vector form) and of the Navier-Stokes problem
+// (three components, nine matrix forms with the previous solution and two external functions).
+// With 1, 2, 4, ... MAX_THREADS threads (the elements scheduled by WorkStealingScheduler) the times
+// (medians over the runs) are reported, together with the heap allocations per element when built
+// with WITH_ALLOCATION_COUNTER. The results are compared and saved to 09-element-arena.dat and .csv.
+//
+// The threads of the scheduler persist between the runs, and so do their arenas: the arena
+// allocations per element are those of the runs after the first one, which have to stay below
+// MAX_ARENA_ALLOCATIONS (the scheduler itself allocates its chunk lists).
+//
+// Usage: 09-element-arena [RUNS [NUM_ELEMENTS [MAX_THREADS]]]
+//
+// The following parameters can be changed:
+
+int RUNS = 3;                               // Number of runs of each measurement, medians are reported.
+int NUM_ELEMENTS = 4096;                    // Number of elements.
+int MAX_THREADS = -1;                       // Maximum number of threads (the number of cores by default).
+const int P_MAX = 4;                        // Maximum polynomial degree.
+const double TOLERANCE = 1e-12;             // Maximum relative difference of the results.
+const double MAX_ARENA_ALLOCATIONS = 0.1;   // Maximum heap allocations per element with warm arenas.
+
+struct Problem
+{
+  const char* name;
+  int num_components;
+  int num_forms;
+  int num_ext;
+};
+const int NUM_PROBLEMS = 2;
+const Problem PROBLEMS[NUM_PROBLEMS] = { { "poisson", 1, 2, 0 }, { "navier-stokes", 3, 9, 2 } };
+
+// The layouts of Func<double> and Geom<double> reduced to the arrays used by the forms.
+struct FuncData
+{
+  int n;
+  double* val;
+  double* dx;
+  double* dy;
+};
+
+struct GeomData
+{
+  int n;
+  double* x;
+  double* y;
+};
+
+// From the arena if given, from the heap otherwise.
+template<typename T>
+T* allocate(ElementArena* arena, int count)
+{
+  return arena ? arena->allocate<T>(count) : new T[count];
+}
+
+FuncData* create_func(ElementArena* arena, int n, double shift)
+{
+  FuncData* f = allocate<FuncData>(arena, 1);
+  f->n = n;
+  f->val = allocate<double>(arena, n);
+  f->dx = allocate<double>(arena, n);
+  f->dy = allocate<double>(arena, n);
+  for(int k = 0; k < n; k++)
+  {
+    f->val[k] = std::cos(shift + 0.1 * k);
+    f->dx[k] = std::sin(shift - 0.2 * k);
+    f->dy[k] = std::cos(shift + 0.3 * k);
+  }
+  return f;
+}
+
+void delete_func(FuncData* f)
+{
+  delete [] f->val;
+  delete [] f->dx;
+  delete [] f->dy;
+  delete [] f;
+}
+
+class FormTask : public WorkStealingScheduler::Task
+{
+public:
+  FormTask(const Problem& problem, bool use_arena) : problem(problem), use_arena(use_arena), results(NUM_ELEMENTS)
+  {
+  }
+
+  void execute(int item, int thread)
+  {
+    ElementArena* arena = NULL;
+    if(this->use_arena)
+    {
+      arena = &ElementArena::get_thread_arena();
+      arena->reset();
+    }
+
+    int p = item % P_MAX + 1;
+    int n = (p + 1) * (p + 1), num_functions = (p + 1) * (p + 1);
+    double result = 0.0;
+    for(int form = 0; form < this->problem.num_forms; form++)
+    {
+      GeomData* e = allocate<GeomData>(arena, 1);
+      e->n = n;
+      e->x = allocate<double>(arena, n);
+      e->y = allocate<double>(arena, n);
+      double* wt = allocate<double>(arena, n);
+      for(int k = 0; k < n; k++)
+      {
+        e->x[k] = item + (double)k / n;
+        e->y[k] = item - (double)k / n;
+        wt[k] = 1.0 / n;
+      }
+      FuncData** u_ext = allocate<FuncData*>(arena, this->problem.num_components);
+      for(int c = 0; c < this->problem.num_components; c++)
+        u_ext[c] = create_func(arena, n, item + c);
+      FuncData** ext = allocate<FuncData*>(arena, std::max(this->problem.num_ext, 1));
+      for(int c = 0; c < this->problem.num_ext; c++)
+        ext[c] = create_func(arena, n, item - c);
+      FuncData** functions = allocate<FuncData*>(arena, num_functions);
+      for(int i = 0; i < num_functions; i++)
+        functions[i] = create_func(arena, n, form + i);
+
+      // int (1 + u_ext[0]) grad u . grad v + ext[0] u v over all pairs of the shape functions.
+      for(int i = 0; i < num_functions; i++)
+        for(int j = 0; j < num_functions; j++)
+        {
+          FuncData* u = functions[j];
+          FuncData* v = functions[i];
+          double value = 0.0;
+          for(int k = 0; k < n; k++)
+          {
+            value += wt[k] * (1.0 + u_ext[0]->val[k]) * (u->dx[k] * v->dx[k] + u->dy[k] * v->dy[k]);
+            if(this->problem.num_ext > 0)
+              value += wt[k] * ext[0]->val[k] * u->val[k] * v->val[k];
+          }
+          result += value;
+        }
+
+      if(!arena)
+      {
+        for(int i = 0; i < num_functions; i++)
+          delete_func(functions[i]);
+        delete [] functions;
+        for(int c = 0; c < this->problem.num_ext; c++)
+          delete_func(ext[c]);
+        delete [] ext;
+        for(int c = 0; c < this->problem.num_components; c++)
+          delete_func(u_ext[c]);
+        delete [] u_ext;
+        delete [] wt;
+        delete [] e->x;
+        delete [] e->y;
+        delete [] e;
+      }
+    }
+    this->results[item] = result;
+  }
+
+  const Problem& problem;
+  bool use_arena;
+  std::vector<double> results;
+};
+
+double max_difference(const std::vector<double>& a, const std::vector<double>& b)
+{
+  double difference = 0.0, scale = 1e-300;
+  for(unsigned int i = 0; i < a.size(); i++)
+  {
+    difference = std::max(difference, std::abs(a[i] - b[i]));
+    scale = std::max(scale, std::abs(b[i]));
+  }
+  return difference / scale;
+}
+
+int main(int argc, char* argv[])
+{
+  if(argc > 1)
+    RUNS = atoi(argv[1]);
+  if(argc > 2)
+    NUM_ELEMENTS = atoi(argv[2]);
+  if(argc > 3)
+    MAX_THREADS = atoi(argv[3]);
+  if(argc > 4 || RUNS < 1 || NUM_ELEMENTS < 1 || MAX_THREADS == 0 || MAX_THREADS < -1)
+  {
+    std::cout << (std::string)"Wrong parameters.";
+    return -1;
+  }
+
+  std::vector<int> thread_counts = ThreadScaling::get_thread_counts(MAX_THREADS);
+  BenchmarkTable table;
+  bool success = true;
+
+  if(!AllocationCounter::is_enabled())
+    printf("Built without WITH_ALLOCATION_COUNTER, the allocations are not counted.\n");
+  printf("%14s %7s %12s %12s %8s %14s %14s\n", "problem", "threads", "heap[s]", "arena[s]", "speedup",
+    "heap allocs/el", "arena allocs/el");
+  for(int problem = 0; problem < NUM_PROBLEMS; problem++)
+  {
+    std::vector<double> costs(NUM_ELEMENTS);
+    for(int e = 0; e < NUM_ELEMENTS; e++)
+      costs[e] = WorkStealingScheduler::estimate_element_cost(e % P_MAX + 1, PROBLEMS[problem].num_forms);
+
+    for(unsigned int t = 0; t < thread_counts.size(); t++)
+    {
+      WorkStealingScheduler scheduler(thread_counts[t]);
+      Benchmark benchmark("09-element-arena");
+      AllocationCounter counter("09-element-arena");
+      for(int run = 0; run < RUNS; run++)
+      {
+        FormTask task_heap(PROBLEMS[problem], false), task_arena(PROBLEMS[problem], true);
+        benchmark.begin_run();
+        counter.begin();
+        scheduler.run(costs, task_heap);
+        benchmark.tick("heap");
+        counter.tick("heap");
+        scheduler.run(costs, task_arena);
+        benchmark.tick("arena");
+        counter.tick(run == 0 ? "arena first run" : "arena");
+
+        if(max_difference(task_arena.results, task_heap.results) > TOLERANCE)
+        {
+          printf("%s, %d threads: the results differ.\n", PROBLEMS[problem].name, thread_counts[t]);
+          success = false;
+        }
+      }
+
+      double time_heap = benchmark.get_statistics("heap").median;
+      double time_arena = benchmark.get_statistics("arena").median;
+      // Accumulated over the runs.
+      double allocations_heap = counter.get_phase("heap").allocations / RUNS / NUM_ELEMENTS;
+      double allocations_arena = RUNS > 1 ? counter.get_phase("arena").allocations / (RUNS - 1) / NUM_ELEMENTS
+        : counter.get_phase("arena first run").allocations / NUM_ELEMENTS;
+      printf("%14s %7d %12.6f %12.6f %8.2f %14.2f %14.2f\n", PROBLEMS[problem].name, thread_counts[t], time_heap, time_arena,
+        time_arena > 0.0 ? time_heap / time_arena : 0.0, allocations_heap, allocations_arena);
+      if(RUNS > 1 && allocations_arena > MAX_ARENA_ALLOCATIONS)
+      {
+        printf("%s, %d threads: the arenas were not reused between the runs.\n", PROBLEMS[problem].name, thread_counts[t]);
+        success = false;
+      }
+
+      table.begin_row();
+      table.set("problem", problem);
+      table.set("threads", thread_counts[t]);
+      table.set("heap", time_heap);
+      table.set("arena", time_arena);
+      table.set("speedup", time_arena > 0.0 ? time_heap / time_arena : 0.0);
+      table.set("heap allocations per element", allocations_heap);
+      table.set("arena allocations per element", allocations_arena);
+      table.save("09-element-arena.dat");
+      table.save_csv("09-element-arena.csv");
+    }
+  }
+
+  if(success)
+    printf("Success!\n");
+  else
+    printf("Failure!\n");
+  return success ? 0 : -1;
+}
@@ -91,6 +91,62 @@ if [ "$ans" = "y" ]; then
   echo "Performance leaks tests - Done."
   cd ../..
 fi
+echo "Run native benchmarks? (Long) [y/n]"
+read ans
+if [ "$ans" = "y" ]; then
+  echo "How many runs of each benchmark?"
+  read runs
+  echo "Processing native benchmarks..."
+  cd performance
+  cd 01-performance-simple
+  make
+  ./01-performance-simple 3 3 benchmark $runs
+  echo "Benchmark output '01-performance-simple-benchmark.json/csv' available in performance/01-performance-simple/"
+  ./01-performance-simple 3 3 threads $runs
+  echo "Thread scaling output '01-performance-simple-threads.csv' available in performance/01-performance-simple/"
+  ./01-performance-simple sweep 8 3 $runs
+  echo "Scaling sweep output '01-performance-simple-sweep.dat/csv' available in performance/01-performance-simple/"
+  cd ../02-performance-adapt
+  make
+  ./02-performance-adapt benchmark $runs
+  echo "Benchmark output '02-performance-adapt-benchmark.json/csv' available in performance/02-performance-adapt/"
+  ./02-performance-adapt threads $runs
+  echo "Thread scaling output '02-performance-adapt-threads.csv' available in performance/02-performance-adapt/"
+  cd ../03-performance-transient-adapt
+  make
+  ./03-performance-transient-adapt benchmark $runs
+  echo "Benchmark output '03-performance-transient-adapt-benchmark.json/csv' available in performance/03-performance-transient-adapt/"
+  ./03-performance-transient-adapt threads $runs
+  echo "Thread scaling output '03-performance-transient-adapt-threads.csv' available in performance/03-performance-transient-adapt/"
+  cd ../04-assembly-throughput
+  make
+  ./04-assembly-throughput $runs
+  echo "Assembly throughput output '04-assembly-throughput.dat/csv' available in performance/04-assembly-throughput/"
+  ./04-assembly-throughput threads $runs
+  echo "Threaded insertion output '04-assembly-throughput-threads.dat/csv' available in performance/04-assembly-throughput/"
+  cd ../05-integration-kernels
+  make
+  ./05-integration-kernels $runs
+  echo "Integration kernels output '05-integration-kernels.dat/csv' available in performance/05-integration-kernels/"
+  cd ../06-sum-factorization
+  make
+  ./06-sum-factorization $runs
+  echo "Sum factorization output '06-sum-factorization.dat/csv' available in performance/06-sum-factorization/"
+  cd ../07-matrix-free
+  make
+  ./07-matrix-free $runs
+  echo "Matrix-free output '07-matrix-free.dat/csv' available in performance/07-matrix-free/"
+  cd ../08-work-stealing
+  make
+  ./08-work-stealing $runs
+  echo "Work-stealing output '08-work-stealing.dat/csv' available in performance/08-work-stealing/"
+  cd ../09-element-arena
+  make
+  ./09-element-arena $runs
+  echo "Element arena output '09-element-arena.dat/csv' available in performance/09-element-arena/"
+  echo "Native benchmarks - Done."
+  cd ../..
+fi
 echo "Run visualization tests? (Short) [y/n]"
 read ans
 if [ "$ans" = "y" ]; then